@@ -26,10 +26,13 @@
 
 #include <sys/types.h>
 #include <sys/time.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <list>
 #include <map>
@@ -37,6 +40,18 @@
 #include "ecl/list.hpp"
 #include "ecl/tailq.hpp"
 #include "ecl/rbtree.hpp"
+#include "ecl/rbfrozen.hpp"
+#include "ecl/rbshard.hpp"
+#include "ecl/bptree.hpp"
+#include "ecl/wavltree.hpp"
+#include "ecl/avltree.hpp"
+#include "ecl/splaytree.hpp"
+#include "ecl/hashtable.hpp"
+#include "ecl/hashindex.hpp"
+#include "ecl/chashtable.hpp"
+#include "ecl/epoch.hpp"
+#include "ecl/skiplist.hpp"
+#include "ecl/algorithm.hpp"
 
 class DataTailq;
 class DataTree;
@@ -58,10 +73,122 @@ struct DataTreeEntry : ecl::RBTreeEntry<DataTreeEntry, DataTree> {
 			return -1;
 		return 0;
 	}
+
+	template<typename T>
+	static int key_fn(T *obj) {
+		return obj->gen;
+	}
 };
 typedef ecl::RBTreeHead<DataTreeEntry> DataTreeHead;
+typedef ecl::RBTreeFrozen<DataTreeEntry, int> DataTreeFrozen;
+typedef ecl::BPTreeHead<DataTreeEntry, int> DataBPTreeHead;
+typedef ecl::RBTreeShardHead<DataTreeEntry, int> DataTreeShardHead;
+
+class DataWAVLTree;
+
+struct DataWAVLTreeEntry : ecl::WAVLTreeEntry<DataWAVLTreeEntry, DataWAVLTree> {
+	template<typename T>
+	static int compare_fn(T *a, T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, T *obj) {
+		if (key > obj->gen)
+			return 1;
+		else if (key < obj->gen)
+			return -1;
+		return 0;
+	}
+};
+typedef ecl::WAVLTreeHead<DataWAVLTreeEntry> DataWAVLTreeHead;
+
+class DataAVLTree;
+
+struct DataAVLTreeEntry : ecl::AVLTreeEntry<DataAVLTreeEntry, DataAVLTree> {
+	template<typename T>
+	static int compare_fn(T *a, T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, T *obj) {
+		if (key > obj->gen)
+			return 1;
+		else if (key < obj->gen)
+			return -1;
+		return 0;
+	}
+};
+typedef ecl::AVLTreeHead<DataAVLTreeEntry> DataAVLTreeHead;
+
+class DataSplayTree;
+
+struct DataSplayTreeEntry : ecl::SplayTreeEntry<DataSplayTreeEntry, DataSplayTree> {
+	template<typename T>
+	static int compare_fn(T *a, T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, T *obj) {
+		if (key > obj->gen)
+			return 1;
+		else if (key < obj->gen)
+			return -1;
+		return 0;
+	}
+};
+typedef ecl::SplayTreeHead<DataSplayTreeEntry> DataSplayTreeHead;
+
+class DataSkipList;
+
+struct DataSkipListEntry : ecl::SkipListEntry<DataSkipListEntry, DataSkipList> {
+	template<typename T>
+	static int compare_fn(T *a, T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, T *obj) {
+		if (key > obj->gen)
+			return 1;
+		else if (key < obj->gen)
+			return -1;
+		return 0;
+	}
+};
+typedef ecl::SkipListHead<DataSkipListEntry> DataSkipListHead;
+
+class DataHash;
+
+struct DataHashEntry : ecl::HashTableEntry<DataHashEntry, DataHash> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		return key == obj->gen ? 0 : 1;
+	}
+
+	template<typename T>
+	static size_t hash_fn(const T *obj) {
+		return hash_key_fn(obj->gen);
+	}
+
+	static size_t hash_key_fn(int key) {
+		return (size_t)key * 0x9e3779b97f4a7c15ULL >> 17;
+	}
+};
+typedef ecl::HashTableHead<DataHashEntry> DataHashHead;
+typedef ecl::HashIndex<DataHashEntry> DataHashIndex;
+typedef ecl::ConcurrentHashTableHead<DataHashEntry> DataCHashHead;
 
 static int g_gen;
+/* Keeps results of benchmark loops alive */
+static volatile int g_sink;
 
 class DataTailq : public DataTailqEntry {
 public:
@@ -95,6 +222,91 @@ private:
 	char dummy[26];
 };
 
+class DataWAVLTree : public DataWAVLTreeEntry {
+public:
+	typedef DataWAVLTreeEntry tree;
+
+	friend struct DataWAVLTreeEntry;
+
+	DataWAVLTree(int a) : gen(a) { }
+
+	int generation() {
+		return gen;
+	}
+
+private:
+	int gen;
+	char dummy[26];
+};
+
+class DataAVLTree : public DataAVLTreeEntry {
+public:
+	typedef DataAVLTreeEntry tree;
+
+	friend struct DataAVLTreeEntry;
+
+	DataAVLTree(int a) : gen(a) { }
+
+	int generation() {
+		return gen;
+	}
+
+private:
+	int gen;
+	char dummy[26];
+};
+
+class DataSplayTree : public DataSplayTreeEntry {
+public:
+	typedef DataSplayTreeEntry tree;
+
+	friend struct DataSplayTreeEntry;
+
+	DataSplayTree(int a) : gen(a) { }
+
+	int generation() {
+		return gen;
+	}
+
+private:
+	int gen;
+	char dummy[26];
+};
+
+class DataSkipList : public DataSkipListEntry {
+public:
+	typedef DataSkipListEntry tree;
+
+	friend struct DataSkipListEntry;
+
+	DataSkipList(int a) : gen(a) { }
+
+	int generation() {
+		return gen;
+	}
+
+private:
+	int gen;
+	char dummy[26];
+};
+
+class DataHash : public DataHashEntry {
+public:
+	typedef DataHashEntry tree;
+
+	friend struct DataHashEntry;
+
+	DataHash(int a) : gen(a) { }
+
+	int generation() {
+		return gen;
+	}
+
+private:
+	int gen;
+	char dummy[26];
+};
+
 class DataPlain {
 public:
 	DataPlain() : gen(g_gen++) { }
@@ -122,6 +334,59 @@ benchmark_result(const char *name, intmax_t n,
 	    name, n, t, (double)n/t);
 }
 
+struct LatencyHist {
+	enum { NBUCKETS = 40 };
+
+	LatencyHist() : count(0), max(0) {
+		memset(buckets, 0, sizeof(buckets));
+	}
+
+	static uint64_t now() {
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	}
+
+	void add(uint64_t ns) {
+		int b;
+
+		for (b = 0; b < NBUCKETS - 1 && ((uint64_t)1 << b) < ns; b++)
+			;
+		buckets[b]++;
+		count++;
+		if (ns > max)
+			max = ns;
+	}
+
+	/* Upper bound of the bucket holding the given quantile */
+	uint64_t quantile(double q) const {
+		uint64_t n = 0;
+		int b;
+
+		for (b = 0; b < NBUCKETS; b++) {
+			n += buckets[b];
+			if (n >= q * count)
+				break;
+		}
+		return ((uint64_t)1 << b);
+	}
+
+	uint64_t buckets[NBUCKETS];
+	uint64_t count;
+	uint64_t max;
+};
+
+static void
+latency_result(const char *name, const LatencyHist *h)
+{
+	printf("%s: %ju ops; latency ns p50 <= %ju, p99 <= %ju, "
+	    "p99.9 <= %ju, p99.99 <= %ju, max %ju\n", name,
+	    (uintmax_t)h->count, (uintmax_t)h->quantile(0.5),
+	    (uintmax_t)h->quantile(0.99), (uintmax_t)h->quantile(0.999),
+	    (uintmax_t)h->quantile(0.9999), (uintmax_t)h->max);
+}
+
 static void
 test_add_remove_ecl(int n)
 {
@@ -229,6 +494,200 @@ test_iterate_stl(int nelem, int niter)
 	benchmark_result("stl: iterate", niter * nelem, &tstart, &tend);
 }
 
+struct DataTailqSum {
+	DataTailqSum() : sum(0) { }
+
+	void operator()(DataTailq *d) {
+		sum += d->generation();
+	}
+
+	int sum;
+};
+
+/*
+ * List order is unrelated to allocation order.  mode 0 is a plain next()
+ * loop, 1 is PrefetchIterator and 2 is for_each(), both at distance.
+ */
+static void
+test_iterate_shuffled_ecl(int nelem, int niter, int mode, int distance)
+{
+	struct timeval tstart, tend;
+	DataTailqHead head;
+	DataTailq *d, **buf;
+	char name[128];
+	int i, j, x;
+
+	buf = new DataTailq*[nelem];
+	for (i = 0; i < nelem; i++)
+		buf[i] = new DataTailq();
+	for (i = nelem - 1; i > 0; i--) {
+		j = random() % (i + 1);
+		d = buf[i];
+		buf[i] = buf[j];
+		buf[j] = d;
+	}
+	for (i = 0; i < nelem; i++)
+		head.insert_tail(buf[i]);
+
+	gettimeofday(&tstart, NULL);
+
+	for (j = 0, x = 0; j < niter; j++) {
+		if (mode == 0) {
+			for (d = head.first(); d != NULL; d = d->next())
+				x += d->generation();
+		} else if (mode == 1) {
+			ecl::PrefetchIterator<DataTailqEntry> it(distance);
+
+			for (d = it.init(&head); d != NULL; d = it.next())
+				x += d->generation();
+		} else
+			x += ecl::for_each(&head, DataTailqSum(), distance).sum;
+	}
+
+	gettimeofday(&tend, NULL);
+	g_sink = x;
+
+	for (i = 0; i < nelem; i++)
+		head.remove(buf[i]);
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	if (mode == 0)
+		snprintf(name, sizeof(name), "ecl: iterate shuffled");
+	else
+		snprintf(name, sizeof(name), "ecl: iterate shuffled, %s, "
+		    "distance %d", mode == 1 ? "prefetch" : "for_each",
+		    distance);
+	benchmark_result(name, (intmax_t)niter * nelem, &tstart, &tend);
+}
+
+struct DataTailqChainSum {
+	DataTailqChainSum() : sum(0) { }
+
+	bool operator()(DataTailq *d, size_t tag) {
+		sum += d->generation();
+		return true;
+	}
+
+	int sum;
+};
+
+/*
+ * Many short chains like hash buckets, walked one after another (width 0)
+ * or width at a time with walk_chains().
+ */
+static void
+test_walk_chains_ecl(int nelem, int nchains, int niter, int width)
+{
+	struct timeval tstart, tend;
+	DataTailqHead *heads;
+	DataTailqChainSum v;
+	DataTailq *d, **buf;
+	char name[128];
+	int i, j, x;
+
+	buf = new DataTailq*[nelem];
+	heads = new DataTailqHead[nchains];
+	for (i = 0; i < nelem; i++)
+		buf[i] = new DataTailq();
+	for (i = 0; i < nelem; i++)
+		heads[random() % nchains].insert_tail(buf[i]);
+
+	gettimeofday(&tstart, NULL);
+
+	for (j = 0, x = 0; j < niter; j++) {
+		switch (width) {
+		case 0:
+			for (i = 0; i < nchains; i++)
+				for (d = heads[i].first(); d != NULL;
+				    d = d->next())
+					x += d->generation();
+			break;
+		case 8:
+			ecl::walk_chains<8>(heads, nchains, v);
+			break;
+		case 16:
+			ecl::walk_chains<16>(heads, nchains, v);
+			break;
+		}
+	}
+
+	gettimeofday(&tend, NULL);
+	g_sink = x + v.sum;
+
+	for (i = 0; i < nchains; i++)
+		while (!heads[i].empty())
+			heads[i].remove(heads[i].first());
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+	delete[] heads;
+
+	snprintf(name, sizeof(name), "ecl: walk %d chains, %s", nchains,
+	    width == 0 ? "one at a time" : width == 8 ? "8 interleaved" :
+	    "16 interleaved");
+	benchmark_result(name, (intmax_t)niter * nelem, &tstart, &tend);
+}
+
+/* Scrambles generations, so the list starts out in random key order */
+struct DataTailqSortKey {
+	uint32_t operator()(DataTailq *d) const {
+		return (uint32_t)d->generation() * 2654435761U;
+	}
+};
+
+struct DataTailqSortCompare {
+	int operator()(DataTailq *a, DataTailq *b) const {
+		uint32_t ka = key(a), kb = key(b);
+
+		return ka < kb ? -1 : ka > kb;
+	}
+
+	DataTailqSortKey key;
+};
+
+static void
+test_sort_ecl(int nelem, int niter, bool radix)
+{
+	struct timeval tstart, tend, tsort;
+	DataTailqHead head;
+	DataTailq *d, **buf;
+	char name[128];
+	int i, j;
+
+	buf = new DataTailq*[nelem];
+	for (i = 0; i < nelem; i++)
+		buf[i] = new DataTailq();
+
+	/* Only the sort itself is timed */
+	timerclear(&tsort);
+	for (j = 0; j < niter; j++) {
+		/* Restore the original, unsorted order */
+		for (i = 0; i < nelem; i++)
+			head.insert_tail(buf[i]);
+		gettimeofday(&tstart, NULL);
+		if (radix)
+			head.radix_sort(DataTailqSortKey());
+		else
+			head.sort(DataTailqSortCompare());
+		gettimeofday(&tend, NULL);
+		timersub(&tend, &tstart, &tend);
+		timeradd(&tsort, &tend, &tsort);
+		while (!head.empty())
+			head.remove(head.first());
+	}
+	timerclear(&tstart);
+
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	snprintf(name, sizeof(name), "ecl: tailq %s, %d elements",
+	    radix ? "radix_sort" : "sort", nelem);
+	benchmark_result(name, (intmax_t)niter * nelem, &tstart, &tsort);
+}
+
 static void
 test_map_add_remove_ecl(int *keys, int nelem, int niter)
 {
@@ -351,19 +810,364 @@ test_map_iterate_ecl(int *keys, int nelem, int niter)
 }
 
 static void
-test_map_iterate_stl(int *keys, int nelem, int niter)
+test_map_add_remove_hash(int *keys, int nelem, int niter)
 {
 	struct timeval tstart, tend;
-	std::map<int, DataPlain *> head;
-	std::map<int, DataPlain *>::iterator iter;
-	typedef std::map<int, DataPlain *>::value_type mappair;
-	DataPlain **buf, *d;
+	DataHashHead head;
+	DataHash **buf;
 	int i, j;
 
-	buf = new DataPlain*[nelem];
-	for (i = 0; i < nelem; i++) {
-		buf[i] = new DataPlain(keys[i]);
-		head.insert(mappair(buf[i]->generation(), buf[i]));
+	buf = new DataHash*[nelem];
+	for (i = 0; i < nelem; i++)
+		buf[i] = new DataHash(keys[i]);
+
+	gettimeofday(&tstart, NULL);
+
+	for (j = 0; j < niter; j++) {
+		for (i = 0; i < nelem; i++)
+			head.insert(buf[i]);
+		for (i = 0; i < nelem; i++)
+			head.remove(buf[i]);
+	}
+
+	gettimeofday(&tend, NULL);
+
+	assert(head.empty());
+
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	benchmark_result("ecl: add/remove hash", niter * nelem, &tstart, &tend);
+}
+
+static void
+test_map_iterate_hash(int *keys, int nelem, int niter)
+{
+	struct timeval tstart, tend;
+	DataHashHead head;
+	DataHash **buf, *d;
+	int i, j;
+
+	buf = new DataHash*[nelem];
+	for (i = 0; i < nelem; i++) {
+		buf[i] = new DataHash(keys[i]);
+		head.insert(buf[i]);
+	}
+
+	gettimeofday(&tstart, NULL);
+
+	for (j = 0; j < niter; j++) {
+		for (i = 0; i < nelem; i += 2) {
+			d = head.find(keys[i]);
+			if (d == NULL)
+				continue;
+			if (d->generation() != keys[i])
+				abort();
+		}
+		for (i = 1; i < nelem; i += 2) {
+			d = head.find(keys[i]);
+			if (d == NULL)
+				continue;
+			if (d->generation() != keys[i])
+				abort();
+		}
+		/* mostly negative */
+		for (i = 0; i < nelem; i++) {
+			d = head.find(i);
+			if (d == NULL)
+				continue;
+			if (d->generation() != i)
+				abort();
+		}
+	}
+
+	gettimeofday(&tend, NULL);
+
+	head.clear();
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	benchmark_result("ecl: iterate hash", niter * nelem, &tstart, &tend);
+}
+
+static void
+test_map_iterate_hashindex(int *keys, int nelem, int niter, bool batch)
+{
+	struct timeval tstart, tend;
+	DataHashIndex index;
+	DataHash **buf, **out, *d;
+	int *seq;
+	int i, j;
+
+	buf = new DataHash*[nelem];
+	out = new DataHash*[nelem];
+	seq = new int[nelem];
+	for (i = 0; i < nelem; i++) {
+		buf[i] = new DataHash(keys[i]);
+		index.insert(buf[i]);
+		seq[i] = i;
+	}
+
+	gettimeofday(&tstart, NULL);
+
+	for (j = 0; j < niter; j++) {
+		if (batch) {
+			index.find_batch(keys, nelem, out);
+			for (i = 0; i < nelem; i++)
+				if (out[i] == NULL ||
+				    out[i]->generation() != keys[i])
+					abort();
+			/* mostly negative */
+			index.find_batch(seq, nelem, out);
+			for (i = 0; i < nelem; i++)
+				if (out[i] != NULL && out[i]->generation() != i)
+					abort();
+			continue;
+		}
+		for (i = 0; i < nelem; i++) {
+			d = index.find(keys[i]);
+			if (d == NULL || d->generation() != keys[i])
+				abort();
+		}
+		/* mostly negative */
+		for (i = 0; i < nelem; i++) {
+			d = index.find(i);
+			if (d == NULL)
+				continue;
+			if (d->generation() != i)
+				abort();
+		}
+	}
+
+	gettimeofday(&tend, NULL);
+
+	index.clear();
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+	delete[] out;
+	delete[] seq;
+
+	benchmark_result(batch ? "ecl: iterate hashindex batch" :
+	    "ecl: iterate hashindex", niter * nelem, &tstart, &tend);
+}
+
+static void
+test_map_iterate_frozen(int *keys, int nelem, int niter)
+{
+	struct timeval tstart, tend;
+	DataTreeHead head;
+	DataTreeFrozen frozen;
+	DataTree **buf, *d;
+	int i, j;
+
+	buf = new DataTree*[nelem];
+	for (i = 0; i < nelem; i++) {
+		buf[i] = new DataTree(keys[i]);
+		head.insert(buf[i]);
+	}
+	frozen.freeze(&head);
+
+	gettimeofday(&tstart, NULL);
+
+	for (j = 0; j < niter; j++) {
+		for (i = 0; i < nelem; i += 2) {
+			d = frozen.find(keys[i]);
+			if (d == NULL)
+				continue;
+			if (d->generation() != keys[i])
+				abort();
+		}
+		for (i = 1; i < nelem; i += 2) {
+			d = frozen.find(keys[i]);
+			if (d == NULL)
+				continue;
+			if (d->generation() != keys[i])
+				abort();
+		}
+		/* mostly negative */
+		for (i = 0; i < nelem; i++) {
+			d = frozen.find(i);
+			if (d == NULL)
+				continue;
+			if (d->generation() != i)
+				abort();
+		}
+	}
+
+	gettimeofday(&tend, NULL);
+
+	frozen.clear();
+	for (i = 0; i < nelem; i++)
+		head.remove(buf[i]);
+
+	assert(head.empty());
+
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	benchmark_result("ecl: iterate frozen rbtree", niter * nelem,
+	    &tstart, &tend);
+}
+
+static void
+test_map_add_remove_bptree(int *keys, int nelem, int niter)
+{
+	struct timeval tstart, tend;
+	DataBPTreeHead head;
+	DataTree **buf;
+	int i, j;
+
+	buf = new DataTree*[nelem];
+	for (i = 0; i < nelem; i++)
+		buf[i] = new DataTree(keys[i]);
+
+	gettimeofday(&tstart, NULL);
+
+	for (j = 0; j < niter; j++) {
+		for (i = 0; i < nelem; i++)
+			head.insert(buf[i]);
+		for (i = 0; i < nelem; i++)
+			head.remove(buf[i]);
+	}
+
+	gettimeofday(&tend, NULL);
+
+	assert(head.empty());
+
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	benchmark_result("ecl: add/remove bptree", niter * nelem, &tstart, &tend);
+}
+
+static void
+test_map_iterate_bptree(int *keys, int nelem, int niter)
+{
+	struct timeval tstart, tend;
+	DataBPTreeHead head;
+	DataTree **buf, *d;
+	int i, j;
+
+	buf = new DataTree*[nelem];
+	for (i = 0; i < nelem; i++) {
+		buf[i] = new DataTree(keys[i]);
+		head.insert(buf[i]);
+	}
+
+	gettimeofday(&tstart, NULL);
+
+	for (j = 0; j < niter; j++) {
+		for (i = 0; i < nelem; i += 2) {
+			d = head.find(keys[i]);
+			if (d == NULL)
+				continue;
+			if (d->generation() != keys[i])
+				abort();
+		}
+		for (i = 1; i < nelem; i += 2) {
+			d = head.find(keys[i]);
+			if (d == NULL)
+				continue;
+			if (d->generation() != keys[i])
+				abort();
+		}
+		/* mostly negative */
+		for (i = 0; i < nelem; i++) {
+			d = head.find(i);
+			if (d == NULL)
+				continue;
+			if (d->generation() != i)
+				abort();
+		}
+	}
+
+	gettimeofday(&tend, NULL);
+
+	head.clear();
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	benchmark_result("ecl: iterate bptree", niter * nelem, &tstart, &tend);
+}
+
+template<typename HeadT, typename DataT>
+static void
+test_map_find_tree(const char *name, int *keys, int nelem, int niter)
+{
+	typedef typename DataT::tree EntryT;
+	struct timeval tstart, tend;
+	char tname[128];
+	HeadT head;
+	DataT **buf, *d, *p;
+	long depth, maxdepth, sumdepth;
+	int i, j;
+
+	buf = new DataT*[nelem];
+	for (i = 0; i < nelem; i++) {
+		buf[i] = new DataT(keys[i]);
+		head.insert(buf[i]);
+	}
+
+	for (i = 0, sumdepth = maxdepth = 0; i < nelem; i++) {
+		for (depth = 0, p = buf[i]; p != head.root(); depth++)
+			p = static_cast<EntryT *>(p)->parent();
+		sumdepth += depth;
+		if (depth > maxdepth)
+			maxdepth = depth;
+	}
+
+	gettimeofday(&tstart, NULL);
+
+	for (j = 0; j < niter; j++) {
+		for (i = 0; i < nelem; i++) {
+			d = head.find(keys[i]);
+			if (d == NULL || d->generation() != keys[i])
+				abort();
+		}
+		/* mostly negative */
+		for (i = 0; i < nelem; i++) {
+			d = head.find(i);
+			if (d != NULL && d->generation() != i)
+				abort();
+		}
+	}
+
+	gettimeofday(&tend, NULL);
+
+	for (i = 0; i < nelem; i++)
+		head.remove(buf[i]);
+
+	assert(head.empty());
+
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	snprintf(tname, sizeof(tname), "%s: find (depth avg %.2lf, max %ld)",
+	    name, (double)sumdepth / nelem, maxdepth);
+	benchmark_result(tname, niter * nelem * 2, &tstart, &tend);
+}
+
+static void
+test_map_iterate_stl(int *keys, int nelem, int niter)
+{
+	struct timeval tstart, tend;
+	std::map<int, DataPlain *> head;
+	std::map<int, DataPlain *>::iterator iter;
+	typedef std::map<int, DataPlain *>::value_type mappair;
+	DataPlain **buf, *d;
+	int i, j;
+
+	buf = new DataPlain*[nelem];
+	for (i = 0; i < nelem; i++) {
+		buf[i] = new DataPlain(keys[i]);
+		head.insert(mappair(buf[i]->generation(), buf[i]));
 	}
 
 	gettimeofday(&tstart, NULL);
@@ -409,6 +1213,597 @@ test_map_iterate_stl(int *keys, int nelem, int niter)
 	benchmark_result("stl: iterate rbtree", niter * nelem, &tstart, &tend);
 }
 
+/* Deletion heavy: remove every element in random order, then refill */
+template<typename HeadT, typename DataT>
+static void
+test_map_latency(const char *name, int *keys, int nelem, int niter)
+{
+	LatencyHist hins, hrem;
+	char hname[128];
+	HeadT head;
+	DataT **buf;
+	uint64_t t;
+	int i, j;
+
+	buf = new DataT*[nelem];
+	for (i = 0; i < nelem; i++) {
+		buf[i] = new DataT(keys[i]);
+		head.insert(buf[i]);
+	}
+
+	for (j = 0; j < niter; j++) {
+		for (i = 0; i < nelem; i++) {
+			t = LatencyHist::now();
+			head.remove(buf[(i * 7919 + j) % nelem]);
+			hrem.add(LatencyHist::now() - t);
+		}
+		for (i = 0; i < nelem; i++) {
+			t = LatencyHist::now();
+			head.insert(buf[i]);
+			hins.add(LatencyHist::now() - t);
+		}
+	}
+
+	for (i = 0; i < nelem; i++)
+		head.remove(buf[i]);
+	assert(head.empty());
+
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	snprintf(hname, sizeof(hname), "%s: remove", name);
+	latency_result(hname, &hrem);
+	snprintf(hname, sizeof(hname), "%s: insert", name);
+	latency_result(hname, &hins);
+}
+
+struct MapMtArg {
+	pthread_mutex_t *lock;
+	DataTreeHead *head;
+	DataTreeShardHead *shard;
+	DataTree **buf;
+	int from;
+	int to;
+	int niter;
+};
+
+static void *
+test_map_mt_ecl_thread(void *xarg)
+{
+	MapMtArg *arg = (MapMtArg *)xarg;
+	DataTree *d;
+	int i, j;
+
+	for (j = 0; j < arg->niter; j++) {
+		for (i = arg->from; i < arg->to; i++) {
+			pthread_mutex_lock(arg->lock);
+			arg->head->insert(arg->buf[i]);
+			pthread_mutex_unlock(arg->lock);
+		}
+		for (i = arg->from; i < arg->to; i++) {
+			pthread_mutex_lock(arg->lock);
+			d = arg->head->find(arg->buf[i]->generation());
+			pthread_mutex_unlock(arg->lock);
+			if (d != arg->buf[i])
+				abort();
+		}
+		for (i = arg->from; i < arg->to; i++) {
+			pthread_mutex_lock(arg->lock);
+			arg->head->remove(arg->buf[i]);
+			pthread_mutex_unlock(arg->lock);
+		}
+	}
+	return NULL;
+}
+
+static void *
+test_map_mt_shard_thread(void *xarg)
+{
+	MapMtArg *arg = (MapMtArg *)xarg;
+	DataTree *d;
+	int i, j;
+
+	for (j = 0; j < arg->niter; j++) {
+		for (i = arg->from; i < arg->to; i++)
+			arg->shard->insert(arg->buf[i]);
+		for (i = arg->from; i < arg->to; i++) {
+			d = arg->shard->find(arg->buf[i]->generation());
+			if (d != arg->buf[i])
+				abort();
+		}
+		for (i = arg->from; i < arg->to; i++)
+			arg->shard->remove(arg->buf[i]);
+	}
+	return NULL;
+}
+
+static void
+test_map_mt(int *keys, int nelem, int niter, int nthreads, int nshards)
+{
+	struct timeval tstart, tend;
+	pthread_mutex_t lock;
+	DataTreeHead head;
+	DataTreeShardHead *shard = NULL;
+	DataTree **buf;
+	MapMtArg *args;
+	pthread_t *tids;
+	int *bounds;
+	char name[128];
+	int i;
+
+	buf = new DataTree*[nelem];
+	for (i = 0; i < nelem; i++)
+		buf[i] = new DataTree(keys[i]);
+	pthread_mutex_init(&lock, NULL);
+	if (nshards > 0) {
+		/* Keys are uniform over [0, 2^31) */
+		bounds = new int[nshards];
+		for (i = 1; i < nshards; i++)
+			bounds[i - 1] = (int)(((int64_t)1 << 31) / nshards * i);
+		shard = new DataTreeShardHead(nshards, bounds);
+		delete[] bounds;
+	}
+	args = new MapMtArg[nthreads];
+	tids = new pthread_t[nthreads];
+
+	gettimeofday(&tstart, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		args[i].lock = &lock;
+		args[i].head = &head;
+		args[i].shard = shard;
+		args[i].buf = buf;
+		args[i].from = (int64_t)nelem * i / nthreads;
+		args[i].to = (int64_t)nelem * (i + 1) / nthreads;
+		args[i].niter = niter;
+		pthread_create(&tids[i], NULL, shard != NULL ?
+		    test_map_mt_shard_thread : test_map_mt_ecl_thread, &args[i]);
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tids[i], NULL);
+
+	gettimeofday(&tend, NULL);
+
+	assert(head.empty());
+	assert(shard == NULL || shard->empty());
+
+	delete[] tids;
+	delete[] args;
+	delete shard;
+	pthread_mutex_destroy(&lock);
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	if (nshards > 0)
+		snprintf(name, sizeof(name),
+		    "ecl: mt insert/find rbtree, %d threads, %d shards",
+		    nthreads, nshards);
+	else
+		snprintf(name, sizeof(name),
+		    "ecl: mt insert/find rbtree, %d threads, mutex", nthreads);
+	benchmark_result(name, niter * nelem, &tstart, &tend);
+}
+
+struct OrderedMtArg {
+	pthread_mutex_t *lock;
+	DataTreeHead *head;
+	DataTree **tbuf;
+	ecl::EpochDomain *domain;
+	DataSkipListHead *skiplist;
+	DataSkipList **sbuf;
+	int from;
+	int to;
+	int niter;
+	int scanned;
+};
+
+/* Scans this many objects after every 8th lookup */
+enum { MT_SCAN_LEN = 16 };
+
+static void *
+test_map_mt_ordered_rbtree_thread(void *xarg)
+{
+	OrderedMtArg *arg = (OrderedMtArg *)xarg;
+	DataTree *d;
+	int i, j, k;
+
+	for (j = 0; j < arg->niter; j++) {
+		for (i = arg->from; i < arg->to; i++) {
+			pthread_mutex_lock(arg->lock);
+			arg->head->insert(arg->tbuf[i]);
+			pthread_mutex_unlock(arg->lock);
+		}
+		for (i = arg->from; i < arg->to; i++) {
+			pthread_mutex_lock(arg->lock);
+			d = arg->head->find(arg->tbuf[i]->generation());
+			if (d != arg->tbuf[i])
+				abort();
+			if (i % 8 == 0)
+				for (k = 0; k < MT_SCAN_LEN && d != NULL; k++) {
+					d = d->next();
+					arg->scanned++;
+				}
+			pthread_mutex_unlock(arg->lock);
+		}
+		for (i = arg->from; i < arg->to; i++) {
+			pthread_mutex_lock(arg->lock);
+			arg->head->remove(arg->tbuf[i]);
+			pthread_mutex_unlock(arg->lock);
+		}
+	}
+	return NULL;
+}
+
+static void
+test_map_mt_release_nop(void *obj)
+{
+}
+
+static void *
+test_map_mt_ordered_skiplist_thread(void *xarg)
+{
+	OrderedMtArg *arg = (OrderedMtArg *)xarg;
+	ecl::EpochDomain::Thread thr(arg->domain);
+	DataSkipListHead::Iterator it;
+	DataSkipList *d;
+	int i, j, k;
+
+	for (j = 0; j < arg->niter; j++) {
+		for (i = arg->from; i < arg->to; i++) {
+			ecl::EpochDomain::Guard guard(&thr);
+
+			arg->skiplist->insert(arg->sbuf[i]);
+		}
+		for (i = arg->from; i < arg->to; i++) {
+			ecl::EpochDomain::Guard guard(&thr);
+
+			d = arg->skiplist->find(arg->sbuf[i]->generation());
+			if (d != arg->sbuf[i])
+				abort();
+			if (i % 8 == 0)
+				for (k = 0, d = it.init(arg->skiplist,
+				    d->generation()); k < MT_SCAN_LEN &&
+				    d != NULL; k++) {
+					d = it.next();
+					arg->scanned++;
+				}
+		}
+		for (i = arg->from; i < arg->to; i++) {
+			ecl::EpochDomain::Guard guard(&thr);
+
+			arg->skiplist->remove(arg->sbuf[i]);
+			thr.retire(arg->sbuf[i], test_map_mt_release_nop);
+		}
+		/* Objects are inserted again, wait for a grace period */
+		thr.barrier();
+	}
+	return NULL;
+}
+
+static void
+test_map_mt_ordered(int *keys, int nelem, int niter, int nthreads,
+    bool skiplist)
+{
+	struct timeval tstart, tend;
+	pthread_mutex_t lock;
+	ecl::EpochDomain domain;
+	DataTreeHead head;
+	DataSkipListHead slhead;
+	DataTree **tbuf = NULL;
+	DataSkipList **sbuf = NULL;
+	OrderedMtArg *args;
+	pthread_t *tids;
+	char name[128];
+	int i;
+
+	if (skiplist) {
+		sbuf = new DataSkipList*[nelem];
+		for (i = 0; i < nelem; i++)
+			sbuf[i] = new DataSkipList(keys[i]);
+	} else {
+		tbuf = new DataTree*[nelem];
+		for (i = 0; i < nelem; i++)
+			tbuf[i] = new DataTree(keys[i]);
+	}
+	pthread_mutex_init(&lock, NULL);
+	args = new OrderedMtArg[nthreads];
+	tids = new pthread_t[nthreads];
+
+	gettimeofday(&tstart, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		args[i].lock = &lock;
+		args[i].head = &head;
+		args[i].tbuf = tbuf;
+		args[i].domain = &domain;
+		args[i].skiplist = &slhead;
+		args[i].sbuf = sbuf;
+		args[i].from = (int64_t)nelem * i / nthreads;
+		args[i].to = (int64_t)nelem * (i + 1) / nthreads;
+		args[i].niter = niter;
+		args[i].scanned = 0;
+		pthread_create(&tids[i], NULL, skiplist ?
+		    test_map_mt_ordered_skiplist_thread :
+		    test_map_mt_ordered_rbtree_thread, &args[i]);
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tids[i], NULL);
+
+	gettimeofday(&tend, NULL);
+
+	assert(head.empty());
+	assert(slhead.empty());
+
+	delete[] tids;
+	delete[] args;
+	pthread_mutex_destroy(&lock);
+	for (i = 0; i < nelem; i++) {
+		if (skiplist)
+			delete sbuf[i];
+		else
+			delete tbuf[i];
+	}
+	delete[] sbuf;
+	delete[] tbuf;
+
+	snprintf(name, sizeof(name),
+	    "ecl: mt insert/find/scan, %d threads, %s", nthreads,
+	    skiplist ? "skiplist" : "rbtree, mutex");
+	benchmark_result(name, niter * nelem, &tstart, &tend);
+}
+
+struct HashMtArg {
+	pthread_mutex_t *lock;
+	DataTreeHead *head;
+	DataTree **tbuf;
+	DataCHashHead *chash;
+	DataHash **hbuf;
+	int *keys;
+	char *present;
+	int nelem;
+	int from;
+	int to;
+	int nops;
+	int read_pct;
+	int found;
+};
+
+/*
+ * Lookups go to random keys, updates toggle elements of the thread's own
+ * range in and out of the map.
+ */
+static void *
+test_map_mt_hash_thread(void *xarg)
+{
+	HashMtArg *arg = (HashMtArg *)xarg;
+	uint32_t r = arg->from * 2654435761U + 1;
+	int i, k, op, w = arg->from;
+
+	for (op = 0; op < arg->nops; op++) {
+		r = r * 1103515245 + 12345;
+		if ((int)(r >> 8) % 100 < arg->read_pct) {
+			k = arg->keys[(r >> 8) % arg->nelem];
+			if (arg->chash != NULL)
+				arg->found += arg->chash->find(k) != NULL;
+			else {
+				pthread_mutex_lock(arg->lock);
+				arg->found += arg->head->find(k) != NULL;
+				pthread_mutex_unlock(arg->lock);
+			}
+			continue;
+		}
+		i = w;
+		if (++w == arg->to)
+			w = arg->from;
+		if (arg->chash != NULL) {
+			if (arg->present[i])
+				arg->chash->remove(arg->hbuf[i]);
+			else
+				arg->chash->insert(arg->hbuf[i]);
+		} else {
+			pthread_mutex_lock(arg->lock);
+			if (arg->present[i])
+				arg->head->remove(arg->tbuf[i]);
+			else
+				arg->head->insert(arg->tbuf[i]);
+			pthread_mutex_unlock(arg->lock);
+		}
+		arg->present[i] ^= 1;
+	}
+	return NULL;
+}
+
+static void
+test_map_mt_hash(int *keys, int nelem, int nops, int nthreads, int read_pct,
+    bool concurrent)
+{
+	struct timeval tstart, tend;
+	pthread_mutex_t lock;
+	DataTreeHead head;
+	DataCHashHead chash;
+	DataTree **tbuf;
+	DataHash **hbuf;
+	HashMtArg *args;
+	pthread_t *tids;
+	char *present;
+	char name[128];
+	int i;
+
+	tbuf = new DataTree*[nelem];
+	hbuf = new DataHash*[nelem];
+	present = new char[nelem];
+	for (i = 0; i < nelem; i++) {
+		tbuf[i] = new DataTree(keys[i]);
+		hbuf[i] = new DataHash(keys[i]);
+		present[i] = i % 2 == 0;
+		if (!present[i])
+			continue;
+		if (concurrent)
+			chash.insert(hbuf[i]);
+		else
+			head.insert(tbuf[i]);
+	}
+	pthread_mutex_init(&lock, NULL);
+	args = new HashMtArg[nthreads];
+	tids = new pthread_t[nthreads];
+
+	gettimeofday(&tstart, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		args[i].lock = &lock;
+		args[i].head = &head;
+		args[i].tbuf = tbuf;
+		args[i].chash = concurrent ? &chash : NULL;
+		args[i].hbuf = hbuf;
+		args[i].keys = keys;
+		args[i].present = present;
+		args[i].nelem = nelem;
+		args[i].from = (int64_t)nelem * i / nthreads;
+		args[i].to = (int64_t)nelem * (i + 1) / nthreads;
+		args[i].nops = nops / nthreads;
+		args[i].read_pct = read_pct;
+		args[i].found = 0;
+		pthread_create(&tids[i], NULL, test_map_mt_hash_thread,
+		    &args[i]);
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tids[i], NULL);
+
+	gettimeofday(&tend, NULL);
+
+	for (i = 0; i < nelem; i++) {
+		if (!present[i])
+			continue;
+		if (concurrent)
+			chash.remove(hbuf[i]);
+		else
+			head.remove(tbuf[i]);
+	}
+	assert(head.empty());
+	assert(chash.empty());
+
+	delete[] tids;
+	delete[] args;
+	pthread_mutex_destroy(&lock);
+	for (i = 0; i < nelem; i++) {
+		delete tbuf[i];
+		delete hbuf[i];
+	}
+	delete[] tbuf;
+	delete[] hbuf;
+	delete[] present;
+
+	snprintf(name, sizeof(name),
+	    "ecl: mt find/update %d%% reads, %d threads, %s", read_pct,
+	    nthreads, concurrent ? "concurrent hash" : "rbtree, mutex");
+	benchmark_result(name, nops, &tstart, &tend);
+}
+
+static void
+test_map_mt_hash_all(int *keys, int nelem, int nops)
+{
+	static const int read_pcts[] = { 50, 90, 100 };
+	int i, nthreads;
+
+	for (i = 0; i < (int)(sizeof(read_pcts) / sizeof(read_pcts[0])); i++)
+		for (nthreads = 1; nthreads <= 64; nthreads *= 2) {
+			test_map_mt_hash(keys, nelem, nops, nthreads,
+			    read_pcts[i], false);
+			test_map_mt_hash(keys, nelem, nops, nthreads,
+			    read_pcts[i], true);
+		}
+}
+
+/* Zipf distributed lookups, rank r is drawn with probability ~ 1 / r^s */
+static int *
+test_gen_zipf_queries(int *keys, int nelem, int nqueries, double skew)
+{
+	double *cdf, sum, u;
+	int i, l, r, *queries;
+
+	cdf = new double[nelem];
+	for (i = 0, sum = 0; i < nelem; i++) {
+		sum += 1.0 / pow(i + 1, skew);
+		cdf[i] = sum;
+	}
+	queries = new int[nqueries];
+	for (i = 0; i < nqueries; i++) {
+		u = (double)random() / RAND_MAX * sum;
+		for (l = 0, r = nelem - 1; l < r;) {
+			if (cdf[(l + r) / 2] < u)
+				l = (l + r) / 2 + 1;
+			else
+				r = (l + r) / 2;
+		}
+		/* keys[] are random, so hot keys are spread over the key space */
+		queries[i] = keys[l];
+	}
+	delete[] cdf;
+	return queries;
+}
+
+template<typename HeadT, typename DataT>
+static void
+test_map_zipf(const char *name, HeadT &head, int *keys, int nelem,
+    int *queries, int nqueries)
+{
+	struct timeval tstart, tend;
+	DataT **buf, *d;
+	int i;
+
+	buf = new DataT*[nelem];
+	for (i = 0; i < nelem; i++) {
+		buf[i] = new DataT(keys[i]);
+		head.insert(buf[i]);
+	}
+
+	gettimeofday(&tstart, NULL);
+
+	for (i = 0; i < nqueries; i++) {
+		d = head.find(queries[i]);
+		if (d == NULL || d->generation() != queries[i])
+			abort();
+	}
+
+	gettimeofday(&tend, NULL);
+
+	for (i = 0; i < nelem; i++)
+		head.remove(buf[i]);
+
+	assert(head.empty());
+
+	for (i = 0; i < nelem; i++)
+		delete buf[i];
+	delete[] buf;
+
+	benchmark_result(name, nqueries, &tstart, &tend);
+}
+
+static void
+test_map_zipf_all(int *keys, int nelem, int nqueries, double skew)
+{
+	DataTreeHead rbhead;
+	DataSplayTreeHead sphead, sphead4;
+	char name[128];
+	int *queries;
+
+	queries = test_gen_zipf_queries(keys, nelem, nqueries, skew);
+	sphead4.set_splay_period(4);
+	snprintf(name, sizeof(name), "ecl: zipf %.2lf find rbtree", skew);
+	test_map_zipf<DataTreeHead, DataTree>(name,
+	    rbhead, keys, nelem, queries, nqueries);
+	snprintf(name, sizeof(name), "ecl: zipf %.2lf find splaytree", skew);
+	test_map_zipf<DataSplayTreeHead, DataSplayTree>(name,
+	    sphead, keys, nelem, queries, nqueries);
+	snprintf(name, sizeof(name),
+	    "ecl: zipf %.2lf find splaytree, splay every 4th", skew);
+	test_map_zipf<DataSplayTreeHead, DataSplayTree>(name,
+	    sphead4, keys, nelem, queries, nqueries);
+	delete[] queries;
+}
+
 static int
 key_cmp(const void *xa, const void *xb)
 {
@@ -483,16 +1878,62 @@ int main()
 	test_iterate_ecl(2000000, 10);
 	test_iterate_stl(2000000, 10);
 
+	test_iterate_shuffled_ecl(2000000, 10, 0, 0);
+	test_iterate_shuffled_ecl(2000000, 10, 1, 4);
+	test_iterate_shuffled_ecl(2000000, 10, 1, 8);
+	test_iterate_shuffled_ecl(2000000, 10, 1, 16);
+	test_iterate_shuffled_ecl(2000000, 10, 2, 8);
+
+	test_walk_chains_ecl(2000000, 500000, 10, 0);
+	test_walk_chains_ecl(2000000, 500000, 10, 8);
+	test_walk_chains_ecl(2000000, 500000, 10, 16);
+
+	test_sort_ecl(100000, 10, false);
+	test_sort_ecl(100000, 10, true);
+	test_sort_ecl(2000000, 2, false);
+	test_sort_ecl(2000000, 2, true);
+
 	keys = test_gen_random_keys(200000);
 	test_remove_dup_keys(keys, 200000);
 	test_map_add_remove_ecl(keys, 10000, 10);
 	test_map_add_remove_stl(keys, 10000, 10);
 	test_map_add_remove_ecl(keys, 200000, 10);
+	test_map_add_remove_bptree(keys, 200000, 10);
+	test_map_add_remove_hash(keys, 200000, 10);
 	test_map_add_remove_stl(keys, 200000, 10);
 	test_map_iterate_ecl(keys, 10000, 10);
+	test_map_iterate_hash(keys, 10000, 10);
+	test_map_iterate_frozen(keys, 10000, 10);
 	test_map_iterate_stl(keys, 10000, 10);
 	test_map_iterate_ecl(keys, 200000, 10);
+	test_map_iterate_hash(keys, 200000, 10);
+	test_map_iterate_hashindex(keys, 200000, 10, false);
+	test_map_iterate_hashindex(keys, 200000, 10, true);
+	test_map_iterate_frozen(keys, 200000, 10);
+	test_map_iterate_bptree(keys, 200000, 10);
 	test_map_iterate_stl(keys, 200000, 10);
+	test_map_find_tree<DataTreeHead, DataTree>("ecl: rbtree",
+	    keys, 200000, 10);
+	test_map_find_tree<DataWAVLTreeHead, DataWAVLTree>("ecl: wavltree",
+	    keys, 200000, 10);
+	test_map_find_tree<DataAVLTreeHead, DataAVLTree>("ecl: avltree",
+	    keys, 200000, 10);
+	test_map_zipf_all(keys, 200000, 2000000, 0.99);
+	test_map_zipf_all(keys, 200000, 2000000, 1.3);
+	test_map_latency<DataTreeHead, DataTree>("ecl: rbtree latency",
+	    keys, 200000, 5);
+	test_map_latency<DataWAVLTreeHead, DataWAVLTree>("ecl: wavltree latency",
+	    keys, 200000, 5);
+	test_map_mt(keys, 200000, 5, 1, 0);
+	test_map_mt(keys, 200000, 5, 4, 0);
+	test_map_mt(keys, 200000, 5, 4, 16);
+	test_map_mt_hash_all(keys, 200000, 400000);
+	test_map_mt_ordered(keys, 200000, 5, 1, false);
+	test_map_mt_ordered(keys, 200000, 5, 1, true);
+	test_map_mt_ordered(keys, 200000, 5, 4, false);
+	test_map_mt_ordered(keys, 200000, 5, 4, true);
+	test_map_mt_ordered(keys, 200000, 5, 16, false);
+	test_map_mt_ordered(keys, 200000, 5, 16, true);
 	free(keys);
 
 	return (0);
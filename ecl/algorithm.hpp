@@ -0,0 +1,277 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Prefetching traversal of intrusive lists.
+ *
+ * A plain next() loop misses on every node and only learns the address of
+ * the following node once the miss completes, so the work done per node
+ * never overlaps the walk.  PrefetchIterator keeps a second cursor
+ * distance nodes ahead of the one it returns and prefetches each node (and
+ * optionally a payload at a fixed offset into the object) as the cursor
+ * reaches it.  By the time an object is returned it has been in flight for
+ * distance steps.
+ *
+ * MultiCursor walks up to Width independent chains, e.g. hash buckets,
+ * round-robin.  The next node of every chain is prefetched before the
+ * visitor runs, so the misses of different chains overlap instead of
+ * being taken one after another.
+ *
+ * Works for any entry with a public next(), i.e. List, SList, Tailq,
+ * STailq and the trees.  The visited object may be removed, other objects
+ * within distance of it must not be.
+ */
+
+#ifndef ECL_ALGORITHM_HPP
+#define ECL_ALGORITHM_HPP
+
+#include <stddef.h>
+
+#include "impl.hpp"
+
+namespace ecl {
+
+namespace impl {
+
+enum { MULTI_CURSOR_WIDTH = 8 };
+
+const ptrdiff_t PREFETCH_NO_PAYLOAD = -1;
+
+} // namespace impl
+
+template <typename EntryT>
+class PrefetchIterator : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+
+	explicit PrefetchIterator(int distance = impl::PREFETCH_DISTANCE,
+	    ptrdiff_t payload = impl::PREFETCH_NO_PAYLOAD) : it_next(NULL),
+	    it_ahead(NULL), it_distance(distance < 1 ? 1 : distance),
+	    it_payload(payload) { }
+
+	template<typename HeadT>
+	ObjectType *init(HeadT *head) {
+		return start_at(head->first());
+	}
+
+	ObjectType *start_at(ObjectType *obj) {
+		int i;
+
+		it_next = obj;
+		it_ahead = obj;
+		for (i = 0; i < it_distance && it_ahead != NULL; i++) {
+			prefetch(it_ahead);
+			it_ahead = next_of(it_ahead);
+		}
+		if (it_ahead != NULL)
+			prefetch(it_ahead);
+		return next();
+	}
+
+	ObjectType *next() {
+		ObjectType *obj = it_next;
+
+		if (obj == NULL)
+			return NULL;
+		it_next = next_of(obj);
+		if (it_ahead != NULL) {
+			it_ahead = next_of(it_ahead);
+			if (it_ahead != NULL)
+				prefetch(it_ahead);
+		}
+		return obj;
+	}
+
+protected:
+	static ObjectType *next_of(ObjectType *obj) {
+		return static_cast<EntryType *>(obj)->next();
+	}
+
+	void prefetch(ObjectType *obj) const {
+		__builtin_prefetch(obj);
+		if (it_payload != impl::PREFETCH_NO_PAYLOAD)
+			__builtin_prefetch((char *)obj + it_payload);
+	}
+
+	ObjectType *it_next;
+	ObjectType *it_ahead;
+	int it_distance;
+	ptrdiff_t it_payload;
+};
+
+/* Calls fn(obj) for every object of head, returns fn */
+template<typename HeadT, typename FnT>
+FnT for_each(HeadT *head, FnT fn,
+    int distance = impl::PREFETCH_DISTANCE,
+    ptrdiff_t payload = impl::PREFETCH_NO_PAYLOAD) {
+	PrefetchIterator<typename HeadT::EntryType> it(distance, payload);
+	typename HeadT::ObjectType *obj;
+
+	for (obj = it.init(head); obj != NULL; obj = it.next())
+		fn(obj);
+	return fn;
+}
+
+/* Returns the first object with pred(obj) true or NULL */
+template<typename HeadT, typename PredT>
+typename HeadT::ObjectType *find_if(HeadT *head, PredT pred,
+    int distance = impl::PREFETCH_DISTANCE,
+    ptrdiff_t payload = impl::PREFETCH_NO_PAYLOAD) {
+	PrefetchIterator<typename HeadT::EntryType> it(distance, payload);
+	typename HeadT::ObjectType *obj;
+
+	for (obj = it.init(head); obj != NULL; obj = it.next())
+		if (pred(obj))
+			return obj;
+	return NULL;
+}
+
+template<typename HeadT, typename PredT>
+size_t count_if(HeadT *head, PredT pred,
+    int distance = impl::PREFETCH_DISTANCE,
+    ptrdiff_t payload = impl::PREFETCH_NO_PAYLOAD) {
+	PrefetchIterator<typename HeadT::EntryType> it(distance, payload);
+	typename HeadT::ObjectType *obj;
+	size_t n = 0;
+
+	for (obj = it.init(head); obj != NULL; obj = it.next())
+		if (pred(obj))
+			n++;
+	return n;
+}
+
+/*
+ * Visitors are called as visitor(obj, tag), with the tag the chain was
+ * added with, and return false to stop walking that chain.
+ */
+template <typename EntryT, int Width = impl::MULTI_CURSOR_WIDTH>
+class MultiCursor : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+
+	explicit MultiCursor(ptrdiff_t payload = impl::PREFETCH_NO_PAYLOAD) :
+	    mc_count(0), mc_payload(payload) { }
+
+	bool empty() const {
+		return (mc_count == 0);
+	}
+
+	bool full() const {
+		return (mc_count == Width);
+	}
+
+	int active() const {
+		return mc_count;
+	}
+
+	/* Empty chains are ignored */
+	void add(ObjectType *first, size_t tag) {
+		assert(!full());
+		if (first == NULL)
+			return;
+		prefetch(first);
+		mc_cur[mc_count] = first;
+		mc_tag[mc_count] = tag;
+		mc_count++;
+	}
+
+	template<typename HeadT>
+	void add(HeadT *head, size_t tag) {
+		add(head->first(), tag);
+	}
+
+	/* Visits one object of every chain, false once all are done */
+	template<typename VisitorT>
+	bool step(VisitorT &visitor) {
+		ObjectType *obj, *next;
+		int i;
+
+		for (i = 0; i < mc_count;) {
+			obj = mc_cur[i];
+			next = static_cast<EntryType *>(obj)->next();
+			if (next != NULL)
+				prefetch(next);
+			if (visitor(obj, mc_tag[i]) && next != NULL) {
+				mc_cur[i++] = next;
+				continue;
+			}
+			mc_count--;
+			mc_cur[i] = mc_cur[mc_count];
+			mc_tag[i] = mc_tag[mc_count];
+		}
+		return (mc_count != 0);
+	}
+
+	template<typename VisitorT>
+	void run(VisitorT &visitor) {
+		while (step(visitor))
+			;
+	}
+
+protected:
+	void prefetch(ObjectType *obj) const {
+		__builtin_prefetch(obj);
+		if (mc_payload != impl::PREFETCH_NO_PAYLOAD)
+			__builtin_prefetch((char *)obj + mc_payload);
+	}
+
+	ObjectType *mc_cur[Width];
+	size_t mc_tag[Width];
+	int mc_count;
+	ptrdiff_t mc_payload;
+};
+
+/*
+ * Walks the chains of heads[0 .. n - 1], Width at a time, the tag is the
+ * index of the head.  A finished chain is replaced with the next head
+ * after every round.
+ */
+template<int Width, typename HeadT, typename VisitorT>
+void walk_chains(HeadT *heads, size_t n, VisitorT &visitor,
+    ptrdiff_t payload = impl::PREFETCH_NO_PAYLOAD) {
+	MultiCursor<typename HeadT::EntryType, Width> mc(payload);
+	size_t i = 0;
+
+	for (;;) {
+		for (; i < n && !mc.full(); i++)
+			mc.add(&heads[i], i);
+		if (mc.empty())
+			break;
+		mc.step(visitor);
+	}
+}
+
+template<typename HeadT, typename VisitorT>
+void walk_chains(HeadT *heads, size_t n, VisitorT &visitor,
+    ptrdiff_t payload = impl::PREFETCH_NO_PAYLOAD) {
+	walk_chains<impl::MULTI_CURSOR_WIDTH>(heads, n, visitor, payload);
+}
+
+} // namespace ecl
+
+#endif
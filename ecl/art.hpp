@@ -0,0 +1,928 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Adaptive radix tree (Leis et al., ICDE 2013) for byte string keys.
+ *
+ * Leaves are the objects themselves, tagged with the low pointer bit.  The
+ * entry only holds the parent node, which together with parent links in
+ * inner nodes gives next()/prev() without a stack.
+ *
+ * Keys are returned by EntryType::key_fn(obj, &len) and must be prefix
+ * free: no key may be a prefix of another one (include the terminating NUL
+ * for C strings).  Order is lexicographic on unsigned bytes.
+ *
+ * Only the first MAX_PREFIX bytes of a compressed path are kept in the
+ * node, lookups skip the rest and compare the full key at the leaf.
+ */
+
+#ifndef ECL_ART_HPP
+#define ECL_ART_HPP
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "impl.hpp"
+
+namespace ecl {
+
+namespace impl {
+
+struct ARTNode {
+	enum { NODE4, NODE16, NODE48, NODE256 };
+	enum { MAX_PREFIX = 8 };
+
+	ARTNode *parent;
+	/* Index of the key byte children are indexed by */
+	uint32_t depth;
+	/* Compressed path length, key bytes [depth - plen, depth) */
+	uint32_t plen;
+	uint16_t n;
+	uint8_t type;
+	/* Key byte in the parent */
+	uint8_t pbyte;
+	uint8_t prefix[MAX_PREFIX];
+
+	static bool is_leaf(const void *p) {
+		return ((uintptr_t)p & 1) != 0;
+	}
+
+	static ARTNode *alloc(int type);
+	static void destroy(ARTNode *node);
+
+	bool full() const;
+	bool underfull() const;
+	void **find(int b);
+	/* Smallest present byte greater than b, -1 if none */
+	int next_byte(int b) const;
+	/* Largest present byte less than b, -1 if none */
+	int prev_byte(int b) const;
+	void add(int b, void *child);
+	void del(int b);
+};
+
+struct ARTNode4 : ARTNode {
+	uint8_t keys[4];
+	void *child[4];
+};
+
+struct ARTNode16 : ARTNode {
+	uint8_t keys[16];
+	void *child[16];
+};
+
+struct ARTNode48 : ARTNode {
+	/* Slot + 1, 0 if absent */
+	uint8_t index[256];
+	void *child[48];
+};
+
+struct ARTNode256 : ARTNode {
+	void *child[256];
+};
+
+inline ARTNode *
+ARTNode::alloc(int type)
+{
+	ARTNode *node = NULL;
+
+	switch (type) {
+	case NODE4:
+		node = new ARTNode4();
+		break;
+	case NODE16:
+		node = new ARTNode16();
+		break;
+	case NODE48:
+		node = new ARTNode48();
+		break;
+	case NODE256:
+		node = new ARTNode256();
+		break;
+	}
+	node->type = type;
+	return node;
+}
+
+inline void
+ARTNode::destroy(ARTNode *node)
+{
+	switch (node->type) {
+	case NODE4:
+		delete static_cast<ARTNode4 *>(node);
+		break;
+	case NODE16:
+		delete static_cast<ARTNode16 *>(node);
+		break;
+	case NODE48:
+		delete static_cast<ARTNode48 *>(node);
+		break;
+	case NODE256:
+		delete static_cast<ARTNode256 *>(node);
+		break;
+	}
+}
+
+inline bool
+ARTNode::full() const
+{
+	static const int max[] = { 4, 16, 48, 256 };
+
+	return n == max[type];
+}
+
+inline bool
+ARTNode::underfull() const
+{
+	static const int min[] = { 0, 3, 12, 40 };
+
+	return n <= min[type];
+}
+
+inline void **
+ARTNode::find(int b)
+{
+	int i;
+
+	switch (type) {
+	case NODE4: {
+		ARTNode4 *node = static_cast<ARTNode4 *>(this);
+		for (i = 0; i < n; i++)
+			if (node->keys[i] == b)
+				return &node->child[i];
+		return NULL;
+	}
+	case NODE16: {
+		ARTNode16 *node = static_cast<ARTNode16 *>(this);
+#ifdef __SSE2__
+		int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char)b),
+		    _mm_loadu_si128((const __m128i *)node->keys)));
+		m &= (1 << n) - 1;
+		return m == 0 ? NULL : &node->child[__builtin_ctz(m)];
+#else
+		for (i = 0; i < n; i++)
+			if (node->keys[i] == b)
+				return &node->child[i];
+		return NULL;
+#endif
+	}
+	case NODE48: {
+		ARTNode48 *node = static_cast<ARTNode48 *>(this);
+		i = node->index[b];
+		return i == 0 ? NULL : &node->child[i - 1];
+	}
+	case NODE256: {
+		ARTNode256 *node = static_cast<ARTNode256 *>(this);
+		return node->child[b] == NULL ? NULL : &node->child[b];
+	}
+	}
+	return NULL;
+}
+
+inline int
+ARTNode::next_byte(int b) const
+{
+	int i;
+
+	switch (type) {
+	case NODE4: {
+		const ARTNode4 *node = static_cast<const ARTNode4 *>(this);
+		for (i = 0; i < n; i++)
+			if (node->keys[i] > b)
+				return node->keys[i];
+		break;
+	}
+	case NODE16: {
+		const ARTNode16 *node = static_cast<const ARTNode16 *>(this);
+#ifdef __SSE2__
+		/* Flip the sign bit for an unsigned compare */
+		__m128i bias = _mm_set1_epi8((char)0x80);
+		int m;
+
+		if (b < 0)
+			return n == 0 ? -1 : node->keys[0];
+		m = _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_xor_si128(bias,
+		    _mm_loadu_si128((const __m128i *)node->keys)),
+		    _mm_set1_epi8((char)(b ^ 0x80))));
+		m &= (1 << n) - 1;
+		return m == 0 ? -1 : node->keys[__builtin_ctz(m)];
+#else
+		for (i = 0; i < n; i++)
+			if (node->keys[i] > b)
+				return node->keys[i];
+		break;
+#endif
+	}
+	case NODE48: {
+		const ARTNode48 *node = static_cast<const ARTNode48 *>(this);
+		for (i = b + 1; i < 256; i++)
+			if (node->index[i] != 0)
+				return i;
+		break;
+	}
+	case NODE256: {
+		const ARTNode256 *node = static_cast<const ARTNode256 *>(this);
+		for (i = b + 1; i < 256; i++)
+			if (node->child[i] != NULL)
+				return i;
+		break;
+	}
+	}
+	return -1;
+}
+
+inline int
+ARTNode::prev_byte(int b) const
+{
+	int i;
+
+	switch (type) {
+	case NODE4: {
+		const ARTNode4 *node = static_cast<const ARTNode4 *>(this);
+		for (i = n - 1; i >= 0; i--)
+			if (node->keys[i] < b)
+				return node->keys[i];
+		break;
+	}
+	case NODE16: {
+		const ARTNode16 *node = static_cast<const ARTNode16 *>(this);
+		for (i = n - 1; i >= 0; i--)
+			if (node->keys[i] < b)
+				return node->keys[i];
+		break;
+	}
+	case NODE48: {
+		const ARTNode48 *node = static_cast<const ARTNode48 *>(this);
+		for (i = b - 1; i >= 0; i--)
+			if (node->index[i] != 0)
+				return i;
+		break;
+	}
+	case NODE256: {
+		const ARTNode256 *node = static_cast<const ARTNode256 *>(this);
+		for (i = b - 1; i >= 0; i--)
+			if (node->child[i] != NULL)
+				return i;
+		break;
+	}
+	}
+	return -1;
+}
+
+/* Node must not be full */
+inline void
+ARTNode::add(int b, void *child)
+{
+	int i, j;
+
+	switch (type) {
+	case NODE4: {
+		ARTNode4 *node = static_cast<ARTNode4 *>(this);
+		for (i = 0; i < n && node->keys[i] < b; i++)
+			;
+		for (j = n; j > i; j--) {
+			node->keys[j] = node->keys[j - 1];
+			node->child[j] = node->child[j - 1];
+		}
+		node->keys[i] = b;
+		node->child[i] = child;
+		break;
+	}
+	case NODE16: {
+		ARTNode16 *node = static_cast<ARTNode16 *>(this);
+		for (i = 0; i < n && node->keys[i] < b; i++)
+			;
+		for (j = n; j > i; j--) {
+			node->keys[j] = node->keys[j - 1];
+			node->child[j] = node->child[j - 1];
+		}
+		node->keys[i] = b;
+		node->child[i] = child;
+		break;
+	}
+	case NODE48: {
+		ARTNode48 *node = static_cast<ARTNode48 *>(this);
+		for (i = 0; node->child[i] != NULL; i++)
+			;
+		node->child[i] = child;
+		node->index[b] = i + 1;
+		break;
+	}
+	case NODE256: {
+		ARTNode256 *node = static_cast<ARTNode256 *>(this);
+		node->child[b] = child;
+		break;
+	}
+	}
+	n++;
+}
+
+inline void
+ARTNode::del(int b)
+{
+	int i;
+
+	switch (type) {
+	case NODE4: {
+		ARTNode4 *node = static_cast<ARTNode4 *>(this);
+		for (i = 0; node->keys[i] != b; i++)
+			;
+		for (; i < n - 1; i++) {
+			node->keys[i] = node->keys[i + 1];
+			node->child[i] = node->child[i + 1];
+		}
+		break;
+	}
+	case NODE16: {
+		ARTNode16 *node = static_cast<ARTNode16 *>(this);
+		for (i = 0; node->keys[i] != b; i++)
+			;
+		for (; i < n - 1; i++) {
+			node->keys[i] = node->keys[i + 1];
+			node->child[i] = node->child[i + 1];
+		}
+		break;
+	}
+	case NODE48: {
+		ARTNode48 *node = static_cast<ARTNode48 *>(this);
+		node->child[node->index[b] - 1] = NULL;
+		node->index[b] = 0;
+		break;
+	}
+	case NODE256: {
+		ARTNode256 *node = static_cast<ARTNode256 *>(this);
+		node->child[b] = NULL;
+		break;
+	}
+	}
+	n--;
+}
+
+} // namespace impl
+
+template <typename EntryT>
+class ARTHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+
+	ARTHead() : arth_root(NULL), arth_count(0) { }
+
+	~ARTHead() {
+		clear();
+	}
+
+	bool empty() const {
+		return (arth_root == NULL);
+	}
+
+	size_t size() const {
+		return arth_count;
+	}
+
+	/* Frees inner nodes, objects are left alone */
+	void clear() {
+		if (arth_root != NULL)
+			destroy_subtree(arth_root);
+		arth_root = NULL;
+		arth_count = 0;
+	}
+
+	ObjectType *first() {
+		return min();
+	}
+
+	const ObjectType *first() const {
+		return min();
+	}
+
+	ObjectType *last() {
+		return max();
+	}
+
+	const ObjectType *last() const {
+		return max();
+	}
+
+	ObjectType *min() const {
+		return arth_root == NULL ? NULL : min_leaf(arth_root);
+	}
+
+	ObjectType *max() const {
+		return arth_root == NULL ? NULL : max_leaf(arth_root);
+	}
+
+	ObjectType *find(const void *key, size_t len) const {
+		const uint8_t *k = (const uint8_t *)key;
+		const uint8_t *okey;
+		impl::ARTNode *node;
+		ObjectType *obj;
+		size_t olen;
+		void *p, **ref;
+
+		p = arth_root;
+		while (p != NULL && !impl::ARTNode::is_leaf(p)) {
+			node = (impl::ARTNode *)p;
+			if (node->depth >= len)
+				return NULL;
+			if (memcmp(node->prefix, k + node->depth - node->plen,
+			    prefix_min(node->plen)) != 0)
+				return NULL;
+			ref = node->find(k[node->depth]);
+			if (ref == NULL)
+				return NULL;
+			p = *ref;
+			__builtin_prefetch(p);
+		}
+		if (p == NULL)
+			return NULL;
+		obj = leaf_obj(p);
+		okey = key_fn(obj, &olen);
+		if (olen != len || memcmp(okey, k, len) != 0)
+			return NULL;
+		return obj;
+	}
+
+	ObjectType *find_element(const ObjectType *elm) const {
+		const uint8_t *key;
+		size_t len;
+
+		key = key_fn(elm, &len);
+		return find(key, len);
+	}
+
+	/* Returns an object with the same key if already present */
+	ObjectType *insert(ObjectType *obj) {
+		const uint8_t *key, *okey;
+		impl::ARTNode *node, *nn, *parent;
+		ObjectType *other;
+		size_t len, olen, start, i;
+		void *p, **ref, **cref;
+		int b, pbyte;
+
+		key = key_fn(obj, &len);
+		if (arth_root == NULL) {
+			entry(obj)->arte_parent = NULL;
+			arth_root = leaf_tag(obj);
+			arth_count++;
+			return NULL;
+		}
+		ref = &arth_root;
+		parent = NULL;
+		pbyte = 0;
+		start = 0;
+		for (;;) {
+			p = *ref;
+			if (impl::ARTNode::is_leaf(p)) {
+				other = leaf_obj(p);
+				okey = key_fn(other, &olen);
+				for (i = start; i < len && i < olen &&
+				    key[i] == okey[i]; i++)
+					;
+				if (i == len && i == olen)
+					return other;
+				/* Keys must be prefix free */
+				assert(i < len && i < olen);
+				nn = alloc_node(parent, pbyte, i, i - start,
+				    key + start);
+				add_child(nn, okey[i], p);
+				add_child(nn, key[i], leaf_tag(obj));
+				*ref = nn;
+				break;
+			}
+			node = (impl::ARTNode *)p;
+			i = prefix_mismatch(node, key, len);
+			if (i < node->plen) {
+				start = node->depth - node->plen;
+				assert(start + i < len);
+				okey = key_fn(min_leaf(node), &olen);
+				nn = alloc_node(node->parent, node->pbyte,
+				    start + i, i, key + start);
+				node->plen -= i + 1;
+				set_prefix(node, okey);
+				add_child(nn, okey[start + i], node);
+				add_child(nn, key[start + i], leaf_tag(obj));
+				*ref = nn;
+				break;
+			}
+			assert(node->depth < len);
+			b = key[node->depth];
+			cref = node->find(b);
+			if (cref == NULL) {
+				if (node->full())
+					node = resize(ref, node->type + 1);
+				add_child(node, b, leaf_tag(obj));
+				break;
+			}
+			parent = node;
+			pbyte = b;
+			start = node->depth + 1;
+			ref = cref;
+		}
+		arth_count++;
+		return NULL;
+	}
+
+	ObjectType *remove(ObjectType *elm) {
+		impl::ARTNode *node;
+		const uint8_t *key;
+		size_t len;
+
+		node = entry(elm)->arte_parent;
+		arth_count--;
+		if (node == NULL) {
+			assert(arth_root == leaf_tag(elm));
+			arth_root = NULL;
+			return elm;
+		}
+		key = key_fn(elm, &len);
+		assert(*node->find(key[node->depth]) == leaf_tag(elm));
+		node->del(key[node->depth]);
+		if (node->type == impl::ARTNode::NODE4 && node->n == 1)
+			collapse(node);
+		else if (node->underfull())
+			resize(parent_ref(node), node->type - 1);
+		return elm;
+	}
+
+	/* Iterates over all objects whose key starts with prefix */
+	struct PrefixIterator : impl::NonCopyable {
+		ObjectType *init(const ARTHead *head, const void *prefix,
+		    size_t len) {
+			void *p;
+
+			p = head->prefix_subtree((const uint8_t *)prefix, len);
+			if (p == NULL) {
+				it_next = it_last = NULL;
+				return NULL;
+			}
+			it_next = min_leaf(p);
+			it_last = max_leaf(p);
+			return next();
+		}
+
+		ObjectType *next() {
+			ObjectType *obj = it_next;
+
+			if (obj == it_last)
+				it_next = NULL;
+			else if (obj != NULL)
+				it_next = entry(obj)->next();
+			return obj;
+		}
+
+	private:
+		ObjectType *it_next;
+		ObjectType *it_last;
+	};
+
+protected:
+	static const uint8_t *key_fn(const ObjectType *obj, size_t *len) {
+		return EntryType::key_fn(obj, len);
+	}
+
+	static EntryType *entry(ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	static void *leaf_tag(const ObjectType *obj) {
+		return EntryType::leaf_tag(obj);
+	}
+
+	static ObjectType *leaf_obj(const void *p) {
+		return EntryType::leaf_obj(p);
+	}
+
+	static ObjectType *min_leaf(const void *p) {
+		return EntryType::min_leaf(p);
+	}
+
+	static ObjectType *max_leaf(const void *p) {
+		return EntryType::max_leaf(p);
+	}
+
+	static size_t prefix_min(size_t plen) {
+		return plen < impl::ARTNode::MAX_PREFIX ?
+		    plen : (size_t)impl::ARTNode::MAX_PREFIX;
+	}
+
+	/* Refreshes stored path bytes from a key in the subtree */
+	static void set_prefix(impl::ARTNode *node, const uint8_t *key) {
+		memcpy(node->prefix, key + node->depth - node->plen,
+		    prefix_min(node->plen));
+	}
+
+	static size_t prefix_mismatch(impl::ARTNode *node, const uint8_t *key,
+	    size_t len) {
+		const uint8_t *okey = NULL;
+		size_t i, olen, start;
+		int b;
+
+		start = node->depth - node->plen;
+		for (i = 0; i < node->plen; i++) {
+			if (start + i >= len)
+				return i;
+			if (i < impl::ARTNode::MAX_PREFIX)
+				b = node->prefix[i];
+			else {
+				if (okey == NULL)
+					okey = key_fn(min_leaf(node), &olen);
+				b = okey[start + i];
+			}
+			if (b != key[start + i])
+				return i;
+		}
+		return node->plen;
+	}
+
+	static impl::ARTNode *alloc_node(impl::ARTNode *parent, int pbyte,
+	    size_t depth, size_t plen, const uint8_t *prefix) {
+		impl::ARTNode *node;
+
+		node = impl::ARTNode::alloc(impl::ARTNode::NODE4);
+		node->parent = parent;
+		node->pbyte = pbyte;
+		node->depth = depth;
+		node->plen = plen;
+		memcpy(node->prefix, prefix, prefix_min(plen));
+		return node;
+	}
+
+	static void set_parent(void *child, impl::ARTNode *node, int b) {
+		impl::ARTNode *cnode;
+
+		if (impl::ARTNode::is_leaf(child))
+			entry(leaf_obj(child))->arte_parent = node;
+		else {
+			cnode = (impl::ARTNode *)child;
+			cnode->parent = node;
+			cnode->pbyte = b;
+		}
+	}
+
+	static void add_child(impl::ARTNode *node, int b, void *child) {
+		node->add(b, child);
+		set_parent(child, node, b);
+	}
+
+	void **parent_ref(impl::ARTNode *node) {
+		if (node->parent == NULL)
+			return &arth_root;
+		return node->parent->find(node->pbyte);
+	}
+
+	/* Replaces *ref with a copy of a different size */
+	impl::ARTNode *resize(void **ref, int type) {
+		impl::ARTNode *node, *nn;
+		int b;
+
+		node = (impl::ARTNode *)*ref;
+		nn = impl::ARTNode::alloc(type);
+		nn->parent = node->parent;
+		nn->depth = node->depth;
+		nn->plen = node->plen;
+		nn->pbyte = node->pbyte;
+		memcpy(nn->prefix, node->prefix, sizeof(nn->prefix));
+		for (b = node->next_byte(-1); b >= 0; b = node->next_byte(b))
+			add_child(nn, b, *node->find(b));
+		*ref = nn;
+		impl::ARTNode::destroy(node);
+		return nn;
+	}
+
+	/* Merges a node with a single child into the child */
+	void collapse(impl::ARTNode *node) {
+		impl::ARTNode *cnode;
+		const uint8_t *key;
+		void *child;
+		size_t len;
+
+		child = *node->find(node->next_byte(-1));
+		*parent_ref(node) = child;
+		if (impl::ARTNode::is_leaf(child))
+			entry(leaf_obj(child))->arte_parent = node->parent;
+		else {
+			cnode = (impl::ARTNode *)child;
+			cnode->plen += node->plen + 1;
+			cnode->parent = node->parent;
+			cnode->pbyte = node->pbyte;
+			key = key_fn(min_leaf(cnode), &len);
+			set_prefix(cnode, key);
+		}
+		impl::ARTNode::destroy(node);
+	}
+
+	void *prefix_subtree(const uint8_t *prefix, size_t len) const {
+		const uint8_t *okey;
+		impl::ARTNode *node;
+		void *p, **ref;
+		size_t olen;
+
+		p = arth_root;
+		while (p != NULL && !impl::ARTNode::is_leaf(p)) {
+			node = (impl::ARTNode *)p;
+			if (node->depth >= len)
+				break;
+			ref = node->find(prefix[node->depth]);
+			if (ref == NULL)
+				return NULL;
+			p = *ref;
+		}
+		if (p == NULL)
+			return NULL;
+		/* All keys below p share the first len bytes */
+		okey = key_fn(min_leaf(p), &olen);
+		if (olen < len || memcmp(okey, prefix, len) != 0)
+			return NULL;
+		return p;
+	}
+
+	static void destroy_subtree(void *p) {
+		impl::ARTNode *node;
+		int b;
+
+		if (impl::ARTNode::is_leaf(p))
+			return;
+		node = (impl::ARTNode *)p;
+		for (b = node->next_byte(-1); b >= 0; b = node->next_byte(b))
+			destroy_subtree(*node->find(b));
+		impl::ARTNode::destroy(node);
+	}
+
+private:
+	void *arth_root;
+	size_t arth_count;
+};
+
+template <typename EntryT, typename ObjectT>
+class ARTEntry : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef ObjectT ObjectType;
+
+	friend class ARTHead<EntryType>;
+	friend class impl::Iterator<EntryType>;
+	friend class impl::ConstIterator<EntryType>;
+	friend class impl::ReverseIterator<EntryType>;
+	friend class impl::ConstReverseIterator<EntryType>;
+
+	struct Iterator : impl::Iterator<EntryType> {
+		typedef impl::Iterator<EntryType> Base;
+		ObjectType *init(ARTHead<EntryType> *head) {
+			return Base::start_at(head->first());
+		}
+	};
+
+	struct ConstIterator : impl::ConstIterator<EntryType> {
+		typedef impl::ConstIterator<EntryType> Base;
+		const ObjectType *init(const ARTHead<EntryType> *head) {
+			return Base::start_at(head->first());
+		}
+	};
+
+	struct ReverseIterator : impl::ReverseIterator<EntryType> {
+		typedef impl::ReverseIterator<EntryType> Base;
+		ObjectType *init(ARTHead<EntryType> *head) {
+			return Base::start_at(head->last());
+		}
+	};
+
+	struct ConstReverseIterator : impl::ConstReverseIterator<EntryType> {
+		typedef impl::ConstReverseIterator<EntryType> Base;
+		const ObjectType *init(const ARTHead<EntryType> *head) {
+			return Base::start_at(head->last());
+		}
+	};
+
+	ARTEntry() : arte_parent(NULL) { }
+
+	ObjectType *next() {
+		return next_impl();
+	}
+
+	const ObjectType *next() const {
+		return next_impl();
+	}
+
+	ObjectType *prev() {
+		return prev_impl();
+	}
+
+	const ObjectType *prev() const {
+		return prev_impl();
+	}
+
+protected:
+	static EntryType *entry(ObjectType *obj) {
+		return obj;
+	}
+
+	static const EntryType *entry(const ObjectType *obj) {
+		return obj;
+	}
+
+	ObjectType *object() const {
+		return impl::entry_to_object<ObjectType, ARTEntry>(this);
+	}
+
+	static void *leaf_tag(const ObjectType *obj) {
+		return (void *)((uintptr_t)obj | 1);
+	}
+
+	static ObjectType *leaf_obj(const void *p) {
+		return (ObjectType *)((uintptr_t)p & ~(uintptr_t)1);
+	}
+
+	static ObjectType *min_leaf(const void *p) {
+		const impl::ARTNode *node;
+
+		while (!impl::ARTNode::is_leaf(p)) {
+			node = (const impl::ARTNode *)p;
+			p = *const_cast<impl::ARTNode *>(node)->find(
+			    node->next_byte(-1));
+		}
+		return leaf_obj(p);
+	}
+
+	static ObjectType *max_leaf(const void *p) {
+		const impl::ARTNode *node;
+
+		while (!impl::ARTNode::is_leaf(p)) {
+			node = (const impl::ARTNode *)p;
+			p = *const_cast<impl::ARTNode *>(node)->find(
+			    node->prev_byte(256));
+		}
+		return leaf_obj(p);
+	}
+
+	int parent_byte() const {
+		const uint8_t *key;
+		size_t len;
+
+		key = EntryType::key_fn(object(), &len);
+		return key[arte_parent->depth];
+	}
+
+	ObjectType *next_impl() const {
+		impl::ARTNode *node = arte_parent;
+		int b;
+
+		if (node == NULL)
+			return NULL;
+		for (b = parent_byte(); node != NULL; node = node->parent) {
+			b = node->next_byte(b);
+			if (b >= 0)
+				return min_leaf(*node->find(b));
+			b = node->pbyte;
+		}
+		return NULL;
+	}
+
+	ObjectType *prev_impl() const {
+		impl::ARTNode *node = arte_parent;
+		int b;
+
+		if (node == NULL)
+			return NULL;
+		for (b = parent_byte(); node != NULL; node = node->parent) {
+			b = node->prev_byte(b);
+			if (b >= 0)
+				return max_leaf(*node->find(b));
+			b = node->pbyte;
+		}
+		return NULL;
+	}
+
+private:
+	impl::ARTNode *arte_parent;
+};
+
+} // namespace ecl
+
+#endif
@@ -0,0 +1,787 @@
+/*-
+ * Copyright 2002 Niels Provos <provos@citi.umich.edu>
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * AVL tree with the same interface as RBTreeHead.  Stricter balance keeps
+ * the height below 1.44 * log2(n) which makes lookups cheaper at the
+ * expense of more rotations on update.  The balance factor is stored in
+ * the two low bits of the parent pointer, objects must be at least 4 byte
+ * aligned.
+ */
+
+#ifndef ECL_AVLTREE_HPP
+#define ECL_AVLTREE_HPP
+
+#include "impl.hpp"
+
+namespace ecl {
+
+namespace policy { // {{{
+
+struct AVLTree {
+	struct Default : policy::Generic { };
+
+};
+
+} // namespace policy }}}
+
+template<typename EntryT>
+struct AVLTreePolicy : policy::AVLTree::Default { };
+
+template <typename EntryT>
+class AVLTreeHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+	typedef typename EntryType::Policy Policy;
+
+	friend struct policy::AVLTree;
+
+	AVLTreeHead() : avlh_root(NULL) { }
+
+	bool empty() const {
+		return (avlh_root == NULL);
+	}
+
+	ObjectType *root() {
+		return avlh_root;
+	}
+
+	const ObjectType *root() const {
+		return avlh_root;
+	}
+
+	ObjectType *first() {
+		return min();
+	}
+
+	const ObjectType *first() const {
+		return min();
+	}
+
+	ObjectType *last() {
+		return max();
+	}
+
+	const ObjectType *last() const {
+		return max();
+	}
+
+	ObjectType *min() {
+		return min_impl();
+	}
+
+	const ObjectType *min() const {
+		return min_impl();
+	}
+
+	ObjectType *max() {
+		return max_impl();
+	}
+
+	const ObjectType *max() const {
+		return max_impl();
+	}
+
+	template<typename KeyType>
+	ObjectType *find(const KeyType &key) {
+		return find_impl(key);
+	}
+
+	/* Finds the node with the same key as elm */
+	template<typename KeyType>
+	const ObjectType *find(const KeyType &key) const {
+		return find_impl(key);
+	}
+
+	ObjectType *find_element(const ObjectType *elm) {
+		return find_element_impl(elm);
+	}
+
+	const ObjectType *find_element(const ObjectType *elm) const {
+		return find_element_impl(elm);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *nfind(const KeyType &key) {
+		return nfind_impl(key);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	const ObjectType *nfind(const KeyType &key) const {
+		return nfind_impl(key);
+	}
+
+	ObjectType *nfind_element(const ObjectType *elm) {
+		return nfind_element_impl(elm);
+	}
+
+	const ObjectType *nfind_element(const ObjectType *elm) const {
+		return nfind_element_impl(elm);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *pfind(const KeyType &key) {
+		return pfind_impl(key);
+	}
+
+	template<typename KeyType>
+	const ObjectType *pfind(const KeyType &key) const {
+		return pfind_impl(key);
+	}
+
+	ObjectType *pfind_element(const ObjectType *elm) {
+		return pfind_element_impl(elm);
+	}
+
+	const ObjectType *pfind_element(const ObjectType *elm) const {
+		return pfind_element_impl(elm);
+	}
+
+	ObjectType *insert(ObjectType *obj) {
+		ObjectType *tmp;
+		ObjectType *parent = NULL;
+		int comp = 0;
+
+		tmp = avlh_root;
+		while (tmp) {
+			parent = tmp;
+			comp = compare(obj, parent);
+			if (comp < 0)
+				tmp = entry(tmp)->avle_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->avle_right;
+			else
+				return tmp;
+		}
+		entry(obj)->init(parent);
+		if (parent != NULL) {
+			if (comp < 0)
+				entry(parent)->avle_left = obj;
+			else
+				entry(parent)->avle_right = obj;
+		} else
+			avlh_root = obj;
+		insert_balance(obj);
+		return NULL;
+	}
+
+	ObjectType *remove(ObjectType *elm) {
+		ObjectType *child, *parent, *old;
+		bool left;
+
+		old = elm;
+		if (entry(elm)->avle_left == NULL)
+			child = entry(elm)->avle_right;
+		else if (entry(elm)->avle_right == NULL)
+			child = entry(elm)->avle_left;
+		else {
+			remove_nontrivial(elm);
+			return old;
+		}
+		parent = entry(elm)->parent();
+		left = false;
+		if (child)
+			entry(child)->set_parent(parent);
+		if (parent) {
+			if (entry(parent)->avle_left == elm) {
+				entry(parent)->avle_left = child;
+				left = true;
+			} else
+				entry(parent)->avle_right = child;
+		} else
+			avlh_root = child;
+		remove_balance(parent, left);
+		return old;
+	}
+
+protected:
+	static int compare(const ObjectType *a, const ObjectType *b) {
+		return EntryType::compare(a, b);
+	}
+
+	template<typename KeyType>
+	static int compare_key(const KeyType &k, const ObjectType *obj) {
+		return EntryType::compare_key(k, obj);
+	}
+
+	static EntryType *entry(ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	static int balance(ObjectType *obj) {
+		return entry(obj)->balance();
+	}
+
+	static void set_balance(ObjectType *obj, int bal) {
+		entry(obj)->set_balance(bal);
+	}
+
+	ObjectType *min_impl() const {
+		ObjectType *parent, *tmp;
+
+		for (tmp = avlh_root, parent = NULL; tmp;) {
+			parent = tmp;
+			tmp = entry(tmp)->avle_left;
+		}
+		return parent;
+	}
+
+	ObjectType *max_impl() const {
+		ObjectType *parent, *tmp;
+
+		for (tmp = avlh_root, parent = NULL; tmp;) {
+			parent = tmp;
+			tmp = entry(tmp)->avle_right;
+		}
+		return parent;
+	}
+
+	template<typename KeyType>
+	ObjectType *find_impl(const KeyType &key) const {
+		ObjectType *tmp = avlh_root;
+		int comp;
+
+		while (tmp) {
+			comp = compare_key(key, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->avle_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->avle_right;
+			else
+				return tmp;
+		}
+		return NULL;
+	}
+
+	ObjectType *find_element_impl(const ObjectType *elm) const {
+		ObjectType *tmp = avlh_root;
+		int comp;
+
+		while (tmp) {
+			comp = compare(elm, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->avle_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->avle_right;
+			else
+				return tmp;
+		}
+		return NULL;
+	}
+
+	template<typename KeyType>
+	ObjectType *nfind_impl(const KeyType &key) const {
+		ObjectType *tmp = avlh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare_key(key, tmp);
+			if (comp < 0) {
+				res = tmp;
+				tmp = entry(tmp)->avle_left;
+			} else if (comp > 0)
+				tmp = entry(tmp)->avle_right;
+			else
+				return tmp;
+		}
+		return res;
+	}
+
+	ObjectType *nfind_element_impl(const ObjectType *elm) const {
+		ObjectType *tmp = avlh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare(elm, tmp);
+			if (comp < 0) {
+				res = tmp;
+				tmp = entry(tmp)->avle_left;
+			} else if (comp > 0)
+				tmp = entry(tmp)->avle_right;
+			else
+				return tmp;
+		}
+		return res;
+	}
+
+	template<typename KeyType>
+	ObjectType *pfind_impl(const KeyType &key) const {
+		ObjectType *tmp = avlh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare_key(key, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->avle_left;
+			else if (comp > 0) {
+				res = tmp;
+				tmp = entry(tmp)->avle_right;
+			} else
+				return tmp;
+		}
+		return res;
+	}
+
+	ObjectType *pfind_element_impl(const ObjectType *elm) const {
+		ObjectType *tmp = avlh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare(elm, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->avle_left;
+			else if (comp > 0) {
+				res = tmp;
+				tmp = entry(tmp)->avle_right;
+			} else
+				return tmp;
+		}
+		return res;
+	}
+
+	void insert_balance(ObjectType *elm) {
+		ObjectType *parent;
+
+		for (; (parent = entry(elm)->parent()) != NULL; elm = parent) {
+			if (entry(parent)->avle_left == elm) {
+				if (balance(parent) > 0) {
+					set_balance(parent, 0);
+					break;
+				} else if (balance(parent) == 0) {
+					set_balance(parent, -1);
+					continue;
+				}
+				if (balance(elm) > 0)
+					rotate_left_right(parent);
+				else
+					rotate_right_balance(parent);
+				break;
+			} else {
+				if (balance(parent) < 0) {
+					set_balance(parent, 0);
+					break;
+				} else if (balance(parent) == 0) {
+					set_balance(parent, 1);
+					continue;
+				}
+				if (balance(elm) < 0)
+					rotate_right_left(parent);
+				else
+					rotate_left_balance(parent);
+				break;
+			}
+		}
+	}
+
+	/* Height of the left or right subtree of parent went down by one */
+	void remove_balance(ObjectType *parent, bool left) {
+		ObjectType *sibling, *top;
+		int bal;
+
+		while (parent != NULL) {
+			if (left) {
+				if (balance(parent) < 0) {
+					set_balance(parent, 0);
+					top = parent;
+				} else if (balance(parent) == 0) {
+					set_balance(parent, 1);
+					break;
+				} else {
+					sibling = entry(parent)->avle_right;
+					bal = balance(sibling);
+					if (bal < 0)
+						top = rotate_right_left(parent);
+					else
+						top = rotate_left_balance(parent);
+					if (bal == 0)
+						break;
+				}
+			} else {
+				if (balance(parent) > 0) {
+					set_balance(parent, 0);
+					top = parent;
+				} else if (balance(parent) == 0) {
+					set_balance(parent, -1);
+					break;
+				} else {
+					sibling = entry(parent)->avle_left;
+					bal = balance(sibling);
+					if (bal > 0)
+						top = rotate_left_right(parent);
+					else
+						top = rotate_right_balance(parent);
+					if (bal == 0)
+						break;
+				}
+			}
+			parent = entry(top)->parent();
+			if (parent != NULL)
+				left = (entry(parent)->avle_left == top);
+		}
+	}
+
+	ObjectType *remove_nontrivial(ObjectType *elm) {
+		ObjectType *child, *parent, *left, *old;
+		bool shrank_left;
+
+		old = elm;
+		elm = entry(elm)->avle_right;
+		while ((left = entry(elm)->avle_left) != NULL)
+			elm = left;
+		child = entry(elm)->avle_right;
+		parent = entry(elm)->parent();
+		if (child)
+			entry(child)->set_parent(parent);
+		if (entry(parent)->avle_left == elm) {
+			entry(parent)->avle_left = child;
+			shrank_left = true;
+		} else {
+			entry(parent)->avle_right = child;
+			shrank_left = false;
+		}
+		if (parent == old)
+			parent = elm;
+		entry(elm)->init_copy(entry(old));
+		if (entry(old)->parent()) {
+			if (entry(entry(old)->parent())->avle_left == old)
+				entry(entry(old)->parent())->avle_left = elm;
+			else
+				entry(entry(old)->parent())->avle_right = elm;
+		} else
+			avlh_root = elm;
+		entry(entry(old)->avle_left)->set_parent(elm);
+		if (entry(old)->avle_right)
+			entry(entry(old)->avle_right)->set_parent(elm);
+		remove_balance(parent, shrank_left);
+		return old;
+	}
+
+	/* Single rotation, returns new subtree root */
+	ObjectType *rotate_left_balance(ObjectType *elm) {
+		ObjectType *tmp = entry(elm)->avle_right;
+
+		rotate_left(elm);
+		if (balance(tmp) == 0) {
+			set_balance(tmp, -1);
+			set_balance(elm, 1);
+		} else {
+			set_balance(tmp, 0);
+			set_balance(elm, 0);
+		}
+		return tmp;
+	}
+
+	ObjectType *rotate_right_balance(ObjectType *elm) {
+		ObjectType *tmp = entry(elm)->avle_left;
+
+		rotate_right(elm);
+		if (balance(tmp) == 0) {
+			set_balance(tmp, 1);
+			set_balance(elm, -1);
+		} else {
+			set_balance(tmp, 0);
+			set_balance(elm, 0);
+		}
+		return tmp;
+	}
+
+	/* Double rotations, returns new subtree root */
+	ObjectType *rotate_right_left(ObjectType *elm) {
+		ObjectType *right = entry(elm)->avle_right;
+		ObjectType *top = entry(right)->avle_left;
+
+		rotate_right(right);
+		rotate_left(elm);
+		set_balance(elm, balance(top) > 0 ? -1 : 0);
+		set_balance(right, balance(top) < 0 ? 1 : 0);
+		set_balance(top, 0);
+		return top;
+	}
+
+	ObjectType *rotate_left_right(ObjectType *elm) {
+		ObjectType *left = entry(elm)->avle_left;
+		ObjectType *top = entry(left)->avle_right;
+
+		rotate_left(left);
+		rotate_right(elm);
+		set_balance(elm, balance(top) < 0 ? 1 : 0);
+		set_balance(left, balance(top) > 0 ? -1 : 0);
+		set_balance(top, 0);
+		return top;
+	}
+
+	void rotate_left(ObjectType *elm) {
+		ObjectType *tmp, *parent;
+
+		tmp = entry(elm)->avle_right;
+		if ((entry(elm)->avle_right = entry(tmp)->avle_left) != NULL)
+			entry(entry(tmp)->avle_left)->set_parent(elm);
+		parent = entry(elm)->parent();
+		entry(tmp)->set_parent(parent);
+		if (parent != NULL) {
+			if (elm == entry(parent)->avle_left)
+				entry(parent)->avle_left = tmp;
+			else
+				entry(parent)->avle_right = tmp;
+		} else
+			avlh_root = tmp;
+		entry(tmp)->avle_left = elm;
+		entry(elm)->set_parent(tmp);
+	}
+
+	void rotate_right(ObjectType *elm) {
+		ObjectType *tmp, *parent;
+
+		tmp = entry(elm)->avle_left;
+		if ((entry(elm)->avle_left = entry(tmp)->avle_right) != NULL)
+			entry(entry(tmp)->avle_right)->set_parent(elm);
+		parent = entry(elm)->parent();
+		entry(tmp)->set_parent(parent);
+		if (parent != NULL) {
+			if (elm == entry(parent)->avle_left)
+				entry(parent)->avle_left = tmp;
+			else
+				entry(parent)->avle_right = tmp;
+		} else
+			avlh_root = tmp;
+		entry(tmp)->avle_right = elm;
+		entry(elm)->set_parent(tmp);
+	}
+
+private:
+	ObjectType *avlh_root;
+};
+
+template <typename EntryT, typename ObjectT>
+class AVLTreeEntry : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef ObjectT ObjectType;
+	typedef AVLTreePolicy<EntryType> Policy;
+
+	friend class AVLTreeHead<EntryType>;
+	friend class impl::Iterator<EntryType>;
+	friend class impl::ConstIterator<EntryType>;
+	friend class impl::ReverseIterator<EntryType>;
+	friend class impl::ConstReverseIterator<EntryType>;
+	friend struct policy::AVLTree;
+
+	struct Iterator : impl::Iterator<EntryType> {
+		typedef impl::Iterator<EntryType> Base;
+		ObjectType *init(AVLTreeHead<EntryType> *head) {
+			return Base::start_at(head->first());
+		}
+	};
+
+	struct ConstIterator : impl::ConstIterator<EntryType> {
+		typedef impl::ConstIterator<EntryType> Base;
+		const ObjectType *init(const AVLTreeHead<EntryType> *head) {
+			return Base::start_at(head->first());
+		}
+	};
+
+	struct ReverseIterator : impl::ReverseIterator<EntryType> {
+		typedef impl::ReverseIterator<EntryType> Base;
+		ObjectType *init(AVLTreeHead<EntryType> *head) {
+			return Base::start_at(head->last());
+		}
+	};
+
+	struct ConstReverseIterator : impl::ConstReverseIterator<EntryType> {
+		typedef impl::ConstReverseIterator<EntryType> Base;
+		const ObjectType *init(const AVLTreeHead<EntryType> *head) {
+			return Base::start_at(head->last());
+		}
+	};
+
+	static int compare(const ObjectType *a, const ObjectType *b) {
+		return EntryType::compare_fn(a, b);
+	}
+
+	template<typename KeyType>
+	static int compare_key(const KeyType &key, const ObjectType *obj) {
+		return EntryType::compare_key_fn(key, obj);
+	}
+
+	AVLTreeEntry() {
+		Policy::create_entry(this);
+	}
+
+	~AVLTreeEntry() {
+		Policy::destroy_entry(this);
+	}
+
+	ObjectType *left() {
+		return this->avle_left;
+	}
+
+	const ObjectType *left() const {
+		return this->avle_left;
+	}
+
+	ObjectType *right() {
+		return this->avle_right;
+	}
+
+	const ObjectType *right() const {
+		return this->avle_right;
+	}
+
+	ObjectType *parent() {
+		return reinterpret_cast<ObjectType *>(avle_parent & ~BALANCE_MASK);
+	}
+
+	const ObjectType *parent() const {
+		return reinterpret_cast<ObjectType *>(avle_parent & ~BALANCE_MASK);
+	}
+
+	/* Height of the right subtree minus height of the left one */
+	int balance() const {
+		return balance_decode[avle_parent & BALANCE_MASK];
+	}
+
+	ObjectType *next() {
+		return next_impl();
+	}
+
+	const ObjectType *next() const {
+		return next_impl();
+	}
+
+	ObjectType *prev() {
+		return prev_impl();
+	}
+
+	const ObjectType *prev() const {
+		return prev_impl();
+	}
+
+protected:
+	static EntryType *entry(ObjectType *obj) {
+		return obj;
+	}
+
+	static const EntryType *entry(const ObjectType *obj) {
+		return obj;
+	}
+
+	/* Balance factor lives in the low bits of the parent pointer */
+	enum {
+		BALANCE_MASK = 3,
+		BALANCE_RIGHT = 1,
+		BALANCE_LEFT = 2,
+	};
+
+	static const int balance_decode[4];
+
+	void init(ObjectType *parent) {
+		avle_parent = reinterpret_cast<uintptr_t>(parent);
+		avle_left = avle_right = NULL;
+	}
+
+	void init_copy(EntryType *a) {
+		avle_parent = a->avle_parent;
+		avle_left = a->avle_left;
+		avle_right = a->avle_right;
+	}
+
+	void set_parent(ObjectType *parent) {
+		assert((reinterpret_cast<uintptr_t>(parent) & BALANCE_MASK) == 0);
+		avle_parent = reinterpret_cast<uintptr_t>(parent) |
+		    (avle_parent & BALANCE_MASK);
+	}
+
+	void set_balance(int bal) {
+		avle_parent = (avle_parent & ~(uintptr_t)BALANCE_MASK) |
+		    (bal > 0 ? BALANCE_RIGHT : bal < 0 ? BALANCE_LEFT : 0);
+	}
+
+	ObjectType *object() const {
+		return impl::entry_to_object<ObjectType, AVLTreeEntry>(this);
+	}
+
+	ObjectType *next_impl() const {
+		ObjectType *elm = object();
+
+		if (entry(elm)->avle_right) {
+			elm = entry(elm)->avle_right;
+			while (entry(elm)->avle_left)
+				elm = entry(elm)->avle_left;
+		} else {
+			if (entry(elm)->parent() &&
+			    (elm == entry(entry(elm)->parent())->avle_left))
+				elm = entry(elm)->parent();
+			else {
+				while (entry(elm)->parent() &&
+				    (elm == entry(entry(elm)->parent())->avle_right))
+					elm = entry(elm)->parent();
+				elm = entry(elm)->parent();
+			}
+		}
+		return elm;
+	}
+
+	ObjectType *prev_impl() const {
+		ObjectType *elm = object();
+
+		if (entry(elm)->avle_left) {
+			elm = entry(elm)->avle_left;
+			while (entry(elm)->avle_right)
+				elm = entry(elm)->avle_right;
+		} else {
+			if (entry(elm)->parent() &&
+			    (elm == entry(entry(elm)->parent())->avle_right))
+				elm = entry(elm)->parent();
+			else {
+				while (entry(elm)->parent() &&
+				    (elm == entry(entry(elm)->parent())->avle_left))
+					elm = entry(elm)->parent();
+				elm = entry(elm)->parent();
+			}
+		}
+		return elm;
+	}
+
+	ObjectType *avle_left;
+	ObjectType *avle_right;
+	uintptr_t avle_parent;
+};
+
+template <typename EntryT, typename ObjectT>
+const int AVLTreeEntry<EntryT, ObjectT>::balance_decode[4] = { 0, 1, -1, 0 };
+
+} // namespace ecl
+
+#endif
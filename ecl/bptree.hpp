@@ -0,0 +1,691 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * B+-tree index of object pointers.
+ *
+ * Objects don't embed any linkage, keys are copied into the nodes with
+ * EntryType::key_fn().  KeyT must be trivially copyable and its operator<
+ * must agree with EntryType::compare_fn().  Nodes are NODE_SIZE bytes and
+ * are carved out of cache line aligned chunks owned by the head.
+ *
+ * Insertion splits full nodes and removal refills minimal nodes on the way
+ * down, so both are a single root-to-leaf pass.
+ */
+
+#ifndef ECL_BPTREE_HPP
+#define ECL_BPTREE_HPP
+
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "impl.hpp"
+
+namespace ecl {
+
+namespace impl {
+
+/* Number of keys less than (less or equal to) key in keys[0 .. n - 1] */
+template<typename KeyT>
+struct BPSearch {
+	static int count_less(const KeyT *keys, int n, const KeyT &key) {
+		int i, c = 0;
+
+		for (i = 0; i < n; i++)
+			c += keys[i] < key;
+		return c;
+	}
+
+	static int count_less_equal(const KeyT *keys, int n, const KeyT &key) {
+		int i, c = 0;
+
+		for (i = 0; i < n; i++)
+			c += !(key < keys[i]);
+		return c;
+	}
+};
+
+#ifdef __SSE2__
+/* Reads up to 3 keys past n, callers keep keys[] inside the node */
+template<>
+struct BPSearch<int> {
+	static int count_less(const int *keys, int n, const int &key) {
+		__m128i k = _mm_set1_epi32(key);
+		int i, m, c = 0;
+
+		for (i = 0; i < n; i += 4) {
+			m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(
+			    _mm_loadu_si128((const __m128i *)(keys + i)), k)));
+			if (n - i < 4)
+				m &= (1 << (n - i)) - 1;
+			c += __builtin_popcount(m);
+		}
+		return c;
+	}
+
+	static int count_less_equal(const int *keys, int n, const int &key) {
+		__m128i k = _mm_set1_epi32(key);
+		int i, m, c = n;
+
+		for (i = 0; i < n; i += 4) {
+			m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(
+			    _mm_loadu_si128((const __m128i *)(keys + i)), k)));
+			if (n - i < 4)
+				m &= (1 << (n - i)) - 1;
+			c -= __builtin_popcount(m);
+		}
+		return c;
+	}
+};
+#endif
+
+} // namespace impl
+
+template <typename EntryT, typename KeyT>
+class BPTreeHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef KeyT KeyType;
+	typedef typename EntryType::ObjectType ObjectType;
+
+	struct Iterator;
+	struct ReverseIterator;
+
+protected:
+	struct Leaf;
+
+public:
+	BPTreeHead() : bph_root(NULL), bph_count(0), bph_free(NULL),
+	    bph_chunks(NULL) { }
+
+	~BPTreeHead() {
+		clear();
+	}
+
+	bool empty() const {
+		return (bph_count == 0);
+	}
+
+	size_t size() const {
+		return bph_count;
+	}
+
+	/* Drops all elements and returns node memory */
+	void clear() {
+		void *chunk;
+
+		while (bph_chunks != NULL) {
+			chunk = bph_chunks;
+			bph_chunks = *(void **)chunk;
+			free(chunk);
+		}
+		bph_free = NULL;
+		bph_root = NULL;
+		bph_count = 0;
+	}
+
+	ObjectType *first() const {
+		return min();
+	}
+
+	ObjectType *last() const {
+		return max();
+	}
+
+	ObjectType *min() const {
+		Leaf *leaf = min_leaf();
+
+		return leaf == NULL ? NULL : leaf->objs[0];
+	}
+
+	ObjectType *max() const {
+		Leaf *leaf = max_leaf();
+
+		return leaf == NULL ? NULL : leaf->objs[leaf->n - 1];
+	}
+
+	ObjectType *find(const KeyType &key) const {
+		Leaf *leaf;
+		int i;
+
+		if (bph_root == NULL)
+			return NULL;
+		leaf = find_leaf(key);
+		i = Search::count_less(leaf->keys, leaf->n, key);
+		if (i == leaf->n || key < leaf->keys[i])
+			return NULL;
+		return leaf->objs[i];
+	}
+
+	ObjectType *find_element(const ObjectType *elm) const {
+		return find(EntryType::key_fn(elm));
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	ObjectType *nfind(const KeyType &key) const {
+		Leaf *leaf;
+		int i;
+
+		if (bph_root == NULL)
+			return NULL;
+		leaf = find_leaf(key);
+		i = Search::count_less(leaf->keys, leaf->n, key);
+		if (i < leaf->n)
+			return leaf->objs[i];
+		return leaf->next == NULL ? NULL : leaf->next->objs[0];
+	}
+
+	ObjectType *nfind_element(const ObjectType *elm) const {
+		return nfind(EntryType::key_fn(elm));
+	}
+
+	/* Finds the last node less than or equal to the search key */
+	ObjectType *pfind(const KeyType &key) const {
+		Leaf *leaf;
+		int i;
+
+		if (bph_root == NULL)
+			return NULL;
+		leaf = find_leaf(key);
+		i = Search::count_less_equal(leaf->keys, leaf->n, key);
+		if (i > 0)
+			return leaf->objs[i - 1];
+		leaf = leaf->prev;
+		return leaf == NULL ? NULL : leaf->objs[leaf->n - 1];
+	}
+
+	ObjectType *pfind_element(const ObjectType *elm) const {
+		return pfind(EntryType::key_fn(elm));
+	}
+
+	/* Returns an object with the same key if already present */
+	ObjectType *insert(ObjectType *obj) {
+		KeyType key = EntryType::key_fn(obj);
+		Inner *inner;
+		Node *node;
+		Leaf *leaf;
+		int i;
+
+		if (bph_root == NULL) {
+			leaf = alloc_leaf();
+			leaf->keys[0] = key;
+			leaf->objs[0] = obj;
+			leaf->n = 1;
+			bph_root = leaf;
+			bph_count++;
+			return NULL;
+		}
+		if (full(bph_root)) {
+			inner = alloc_inner(bph_root->level + 1);
+			inner->child[0] = bph_root;
+			bph_root = inner;
+			split_child(inner, 0);
+		}
+		node = bph_root;
+		while (node->level != 0) {
+			inner = static_cast<Inner *>(node);
+			i = Search::count_less_equal(inner->keys, inner->n, key);
+			if (full(inner->child[i])) {
+				split_child(inner, i);
+				if (!(key < inner->keys[i]))
+					i++;
+			}
+			node = inner->child[i];
+		}
+		leaf = static_cast<Leaf *>(node);
+		i = Search::count_less(leaf->keys, leaf->n, key);
+		if (i < leaf->n && !(key < leaf->keys[i]))
+			return leaf->objs[i];
+		leaf_insert(leaf, i, key, obj);
+		bph_count++;
+		return NULL;
+	}
+
+	/*
+	 * Removes elm and returns it.  Returns NULL if elm isn't in the tree,
+	 * also if another object with the same key is.
+	 */
+	ObjectType *remove(ObjectType *elm) {
+		KeyType key = EntryType::key_fn(elm);
+		ObjectType *obj;
+		Inner *inner;
+		Node *node;
+		Leaf *leaf;
+		int i;
+
+		if (bph_root == NULL)
+			return NULL;
+		node = bph_root;
+		while (node->level != 0) {
+			inner = static_cast<Inner *>(node);
+			i = Search::count_less_equal(inner->keys, inner->n, key);
+			if (minimal(inner->child[i]))
+				i = fill_child(inner, i);
+			node = inner->child[i];
+			if (inner == bph_root && inner->n == 0) {
+				bph_root = node;
+				free_node(inner);
+			}
+		}
+		leaf = static_cast<Leaf *>(node);
+		i = Search::count_less(leaf->keys, leaf->n, key);
+		if (i == leaf->n || key < leaf->keys[i] || leaf->objs[i] != elm)
+			return NULL;
+		obj = leaf->objs[i];
+		leaf_remove(leaf, i);
+		if (leaf->n == 0) {
+			assert(leaf == bph_root);
+			free_node(leaf);
+			bph_root = NULL;
+		}
+		bph_count--;
+		return obj;
+	}
+
+	/* Ordered iteration, the tree must not be modified meanwhile */
+	struct Iterator : impl::NonCopyable {
+		ObjectType *init(const BPTreeHead *head) {
+			it_leaf = head->min_leaf();
+			it_pos = 0;
+			return next();
+		}
+
+		/* Starts at the first node greater than or equal to key */
+		ObjectType *init(const BPTreeHead *head, const KeyType &key) {
+			if (head->bph_root == NULL) {
+				it_leaf = NULL;
+				return NULL;
+			}
+			it_leaf = head->find_leaf(key);
+			it_pos = Search::count_less(it_leaf->keys, it_leaf->n,
+			    key);
+			return next();
+		}
+
+		ObjectType *next() {
+			if (it_leaf == NULL)
+				return NULL;
+			if (it_pos == it_leaf->n) {
+				it_leaf = it_leaf->next;
+				it_pos = 0;
+				if (it_leaf == NULL)
+					return NULL;
+			}
+			return it_leaf->objs[it_pos++];
+		}
+
+	private:
+		Leaf *it_leaf;
+		int it_pos;
+	};
+
+	struct ReverseIterator : impl::NonCopyable {
+		ObjectType *init(const BPTreeHead *head) {
+			it_leaf = head->max_leaf();
+			it_pos = it_leaf == NULL ? 0 : it_leaf->n;
+			return prev();
+		}
+
+		ObjectType *prev() {
+			if (it_leaf == NULL)
+				return NULL;
+			if (it_pos == 0) {
+				it_leaf = it_leaf->prev;
+				if (it_leaf == NULL)
+					return NULL;
+				it_pos = it_leaf->n;
+			}
+			return it_leaf->objs[--it_pos];
+		}
+
+	private:
+		Leaf *it_leaf;
+		int it_pos;
+	};
+
+protected:
+	enum { CACHE_LINE = 64 };
+	enum { NODE_SIZE = 4 * CACHE_LINE };
+	enum { CHUNK_SIZE = 64 * NODE_SIZE };
+
+	typedef impl::BPSearch<KeyType> Search;
+
+	/* Level 0 are leaves */
+	struct Node {
+		int n;
+		int level;
+	};
+
+	struct Inner;
+
+	enum {
+		INNER_MAX = (NODE_SIZE - sizeof(Node) - sizeof(Node *)) /
+		    (sizeof(KeyType) + sizeof(Node *)),
+		LEAF_MAX = (NODE_SIZE - sizeof(Node) - 2 * sizeof(Leaf *)) /
+		    (sizeof(KeyType) + sizeof(ObjectType *)),
+		INNER_MIN = (INNER_MAX - 1) / 2,
+		LEAF_MIN = LEAF_MAX / 2
+	};
+
+	struct Inner : Node {
+		KeyType keys[INNER_MAX];
+		Node *child[INNER_MAX + 1];
+	};
+
+	struct Leaf : Node {
+		Leaf *prev;
+		Leaf *next;
+		KeyType keys[LEAF_MAX];
+		ObjectType *objs[LEAF_MAX];
+	};
+
+	/* Keys wider than 32 bytes need a larger NODE_SIZE */
+	typedef char assert_inner_fanout[INNER_MAX >= 4 ? 1 : -1];
+	typedef char assert_leaf_fanout[LEAF_MAX >= 4 ? 1 : -1];
+	typedef char assert_inner_size[sizeof(Inner) <= NODE_SIZE ? 1 : -1];
+	typedef char assert_leaf_size[sizeof(Leaf) <= NODE_SIZE ? 1 : -1];
+
+	static bool full(const Node *node) {
+		return node->n == (node->level == 0 ? LEAF_MAX : INNER_MAX);
+	}
+
+	static bool minimal(const Node *node) {
+		return node->n <= (node->level == 0 ? LEAF_MIN : INNER_MIN);
+	}
+
+	Leaf *find_leaf(const KeyType &key) const {
+		const Inner *inner;
+		Node *node;
+		int i, off;
+
+		node = bph_root;
+		while (node->level != 0) {
+			inner = static_cast<const Inner *>(node);
+			i = Search::count_less_equal(inner->keys, inner->n, key);
+			node = inner->child[i];
+			for (off = 0; off < NODE_SIZE; off += CACHE_LINE)
+				__builtin_prefetch((char *)node + off);
+		}
+		return static_cast<Leaf *>(node);
+	}
+
+	Leaf *min_leaf() const {
+		Node *node = bph_root;
+
+		if (node == NULL)
+			return NULL;
+		while (node->level != 0)
+			node = static_cast<Inner *>(node)->child[0];
+		return static_cast<Leaf *>(node);
+	}
+
+	Leaf *max_leaf() const {
+		Node *node = bph_root;
+
+		if (node == NULL)
+			return NULL;
+		while (node->level != 0)
+			node = static_cast<Inner *>(node)->child[node->n];
+		return static_cast<Leaf *>(node);
+	}
+
+	static void leaf_insert(Leaf *leaf, int i, const KeyType &key,
+	    ObjectType *obj) {
+		int j;
+
+		for (j = leaf->n; j > i; j--) {
+			leaf->keys[j] = leaf->keys[j - 1];
+			leaf->objs[j] = leaf->objs[j - 1];
+		}
+		leaf->keys[i] = key;
+		leaf->objs[i] = obj;
+		leaf->n++;
+	}
+
+	static void leaf_remove(Leaf *leaf, int i) {
+		for (leaf->n--; i < leaf->n; i++) {
+			leaf->keys[i] = leaf->keys[i + 1];
+			leaf->objs[i] = leaf->objs[i + 1];
+		}
+	}
+
+	/* Inserts key and right child after position i */
+	static void inner_insert(Inner *inner, int i, const KeyType &key,
+	    Node *right) {
+		int j;
+
+		for (j = inner->n; j > i; j--) {
+			inner->keys[j] = inner->keys[j - 1];
+			inner->child[j + 1] = inner->child[j];
+		}
+		inner->keys[i] = key;
+		inner->child[i + 1] = right;
+		inner->n++;
+	}
+
+	/* Removes key i and its right child */
+	static void inner_remove(Inner *inner, int i) {
+		for (inner->n--; i < inner->n; i++) {
+			inner->keys[i] = inner->keys[i + 1];
+			inner->child[i + 1] = inner->child[i + 2];
+		}
+	}
+
+	/* Splits the full child i of a non-full parent */
+	void split_child(Inner *parent, int i) {
+		Inner *inner, *rinner;
+		Leaf *leaf, *rleaf;
+		int j, mid;
+
+		if (parent->child[i]->level == 0) {
+			leaf = static_cast<Leaf *>(parent->child[i]);
+			rleaf = alloc_leaf();
+			mid = leaf->n / 2;
+			for (j = mid; j < leaf->n; j++) {
+				rleaf->keys[j - mid] = leaf->keys[j];
+				rleaf->objs[j - mid] = leaf->objs[j];
+			}
+			rleaf->n = leaf->n - mid;
+			leaf->n = mid;
+			rleaf->next = leaf->next;
+			rleaf->prev = leaf;
+			if (leaf->next != NULL)
+				leaf->next->prev = rleaf;
+			leaf->next = rleaf;
+			inner_insert(parent, i, rleaf->keys[0], rleaf);
+		} else {
+			inner = static_cast<Inner *>(parent->child[i]);
+			rinner = alloc_inner(inner->level);
+			mid = inner->n / 2;
+			for (j = mid + 1; j < inner->n; j++) {
+				rinner->keys[j - mid - 1] = inner->keys[j];
+				rinner->child[j - mid - 1] = inner->child[j];
+			}
+			rinner->child[j - mid - 1] = inner->child[j];
+			rinner->n = inner->n - mid - 1;
+			inner->n = mid;
+			inner_insert(parent, i, inner->keys[mid], rinner);
+		}
+	}
+
+	/*
+	 * Grows the minimal child i of parent by borrowing from or merging
+	 * with a sibling.  Returns the new index of the child.
+	 */
+	int fill_child(Inner *parent, int i) {
+		Node *left, *right;
+
+		if (i > 0 && !minimal(parent->child[i - 1])) {
+			borrow_left(parent, i);
+			return i;
+		}
+		if (i < parent->n && !minimal(parent->child[i + 1])) {
+			borrow_right(parent, i);
+			return i;
+		}
+		if (i == parent->n)
+			i--;
+		left = parent->child[i];
+		right = parent->child[i + 1];
+		if (left->level == 0)
+			merge_leaves(static_cast<Leaf *>(left),
+			    static_cast<Leaf *>(right));
+		else
+			merge_inner(static_cast<Inner *>(left), parent->keys[i],
+			    static_cast<Inner *>(right));
+		inner_remove(parent, i);
+		free_node(right);
+		return i;
+	}
+
+	void borrow_left(Inner *parent, int i) {
+		Inner *inner, *linner;
+		Leaf *leaf, *lleaf;
+
+		if (parent->child[i]->level == 0) {
+			leaf = static_cast<Leaf *>(parent->child[i]);
+			lleaf = static_cast<Leaf *>(parent->child[i - 1]);
+			leaf_insert(leaf, 0, lleaf->keys[lleaf->n - 1],
+			    lleaf->objs[lleaf->n - 1]);
+			lleaf->n--;
+			parent->keys[i - 1] = leaf->keys[0];
+		} else {
+			inner = static_cast<Inner *>(parent->child[i]);
+			linner = static_cast<Inner *>(parent->child[i - 1]);
+			inner->child[inner->n + 1] = inner->child[inner->n];
+			inner_insert(inner, 0, parent->keys[i - 1],
+			    inner->child[0]);
+			inner->child[0] = linner->child[linner->n];
+			parent->keys[i - 1] = linner->keys[linner->n - 1];
+			linner->n--;
+		}
+	}
+
+	void borrow_right(Inner *parent, int i) {
+		Inner *inner, *rinner;
+		Leaf *leaf, *rleaf;
+
+		if (parent->child[i]->level == 0) {
+			leaf = static_cast<Leaf *>(parent->child[i]);
+			rleaf = static_cast<Leaf *>(parent->child[i + 1]);
+			leaf_insert(leaf, leaf->n, rleaf->keys[0],
+			    rleaf->objs[0]);
+			leaf_remove(rleaf, 0);
+			parent->keys[i] = rleaf->keys[0];
+		} else {
+			inner = static_cast<Inner *>(parent->child[i]);
+			rinner = static_cast<Inner *>(parent->child[i + 1]);
+			inner_insert(inner, inner->n, parent->keys[i],
+			    rinner->child[0]);
+			parent->keys[i] = rinner->keys[0];
+			rinner->child[0] = rinner->child[1];
+			inner_remove(rinner, 0);
+		}
+	}
+
+	static void merge_leaves(Leaf *left, Leaf *right) {
+		int j;
+
+		for (j = 0; j < right->n; j++) {
+			left->keys[left->n + j] = right->keys[j];
+			left->objs[left->n + j] = right->objs[j];
+		}
+		left->n += right->n;
+		left->next = right->next;
+		if (right->next != NULL)
+			right->next->prev = left;
+	}
+
+	static void merge_inner(Inner *left, const KeyType &key, Inner *right) {
+		int j;
+
+		left->keys[left->n] = key;
+		for (j = 0; j < right->n; j++) {
+			left->keys[left->n + 1 + j] = right->keys[j];
+			left->child[left->n + 1 + j] = right->child[j];
+		}
+		left->child[left->n + 1 + j] = right->child[j];
+		left->n += right->n + 1;
+	}
+
+	void *alloc_node() {
+		char *chunk;
+		void *node;
+		size_t off;
+
+		if (bph_free == NULL) {
+			if (posix_memalign((void **)&chunk, CACHE_LINE,
+			    CHUNK_SIZE) != 0)
+				abort();
+			/* The first node of a chunk links the chunk list */
+			*(void **)chunk = bph_chunks;
+			bph_chunks = chunk;
+			for (off = NODE_SIZE; off < CHUNK_SIZE; off += NODE_SIZE) {
+				*(void **)(chunk + off) = bph_free;
+				bph_free = chunk + off;
+			}
+		}
+		node = bph_free;
+		bph_free = *(void **)node;
+		return node;
+	}
+
+	void free_node(Node *node) {
+		*(void **)node = bph_free;
+		bph_free = node;
+	}
+
+	Leaf *alloc_leaf() {
+		Leaf *leaf = static_cast<Leaf *>(alloc_node());
+
+		leaf->n = 0;
+		leaf->level = 0;
+		leaf->prev = NULL;
+		leaf->next = NULL;
+		return leaf;
+	}
+
+	Inner *alloc_inner(int level) {
+		Inner *inner = static_cast<Inner *>(alloc_node());
+
+		inner->n = 0;
+		inner->level = level;
+		return inner;
+	}
+
+private:
+	Node *bph_root;
+	size_t bph_count;
+	void *bph_free;
+	void *bph_chunks;
+};
+
+} // namespace ecl
+
+#endif
@@ -0,0 +1,420 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Chained hash set with lock striping and lock-free lookups.
+ *
+ * Uses HashTableEntry and the same EntryType functions as HashTableHead.
+ * Bucket i is guarded by stripe i % nstripes, a mutex and a sequence
+ * counter; writers lock the stripe and bump the counter around every change
+ * of its buckets.  Readers walk a bucket without locking and retry if the
+ * counter was odd or has changed, as in RBTreeSeqHead.  Objects must not be
+ * freed or have their keys changed until concurrent readers are done with
+ * them.
+ *
+ * Tables double in size and bucket counts are multiples of the stripe
+ * count, so an old bucket and the two new buckets it splits into share a
+ * stripe.  Once a resize starts, every insert and remove migrates its own
+ * old bucket and claims a chunk of the others, so threads move disjoint
+ * bucket ranges in parallel.  A migrated old bucket is marked as such and
+ * lookups move on to the new table.  Old bucket arrays may still be read by
+ * lookups and are only freed by the destructor.
+ */
+
+#ifndef ECL_CHASHTABLE_HPP
+#define ECL_CHASHTABLE_HPP
+
+#include <pthread.h>
+
+#include "hashtable.hpp"
+
+namespace ecl {
+
+template <typename EntryT>
+class ConcurrentHashTableHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+
+	enum { DEFAULT_STRIPES = 64 };
+
+	/* nstripes must be a power of two */
+	explicit ConcurrentHashTableHead(int nstripes = DEFAULT_STRIPES) :
+	    cht_nstripes(nstripes), cht_old(NULL) {
+		assert(nstripes > 0 && (nstripes & (nstripes - 1)) == 0);
+		cht_stripes = new Stripe[nstripes];
+		cht_table = new Table(nstripes > MIN_SIZE ? nstripes : MIN_SIZE,
+		    NULL);
+		pthread_mutex_init(&cht_resize_lock, NULL);
+	}
+
+	~ConcurrentHashTableHead() {
+		Table *table;
+
+		while (cht_table != NULL) {
+			table = cht_table;
+			cht_table = table->retired;
+			delete table;
+		}
+		delete[] cht_stripes;
+		pthread_mutex_destroy(&cht_resize_lock);
+	}
+
+	bool empty() const {
+		return (size() == 0);
+	}
+
+	/* Exact only with writers excluded */
+	size_t size() const {
+		size_t n = 0;
+		int i;
+
+		for (i = 0; i < cht_nstripes; i++)
+			n += load(&cht_stripes[i].count);
+		return n;
+	}
+
+	size_t bucket_count() const {
+		return load(&cht_table)->size;
+	}
+
+	bool resizing() const {
+		return (load(&cht_old) != NULL);
+	}
+
+	template<typename KeyType>
+	ObjectType *find(const KeyType &key) const {
+		const Stripe *s;
+		Table *table, *old;
+		ObjectType *obj;
+		unsigned int seq;
+		size_t hash;
+		int res;
+
+		hash = EntryType::hash_key_fn(key);
+		s = stripe(hash);
+		for (;;) {
+			seq = read_begin(s);
+			/* See lock_bucket() */
+			table = load(&cht_table);
+			old = load(&cht_old);
+			if (old != NULL) {
+				res = walk(s, seq, old, hash, key, &obj);
+				if (res == MOVED)
+					res = walk(s, seq, old->next, hash,
+					    key, &obj);
+			} else
+				res = walk(s, seq, table, hash, key, &obj);
+			if (res == DONE && !read_retry(s, seq))
+				return obj;
+		}
+	}
+
+	/* Returns an object with the same key if already present */
+	ObjectType *insert(ObjectType *obj) {
+		BucketType *b;
+		ObjectType *tmp;
+		Table *table;
+		Stripe *s;
+		size_t hash;
+		bool grow;
+
+		hash = EntryType::hash_fn(obj);
+		s = stripe(hash);
+		pthread_mutex_lock(&s->lock);
+		b = lock_bucket(s, hash);
+		for (tmp = b->first(); tmp != NULL; tmp = entry(tmp)->next())
+			if (entry(tmp)->hte_hash == hash &&
+			    EntryType::compare_fn(obj, tmp) == 0)
+				break;
+		if (tmp == NULL) {
+			/* obj may be linked already if it's a duplicate */
+			write_begin(s);
+			entry(obj)->hte_hash = hash;
+			b->insert_head(obj);
+			store(&s->count, s->count + 1);
+			write_end(s);
+		}
+		table = load(&cht_table);
+		grow = s->count * cht_nstripes > table->size;
+		pthread_mutex_unlock(&s->lock);
+		if (grow)
+			resize_start(table);
+		help_resize();
+		return tmp;
+	}
+
+	ObjectType *remove(ObjectType *obj) {
+		BucketType *b;
+		Stripe *s;
+		size_t hash;
+
+		hash = entry(obj)->hte_hash;
+		s = stripe(hash);
+		pthread_mutex_lock(&s->lock);
+		b = lock_bucket(s, hash);
+		write_begin(s);
+		b->remove(obj);
+		store(&s->count, s->count - 1);
+		write_end(s);
+		pthread_mutex_unlock(&s->lock);
+		help_resize();
+		return obj;
+	}
+
+	/* Helps migrating buckets until the resize in progress is done */
+	void finish_resize() {
+		while (help_resize())
+			;
+		while (resizing())
+			impl::cpu_spinwait();
+	}
+
+protected:
+	enum { CACHE_LINE = 64 };
+	enum { MIN_SIZE = 16 };
+	/* Old buckets claimed at a time by a migrating thread */
+	enum { MIGRATE_CHUNK = 16 };
+	/* Lookups check the counter every so many objects in a chain */
+	enum { WALK_CHECK = 64 };
+	enum { DONE, MOVED, RETRY };
+
+	struct BucketType : SListHead<EntryType> {
+		using SListHead<EntryType>::first_link;
+	};
+
+	struct Stripe {
+		Stripe() : seq(0), count(0) {
+			pthread_mutex_init(&lock, NULL);
+		}
+
+		~Stripe() {
+			pthread_mutex_destroy(&lock);
+		}
+
+		pthread_mutex_t lock;
+		unsigned int seq;
+		size_t count;
+	} __attribute__((aligned(CACHE_LINE)));
+
+	struct Table {
+		Table(size_t n, Table *prev) : buckets(new BucketType[n]),
+		    size(n), migrate(0), migrated(0), next(NULL),
+		    retired(prev) { }
+
+		~Table() {
+			delete[] buckets;
+		}
+
+		BucketType *buckets;
+		size_t size;
+		/* Next old bucket to claim and number of buckets migrated */
+		size_t migrate;
+		size_t migrated;
+		/* Table the buckets are migrated to */
+		Table *next;
+		/* Previous table, kept for lookups still reading it */
+		Table *retired;
+	};
+
+	static EntryType *entry(ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	static ObjectType *moved() {
+		return (ObjectType *)1;
+	}
+
+	template<typename T>
+	static T load(T const *p) {
+		return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+	}
+
+	template<typename T>
+	static void store(T *p, T val) {
+		__atomic_store_n(p, val, __ATOMIC_RELEASE);
+	}
+
+	static ObjectType *load_relaxed(ObjectType * const *p) {
+		return __atomic_load_n(p, __ATOMIC_RELAXED);
+	}
+
+	Stripe *stripe(size_t hash) const {
+		return &cht_stripes[hash & (cht_nstripes - 1)];
+	}
+
+	static BucketType *bucket(Table *table, size_t hash) {
+		return &table->buckets[hash & (table->size - 1)];
+	}
+
+	static unsigned int read_begin(const Stripe *s) {
+		unsigned int seq;
+
+		while ((seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE)) & 1)
+			impl::cpu_spinwait();
+		return seq;
+	}
+
+	static bool read_retry(const Stripe *s, unsigned int seq) {
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		return (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) != seq);
+	}
+
+	static void write_begin(Stripe *s) {
+		__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+
+	static void write_end(Stripe *s) {
+		__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+	}
+
+	/*
+	 * A chain changing under the walk may point anywhere, including
+	 * the removed entry marker or another chain, so stop once the
+	 * counter has moved.
+	 */
+	template<typename KeyType>
+	static int walk(const Stripe *s, unsigned int seq, Table *table,
+	    size_t hash, const KeyType &key, ObjectType **objp) {
+		ObjectType *obj;
+		int n;
+
+		obj = load_relaxed(bucket(table, hash)->first_link());
+		if (obj == moved())
+			return MOVED;
+		for (n = 1; obj != NULL; n++) {
+			if (obj == (ObjectType *)-1)
+				return RETRY;
+			if (__atomic_load_n(&entry(obj)->hte_hash,
+			    __ATOMIC_RELAXED) == hash &&
+			    EntryType::compare_key_fn(key, obj) == 0)
+				break;
+			if (n % WALK_CHECK == 0 && read_retry(s, seq))
+				return RETRY;
+			obj = load_relaxed(&entry(obj)->sle_next);
+		}
+		*objp = obj;
+		return DONE;
+	}
+
+	/*
+	 * Returns the bucket to modify for hash in the current table, its
+	 * stripe must be locked.  Migrates the old bucket first if needed.
+	 */
+	BucketType *lock_bucket(Stripe *s, size_t hash) {
+		Table *table, *old;
+		BucketType *b;
+
+		for (;;) {
+			/*
+			 * resize_start() publishes cht_old before the new
+			 * cht_table, so loading them in the opposite order
+			 * never pairs a new empty table with no old one.
+			 */
+			table = load(&cht_table);
+			old = load(&cht_old);
+			if (old != NULL) {
+				table = old->next;
+				migrate_bucket(s, old, table,
+				    hash & (old->size - 1));
+			}
+			b = bucket(table, hash);
+			/* Table went stale before the stripe was locked */
+			if (*b->first_link() != moved())
+				return b;
+		}
+	}
+
+	/* The stripe of old bucket i must be locked */
+	static void migrate_bucket(Stripe *s, Table *old, Table *table,
+	    size_t i) {
+		BucketType *b = &old->buckets[i];
+		ObjectType *obj;
+
+		if (*b->first_link() == moved())
+			return;
+		write_begin(s);
+		while (!b->empty()) {
+			obj = b->first();
+			b->remove_head();
+			bucket(table, entry(obj)->hte_hash)->insert_head(obj);
+		}
+		__atomic_store_n(b->first_link(), moved(), __ATOMIC_RELAXED);
+		write_end(s);
+	}
+
+	/* Doubles table unless another thread got to it first */
+	void resize_start(Table *table) {
+		if (pthread_mutex_trylock(&cht_resize_lock) != 0)
+			return;
+		if (load(&cht_old) == NULL && load(&cht_table) == table) {
+			table->next = new Table(table->size * 2, table);
+			store(&cht_old, table);
+			store(&cht_table, table->next);
+		}
+		pthread_mutex_unlock(&cht_resize_lock);
+	}
+
+	/* Migrates a chunk of old buckets, false if none was left */
+	bool help_resize() {
+		Table *old;
+		size_t i, from, to;
+
+		old = load(&cht_old);
+		if (old == NULL)
+			return false;
+		from = __atomic_fetch_add(&old->migrate, MIGRATE_CHUNK,
+		    __ATOMIC_RELAXED);
+		if (from >= old->size)
+			return false;
+		to = from + MIGRATE_CHUNK < old->size ?
+		    from + MIGRATE_CHUNK : old->size;
+		for (i = from; i < to; i++) {
+			Stripe *s = stripe(i);
+
+			pthread_mutex_lock(&s->lock);
+			migrate_bucket(s, old, old->next, i);
+			pthread_mutex_unlock(&s->lock);
+		}
+		if (__atomic_add_fetch(&old->migrated, to - from,
+		    __ATOMIC_ACQ_REL) == old->size)
+			store(&cht_old, (Table *)NULL);
+		return true;
+	}
+
+private:
+	Stripe *cht_stripes;
+	int cht_nstripes;
+	Table *cht_table;
+	/* Table being migrated from */
+	Table *cht_old;
+	pthread_mutex_t cht_resize_lock;
+};
+
+} // namespace ecl
+
+#endif
@@ -0,0 +1,279 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Epoch based reclamation for lock-free containers.
+ *
+ * Every thread accessing a container registers an EpochDomain::Thread and
+ * does lookups and updates between enter() and exit().  Objects unlinked
+ * from a container are passed to retire() and released once every thread
+ * has left the critical sections it may have found them in: an object
+ * retired in epoch e is released after the global epoch reaches e + 2, and
+ * the epoch only advances when all threads inside a critical section have
+ * observed the current one.
+ */
+
+#ifndef ECL_EPOCH_HPP
+#define ECL_EPOCH_HPP
+
+#include <stdlib.h>
+
+#include "impl.hpp"
+
+namespace ecl {
+
+class EpochDomain : impl::NonCopyable {
+protected:
+	enum { CACHE_LINE = 64 };
+
+	struct Record {
+		Record() : epoch(0), active(0), in_use(1), next(NULL) { }
+
+		unsigned long epoch;
+		int active;
+		int in_use;
+		Record *next;
+	} __attribute__((aligned(CACHE_LINE)));
+
+public:
+	typedef void (*ReleaseFn)(void *);
+
+	class Thread;
+
+	EpochDomain() : ed_epoch(0), ed_records(NULL) { }
+
+	/* All threads must have been unregistered */
+	~EpochDomain() {
+		Record *rec;
+
+		while (ed_records != NULL) {
+			rec = ed_records;
+			ed_records = rec->next;
+			assert(rec->in_use == 0);
+			delete rec;
+		}
+	}
+
+	unsigned long epoch() const {
+		return __atomic_load_n(&ed_epoch, __ATOMIC_SEQ_CST);
+	}
+
+	class Thread : impl::NonCopyable {
+	public:
+		explicit Thread(EpochDomain *domain) : t_domain(domain),
+		    t_nest(0), t_nretired(0) {
+			int i;
+
+			for (i = 0; i < NBAGS; i++) {
+				t_bags[i].epoch = 0;
+				t_bags[i].n = 0;
+				t_bags[i].size = 0;
+				t_bags[i].items = NULL;
+			}
+			t_rec = domain->register_record();
+		}
+
+		/* Waits for everything retired by this thread */
+		~Thread() {
+			int i;
+
+			barrier();
+			for (i = 0; i < NBAGS; i++)
+				free(t_bags[i].items);
+			__atomic_store_n(&t_rec->in_use, 0, __ATOMIC_RELEASE);
+		}
+
+		/* Critical sections nest */
+		void enter() {
+			if (t_nest++ != 0)
+				return;
+			__atomic_store_n(&t_rec->active, 1, __ATOMIC_RELAXED);
+			__atomic_store_n(&t_rec->epoch, t_domain->epoch(),
+			    __ATOMIC_SEQ_CST);
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		}
+
+		void exit() {
+			assert(t_nest > 0);
+			if (--t_nest != 0)
+				return;
+			__atomic_store_n(&t_rec->active, 0, __ATOMIC_RELEASE);
+		}
+
+		bool active() const {
+			return (t_nest != 0);
+		}
+
+		/*
+		 * Calls fn(ptr) once no thread can still reach ptr.  The
+		 * object must already be unlinked.
+		 */
+		void retire(void *ptr, ReleaseFn fn) {
+			unsigned long e = t_domain->epoch();
+			Bag *bag = &t_bags[e % NBAGS];
+
+			if (bag->epoch != e) {
+				/* Same slot, at least NBAGS epochs old */
+				release(bag);
+				bag->epoch = e;
+			}
+			if (bag->n == bag->size) {
+				bag->size = bag->size == 0 ? 64 : bag->size * 2;
+				bag->items = (Item *)realloc(bag->items,
+				    bag->size * sizeof(Item));
+				if (bag->items == NULL)
+					abort();
+			}
+			bag->items[bag->n].ptr = ptr;
+			bag->items[bag->n].fn = fn;
+			bag->n++;
+			if (++t_nretired % COLLECT_PERIOD == 0)
+				collect();
+		}
+
+		/* Tries to advance the epoch and releases what is safe */
+		void collect() {
+			unsigned long e;
+			int i;
+
+			t_domain->try_advance();
+			e = t_domain->epoch();
+			for (i = 0; i < NBAGS; i++)
+				if (t_bags[i].n != 0 && t_bags[i].epoch + 2 <= e)
+					release(&t_bags[i]);
+		}
+
+		/*
+		 * Waits until everything retired so far is released, must
+		 * be called outside of a critical section.
+		 */
+		void barrier() {
+			int i, n;
+
+			assert(t_nest == 0);
+			for (;;) {
+				collect();
+				for (i = 0, n = 0; i < NBAGS; i++)
+					n += t_bags[i].n;
+				if (n == 0)
+					break;
+				impl::cpu_spinwait();
+			}
+		}
+
+	private:
+		enum { NBAGS = 3 };
+		/* Retired objects between collection attempts */
+		enum { COLLECT_PERIOD = 64 };
+
+		struct Item {
+			void *ptr;
+			ReleaseFn fn;
+		};
+
+		/* Objects retired in a single epoch */
+		struct Bag {
+			unsigned long epoch;
+			size_t n;
+			size_t size;
+			Item *items;
+		};
+
+		static void release(Bag *bag) {
+			size_t i;
+
+			for (i = 0; i < bag->n; i++)
+				bag->items[i].fn(bag->items[i].ptr);
+			bag->n = 0;
+		}
+
+		EpochDomain *t_domain;
+		Record *t_rec;
+		int t_nest;
+		unsigned long t_nretired;
+		Bag t_bags[NBAGS];
+	};
+
+	/* Scoped critical section */
+	class Guard : impl::NonCopyable {
+	public:
+		explicit Guard(Thread *thr) : g_thread(thr) {
+			thr->enter();
+		}
+
+		~Guard() {
+			g_thread->exit();
+		}
+
+	private:
+		Thread *g_thread;
+	};
+
+protected:
+	/* Reuses a record of an exited thread if there is one */
+	Record *register_record() {
+		Record *rec;
+		int unused;
+
+		for (rec = __atomic_load_n(&ed_records, __ATOMIC_ACQUIRE);
+		    rec != NULL; rec = rec->next) {
+			unused = 0;
+			if (__atomic_compare_exchange_n(&rec->in_use, &unused, 1,
+			    false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+				return rec;
+		}
+		rec = new Record();
+		rec->next = __atomic_load_n(&ed_records, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&ed_records, &rec->next, rec,
+		    true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			;
+		return rec;
+	}
+
+	/* Advances the epoch if every active thread has observed it */
+	void try_advance() {
+		unsigned long e = epoch();
+		Record *rec;
+
+		for (rec = __atomic_load_n(&ed_records, __ATOMIC_ACQUIRE);
+		    rec != NULL; rec = rec->next) {
+			if (__atomic_load_n(&rec->in_use, __ATOMIC_ACQUIRE) &&
+			    __atomic_load_n(&rec->active, __ATOMIC_SEQ_CST) &&
+			    __atomic_load_n(&rec->epoch, __ATOMIC_SEQ_CST) != e)
+				return;
+		}
+		__atomic_compare_exchange_n(&ed_epoch, &e, e + 1, false,
+		    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+	}
+
+private:
+	unsigned long ed_epoch;
+	Record *ed_records;
+};
+
+} // namespace ecl
+
+#endif
@@ -0,0 +1,370 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Open addressing hash index of object pointers.
+ *
+ * Slots are split into groups of 16, each with a control byte per slot
+ * holding 7 bits of the hash, EMPTY or DELETED.  A probe loads a group of
+ * control bytes, compares all of them against the tag at once and only
+ * calls EntryType::compare_key_fn() for matching slots.  Groups are probed
+ * quadratically and a probe stops at the first group with an EMPTY byte.
+ *
+ * EntryType provides hash_fn(obj), hash_key_fn(key), compare_fn(a, b) and
+ * compare_key_fn(key, obj), the same as for HashTableHead.  Objects don't
+ * embed any linkage.
+ */
+
+#ifndef ECL_HASHINDEX_HPP
+#define ECL_HASHINDEX_HPP
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "impl.hpp"
+
+namespace ecl {
+
+template <typename EntryT>
+class HashIndex : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+
+	struct Iterator;
+
+	HashIndex() : hi_ctrl(NULL), hi_slots(NULL), hi_capacity(0),
+	    hi_count(0), hi_deleted(0) { }
+
+	~HashIndex() {
+		free(hi_ctrl);
+		free(hi_slots);
+	}
+
+	bool empty() const {
+		return (hi_count == 0);
+	}
+
+	size_t size() const {
+		return hi_count;
+	}
+
+	size_t capacity() const {
+		return hi_capacity;
+	}
+
+	void clear() {
+		if (hi_capacity != 0)
+			memset(hi_ctrl, EMPTY, hi_capacity);
+		hi_count = 0;
+		hi_deleted = 0;
+	}
+
+	/* Makes room for n elements without rehashing */
+	void reserve(size_t n) {
+		size_t cap = GROUP;
+
+		while (cap * MAX_LOAD_NUM / MAX_LOAD_DEN < n)
+			cap *= 2;
+		if (cap > hi_capacity)
+			rehash(cap);
+	}
+
+	template<typename KeyType>
+	ObjectType *find(const KeyType &key) const {
+		if (hi_count == 0)
+			return NULL;
+		return find_hashed(key, EntryType::hash_key_fn(key));
+	}
+
+	ObjectType *find_element(const ObjectType *elm) const {
+		size_t slot;
+
+		if (hi_count == 0)
+			return NULL;
+		slot = find_slot(elm, EntryType::hash_fn(elm));
+		return slot == NONE ? NULL : hi_slots[slot];
+	}
+
+	/*
+	 * Looks up n keys, out[i] is the object for keys[i] or NULL.  Hashes
+	 * a batch of keys and prefetches their home groups, then prefetches
+	 * the first candidate objects before probing.
+	 */
+	template<typename KeyType>
+	void find_batch(const KeyType *keys, size_t n, ObjectType **out) const {
+		size_t hash[BATCH];
+		size_t i, j, m, group;
+		int mask;
+
+		if (hi_count == 0) {
+			for (i = 0; i < n; i++)
+				out[i] = NULL;
+			return;
+		}
+		for (i = 0; i < n; i += m) {
+			m = n - i < BATCH ? n - i : (size_t)BATCH;
+			for (j = 0; j < m; j++) {
+				hash[j] = EntryType::hash_key_fn(keys[i + j]);
+				group = group_of(hash[j]);
+				__builtin_prefetch(hi_ctrl + group);
+				__builtin_prefetch(hi_slots + group);
+			}
+			/* Prefetch the first candidate object */
+			for (j = 0; j < m; j++) {
+				group = group_of(hash[j]);
+				mask = match(group, tag_of(hash[j]));
+				if (mask != 0)
+					__builtin_prefetch(hi_slots[group +
+					    __builtin_ctz(mask)]);
+			}
+			for (j = 0; j < m; j++)
+				out[i + j] = find_hashed(keys[i + j], hash[j]);
+		}
+	}
+
+	/* Returns an object with the same key if already present */
+	ObjectType *insert(ObjectType *obj) {
+		size_t hash, slot;
+
+		hash = EntryType::hash_fn(obj);
+		if (hi_count != 0) {
+			slot = find_slot(obj, hash);
+			if (slot != NONE)
+				return hi_slots[slot];
+		}
+		if ((hi_count + hi_deleted + 1) * MAX_LOAD_DEN >
+		    hi_capacity * MAX_LOAD_NUM) {
+			/* Drop tombstones in place unless mostly live */
+			if (hi_capacity == 0)
+				rehash(GROUP);
+			else if ((hi_count + 1) * MAX_LOAD_DEN * 2 >
+			    hi_capacity * MAX_LOAD_NUM)
+				rehash(hi_capacity * 2);
+			else
+				rehash(hi_capacity);
+		}
+		insert_unique(obj, hash);
+		return NULL;
+	}
+
+	/* Removes the object with the same key as elm, returns it */
+	ObjectType *remove(const ObjectType *elm) {
+		ObjectType *obj;
+		size_t slot, group;
+
+		if (hi_count == 0)
+			return NULL;
+		slot = find_slot(elm, EntryType::hash_fn(elm));
+		if (slot == NONE)
+			return NULL;
+		obj = hi_slots[slot];
+		group = slot & ~(size_t)(GROUP - 1);
+		/*
+		 * A group that still has an EMPTY byte was never full and no
+		 * probe went past it, the slot can become EMPTY again.
+		 */
+		if (match_empty(group) != 0)
+			hi_ctrl[slot] = EMPTY;
+		else {
+			hi_ctrl[slot] = DELETED;
+			hi_deleted++;
+		}
+		hi_count--;
+		return obj;
+	}
+
+	/* The index must not be modified while iterating */
+	struct Iterator : impl::NonCopyable {
+		ObjectType *init(const HashIndex *index) {
+			it_index = index;
+			it_slot = 0;
+			return next();
+		}
+
+		ObjectType *next() {
+			while (it_slot < it_index->hi_capacity) {
+				if (is_full(it_index->hi_ctrl[it_slot]))
+					return it_index->hi_slots[it_slot++];
+				it_slot++;
+			}
+			return NULL;
+		}
+
+	private:
+		const HashIndex *it_index;
+		size_t it_slot;
+	};
+
+protected:
+	enum { GROUP = 16 };
+	enum { BATCH = 16 };
+	enum { MAX_LOAD_NUM = 7, MAX_LOAD_DEN = 8 };
+	enum { EMPTY = 0x80, DELETED = 0xfe };
+
+	static const size_t NONE = (size_t)-1;
+
+	static bool is_full(uint8_t ctrl) {
+		return (ctrl & 0x80) == 0;
+	}
+
+	static uint8_t tag_of(size_t hash) {
+		return hash & 0x7f;
+	}
+
+	/* First slot of the home group */
+	size_t group_of(size_t hash) const {
+		return (hash >> 7) * GROUP & (hi_capacity - 1);
+	}
+
+#ifdef __SSE2__
+	int match(size_t group, uint8_t tag) const {
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag),
+		    _mm_load_si128((const __m128i *)(hi_ctrl + group))));
+	}
+
+	int match_empty(size_t group) const {
+		return match(group, EMPTY);
+	}
+
+	int match_free(size_t group) const {
+		return _mm_movemask_epi8(
+		    _mm_load_si128((const __m128i *)(hi_ctrl + group)));
+	}
+#else
+	int match(size_t group, uint8_t tag) const {
+		int i, m = 0;
+
+		for (i = 0; i < GROUP; i++)
+			m |= (hi_ctrl[group + i] == tag) << i;
+		return m;
+	}
+
+	int match_empty(size_t group) const {
+		return match(group, EMPTY);
+	}
+
+	int match_free(size_t group) const {
+		int i, m = 0;
+
+		for (i = 0; i < GROUP; i++)
+			m |= !is_full(hi_ctrl[group + i]) << i;
+		return m;
+	}
+#endif
+
+	template<typename KeyType>
+	ObjectType *find_hashed(const KeyType &key, size_t hash) const {
+		size_t group, step, slot;
+		int m;
+
+		group = group_of(hash);
+		for (step = GROUP;; step += GROUP) {
+			for (m = match(group, tag_of(hash)); m != 0; m &= m - 1) {
+				slot = group + __builtin_ctz(m);
+				if (EntryType::compare_key_fn(key,
+				    hi_slots[slot]) == 0)
+					return hi_slots[slot];
+			}
+			if (match_empty(group) != 0)
+				return NULL;
+			group = (group + step) & (hi_capacity - 1);
+		}
+	}
+
+	size_t find_slot(const ObjectType *elm, size_t hash) const {
+		size_t group, step, slot;
+		int m;
+
+		group = group_of(hash);
+		for (step = GROUP;; step += GROUP) {
+			for (m = match(group, tag_of(hash)); m != 0; m &= m - 1) {
+				slot = group + __builtin_ctz(m);
+				if (EntryType::compare_fn(elm, hi_slots[slot]) == 0)
+					return slot;
+			}
+			if (match_empty(group) != 0)
+				return NONE;
+			group = (group + step) & (hi_capacity - 1);
+		}
+	}
+
+	void insert_unique(ObjectType *obj, size_t hash) {
+		size_t group, step, slot;
+		int m;
+
+		group = group_of(hash);
+		for (step = GROUP;; step += GROUP) {
+			m = match_free(group);
+			if (m != 0)
+				break;
+			group = (group + step) & (hi_capacity - 1);
+		}
+		slot = group + __builtin_ctz(m);
+		if (hi_ctrl[slot] == DELETED)
+			hi_deleted--;
+		hi_ctrl[slot] = tag_of(hash);
+		hi_slots[slot] = obj;
+		hi_count++;
+	}
+
+	void rehash(size_t capacity) {
+		ObjectType **slots = hi_slots;
+		uint8_t *ctrl = hi_ctrl;
+		size_t i, old_capacity = hi_capacity;
+
+		if (posix_memalign((void **)&hi_ctrl, 64, capacity) != 0)
+			abort();
+		hi_slots = (ObjectType **)malloc(capacity * sizeof(*hi_slots));
+		if (hi_slots == NULL)
+			abort();
+		memset(hi_ctrl, EMPTY, capacity);
+		hi_capacity = capacity;
+		hi_count = 0;
+		hi_deleted = 0;
+		for (i = 0; i < old_capacity; i++)
+			if (is_full(ctrl[i]))
+				insert_unique(slots[i],
+				    EntryType::hash_fn(slots[i]));
+		free(ctrl);
+		free(slots);
+	}
+
+private:
+	uint8_t *hi_ctrl;
+	ObjectType **hi_slots;
+	size_t hi_capacity;
+	size_t hi_count;
+	size_t hi_deleted;
+};
+
+} // namespace ecl
+
+#endif
@@ -0,0 +1,300 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Chained hash set with SListHead buckets.
+ *
+ * The entry caches EntryType::hash_fn() of the object, lookups hash the key
+ * with EntryType::hash_key_fn() and compare keys with compare_key_fn() only
+ * on a hash match.  Bucket counts are powers of two indexed by the low bits
+ * of the hash.
+ *
+ * The table doubles once there are more elements than buckets.  Buckets
+ * are migrated to the new table a few at a time by every insert and remove,
+ * lookups check the old bucket until it is migrated.
+ */
+
+#ifndef ECL_HASHTABLE_HPP
+#define ECL_HASHTABLE_HPP
+
+#include "slist.hpp"
+
+namespace ecl {
+
+template <typename EntryT>
+class ConcurrentHashTableHead;
+
+template <typename EntryT>
+class HashTableHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+	typedef SListHead<EntryType> BucketType;
+
+	struct Iterator;
+
+	HashTableHead() : ht_buckets(NULL), ht_old(NULL), ht_size(0),
+	    ht_old_size(0), ht_migrate(0), ht_count(0) { }
+
+	~HashTableHead() {
+		delete[] ht_buckets;
+		delete[] ht_old;
+	}
+
+	bool empty() const {
+		return (ht_count == 0);
+	}
+
+	size_t size() const {
+		return ht_count;
+	}
+
+	size_t bucket_count() const {
+		return ht_size;
+	}
+
+	bool rehashing() const {
+		return (ht_old != NULL);
+	}
+
+	template<typename KeyType>
+	ObjectType *find(const KeyType &key) {
+		return find_impl(key);
+	}
+
+	template<typename KeyType>
+	const ObjectType *find(const KeyType &key) const {
+		return find_impl(key);
+	}
+
+	ObjectType *find_element(const ObjectType *elm) {
+		return find_element_impl(elm, EntryType::hash_fn(elm));
+	}
+
+	const ObjectType *find_element(const ObjectType *elm) const {
+		return find_element_impl(elm, EntryType::hash_fn(elm));
+	}
+
+	/* Returns an object with the same key if already present */
+	ObjectType *insert(ObjectType *obj) {
+		ObjectType *tmp;
+		size_t hash;
+
+		hash = EntryType::hash_fn(obj);
+		if (ht_size == 0) {
+			ht_buckets = new BucketType[MIN_SIZE];
+			ht_size = MIN_SIZE;
+		}
+		tmp = find_element_impl(obj, hash);
+		if (tmp != NULL)
+			return tmp;
+		entry(obj)->hte_hash = hash;
+		bucket(hash)->insert_head(obj);
+		ht_count++;
+		if (ht_old == NULL && ht_count > ht_size)
+			rehash_start(ht_size * 2);
+		rehash_step();
+		return NULL;
+	}
+
+	ObjectType *remove(ObjectType *obj) {
+		bucket(entry(obj)->hte_hash)->remove(obj);
+		ht_count--;
+		rehash_step();
+		return obj;
+	}
+
+	/* Unlinks all elements, keeps the bucket array */
+	void clear() {
+		size_t i;
+
+		for (i = 0; i < ht_size; i++)
+			while (!ht_buckets[i].empty())
+				ht_buckets[i].remove_head();
+		if (ht_old != NULL) {
+			for (i = ht_migrate; i < ht_old_size; i++)
+				while (!ht_old[i].empty())
+					ht_old[i].remove_head();
+			delete[] ht_old;
+			ht_old = NULL;
+		}
+		ht_count = 0;
+	}
+
+	/* The table must not be modified while iterating */
+	struct Iterator : impl::NonCopyable {
+		ObjectType *init(HashTableHead *head) {
+			it_head = head;
+			it_old = false;
+			it_index = 0;
+			it_next = head->ht_size == 0 ? NULL :
+			    head->ht_buckets[0].first();
+			return next();
+		}
+
+		ObjectType *next() {
+			ObjectType *obj;
+
+			while (it_next == NULL) {
+				if (!next_bucket())
+					return NULL;
+			}
+			obj = it_next;
+			it_next = entry(obj)->next();
+			return obj;
+		}
+
+	private:
+		bool next_bucket() {
+			it_index++;
+			if (!it_old && it_index >= it_head->ht_size) {
+				if (it_head->ht_old == NULL)
+					return false;
+				it_old = true;
+				it_index = it_head->ht_migrate;
+			}
+			if (it_old && it_index >= it_head->ht_old_size)
+				return false;
+			if (it_old)
+				it_next = it_head->ht_old[it_index].first();
+			else
+				it_next = it_head->ht_buckets[it_index].first();
+			return true;
+		}
+
+		HashTableHead *it_head;
+		ObjectType *it_next;
+		size_t it_index;
+		bool it_old;
+	};
+
+protected:
+	enum { MIN_SIZE = 16 };
+	/* Old buckets migrated per insert or remove */
+	enum { REHASH_STEP = 4 };
+
+	static EntryType *entry(ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	BucketType *bucket(size_t hash) const {
+		size_t i;
+
+		if (ht_old != NULL) {
+			i = hash & (ht_old_size - 1);
+			if (i >= ht_migrate)
+				return &ht_old[i];
+		}
+		return &ht_buckets[hash & (ht_size - 1)];
+	}
+
+	template<typename KeyType>
+	ObjectType *find_impl(const KeyType &key) const {
+		ObjectType *obj;
+		size_t hash;
+
+		if (ht_count == 0)
+			return NULL;
+		hash = EntryType::hash_key_fn(key);
+		for (obj = bucket(hash)->first(); obj != NULL;
+		    obj = entry(obj)->next())
+			if (entry(obj)->hte_hash == hash &&
+			    EntryType::compare_key_fn(key, obj) == 0)
+				return obj;
+		return NULL;
+	}
+
+	ObjectType *find_element_impl(const ObjectType *elm,
+	    size_t hash) const {
+		ObjectType *obj;
+
+		if (ht_count == 0)
+			return NULL;
+		for (obj = bucket(hash)->first(); obj != NULL;
+		    obj = entry(obj)->next())
+			if (entry(obj)->hte_hash == hash &&
+			    EntryType::compare_fn(elm, obj) == 0)
+				return obj;
+		return NULL;
+	}
+
+	void rehash_start(size_t size) {
+		ht_old = ht_buckets;
+		ht_old_size = ht_size;
+		ht_buckets = new BucketType[size];
+		ht_size = size;
+		ht_migrate = 0;
+	}
+
+	void rehash_step() {
+		BucketType *old;
+		ObjectType *obj;
+		int i;
+
+		if (ht_old == NULL)
+			return;
+		for (i = 0; i < REHASH_STEP && ht_migrate < ht_old_size; i++) {
+			old = &ht_old[ht_migrate++];
+			while (!old->empty()) {
+				obj = old->first();
+				old->remove_head();
+				ht_buckets[entry(obj)->hte_hash & (ht_size - 1)]
+				    .insert_head(obj);
+			}
+		}
+		if (ht_migrate == ht_old_size) {
+			delete[] ht_old;
+			ht_old = NULL;
+		}
+	}
+
+private:
+	BucketType *ht_buckets;
+	BucketType *ht_old;
+	size_t ht_size;
+	size_t ht_old_size;
+	/* Old buckets below ht_migrate are empty */
+	size_t ht_migrate;
+	size_t ht_count;
+};
+
+template <typename EntryT, typename ObjectT>
+class HashTableEntry : public SListEntry<EntryT, ObjectT> {
+public:
+	friend class HashTableHead<EntryT>;
+	friend class ConcurrentHashTableHead<EntryT>;
+
+	size_t hash() const {
+		return hte_hash;
+	}
+
+private:
+	size_t hte_hash;
+};
+
+} // namespace ecl
+
+#endif
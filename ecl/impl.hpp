@@ -28,6 +28,8 @@
 #define ECL_IMPL_HPP
 
 #include <cassert>
+#include <stddef.h>
+#include <stdint.h>
 
 namespace ecl {
 namespace impl {
@@ -43,6 +45,41 @@ private:
 	const NonCopyable& operator=(const NonCopyable&);
 };
 
+/*
+ * Element count of a head, a base class so that it takes no space unless
+ * the policy has counting set.
+ */
+template<bool Enabled>
+class Counter {
+protected:
+	size_t count_get() const { return 0; }
+	void count_add(size_t n) { }
+	void count_sub(size_t n) { }
+	void count_reset() { }
+	void count_swap(Counter *c) { }
+};
+
+template<>
+class Counter<true> {
+protected:
+	Counter() : ctr_count(0) { }
+
+	size_t count_get() const { return ctr_count; }
+	void count_add(size_t n) { ctr_count += n; }
+	void count_sub(size_t n) { ctr_count -= n; }
+	void count_reset() { ctr_count = 0; }
+
+	void count_swap(Counter *c) {
+		size_t tmp = ctr_count;
+
+		ctr_count = c->ctr_count;
+		c->ctr_count = tmp;
+	}
+
+private:
+	size_t ctr_count;
+};
+
 template<typename EntryType>
 class Iterator : NonCopyable {
 public:
@@ -139,6 +176,12 @@ protected:
 	const ObjectType *rit_prev;
 };
 
+static inline void cpu_spinwait() {
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
 template<typename ObjectType, typename EntryImpl>
 ObjectType *entry_to_object(const EntryImpl *ent) {
 	// Use non NULL value
@@ -151,11 +194,177 @@ ObjectType *entry_to_object(const EntryImpl *ent) {
 	return fake_val;
 }
 
+/*
+ * Stable merge and merge sort of NULL terminated chains, LinkT::next(obj)
+ * returns the address of the next link of obj.  cmp(a, b) orders objects
+ * like EntryType::compare_fn().  Back links are left for the caller.
+ */
+template<typename LinkT, typename ObjectType, typename CompareT>
+ObjectType *list_merge(ObjectType *a, ObjectType *b, CompareT &cmp) {
+	ObjectType *first, **tail = &first;
+
+	while (a != NULL && b != NULL) {
+		if (cmp(b, a) < 0) {
+			*tail = b;
+			tail = LinkT::next(b);
+			b = *tail;
+		} else {
+			*tail = a;
+			tail = LinkT::next(a);
+			a = *tail;
+		}
+	}
+	*tail = a != NULL ? a : b;
+	return first;
+}
+
+template<typename LinkT, typename ObjectType, typename CompareT>
+ObjectType *list_sort(ObjectType *first, CompareT &cmp) {
+	/* bins[i] is NULL or a sorted run of 2^i objects */
+	ObjectType *bins[8 * sizeof(void *)];
+	ObjectType *run;
+	int i, n = 0;
+
+	while (first != NULL) {
+		run = first;
+		first = *LinkT::next(run);
+		*LinkT::next(run) = NULL;
+		/* Runs in lower bins hold later objects */
+		for (i = 0; i < n && bins[i] != NULL; i++) {
+			run = list_merge<LinkT>(bins[i], run, cmp);
+			bins[i] = NULL;
+		}
+		if (i == n)
+			n++;
+		bins[i] = run;
+	}
+	for (i = 0, run = NULL; i < n; i++)
+		if (bins[i] != NULL)
+			run = run == NULL ? bins[i] :
+			    list_merge<LinkT>(bins[i], run, cmp);
+	return run;
+}
+
+/* Number of objects in [first, last], or up to the end if last is NULL */
+template<typename LinkT, typename ObjectType>
+size_t list_count(ObjectType *first, ObjectType *last) {
+	size_t n = 0;
+
+	for (; first != NULL; first = *LinkT::next(first)) {
+		n++;
+		if (first == last)
+			break;
+	}
+	return n;
+}
+
+/* Targets for objects unlinked by the heads' extract_if and partition */
+template<typename ObjectType>
+struct ExtractSink {
+	ExtractSink(ObjectType **out_) : out(out_), n(0) { }
+
+	void operator()(ObjectType *obj) {
+		out[n++] = obj;
+	}
+
+	ObjectType **out;
+	size_t n;
+};
+
+/* Appends to a queue */
+template<typename HeadT>
+struct TailSink {
+	TailSink(HeadT *head_) : head(head_) { }
+
+	void operator()(typename HeadT::ObjectType *obj) {
+		head->insert_tail(obj);
+	}
+
+	HeadT *head;
+};
+
+/* Inserts in order in front of the elements of a list */
+template<typename HeadT>
+struct FrontSink {
+	FrontSink(HeadT *head_) : head(head_), last(NULL) { }
+
+	void operator()(typename HeadT::ObjectType *obj) {
+		if (last == NULL)
+			head->insert_head(obj);
+		else
+			head->insert_after(last, obj);
+		last = obj;
+	}
+
+	HeadT *head;
+	typename HeadT::ObjectType *last;
+};
+
+/* Nodes a list walk runs ahead of the node it works on */
+enum { PREFETCH_DISTANCE = 4 };
+
+/*
+ * LSD radix sort of a NULL terminated chain by the unsigned 64-bit
+ * key_fn(obj), a byte per pass.  The first pass also collects the bits
+ * that differ between keys, later passes over constant bytes are skipped.
+ * Each pass keeps a cursor PREFETCH_DISTANCE nodes ahead, nodes are only
+ * relinked behind it.  Stores the new last object in *lastp unless NULL.
+ */
+template<typename LinkT, typename ObjectType, typename KeyFnT>
+ObjectType *list_radix_sort(ObjectType *first, KeyFnT &key_fn,
+    ObjectType **lastp) {
+	ObjectType *heads[256], *lasts[256];
+	ObjectType *obj, *next, *ahead, *last = NULL, **tail;
+	uint64_t key, kand = ~(uint64_t)0, kor = 0;
+	int shift, i;
+
+	for (shift = 0; shift < 64; shift += 8) {
+		if (shift != 0 && (((kand ^ kor) >> shift) & 0xff) == 0)
+			continue;
+		for (i = 0; i < 256; i++)
+			lasts[i] = NULL;
+		for (ahead = first, i = 0; ahead != NULL &&
+		    i < PREFETCH_DISTANCE; i++)
+			ahead = *LinkT::next(ahead);
+		for (obj = first; obj != NULL; obj = next) {
+			if (ahead != NULL &&
+			    (ahead = *LinkT::next(ahead)) != NULL)
+				__builtin_prefetch(ahead);
+			next = *LinkT::next(obj);
+			key = key_fn(obj);
+			if (shift == 0) {
+				kand &= key;
+				kor |= key;
+			}
+			i = (key >> shift) & 0xff;
+			if (lasts[i] == NULL)
+				heads[i] = obj;
+			else
+				*LinkT::next(lasts[i]) = obj;
+			lasts[i] = obj;
+		}
+		for (i = 0, tail = &first; i < 256; i++) {
+			if (lasts[i] == NULL)
+				continue;
+			*tail = heads[i];
+			tail = LinkT::next(lasts[i]);
+			last = lasts[i];
+		}
+		*tail = NULL;
+	}
+	if (lastp != NULL)
+		*lastp = last;
+	return first;
+}
+
 } // namespace impl
 
 namespace policy {
 
 	struct Generic {
+		/* Heads keep an element count, see Counting */
+		enum { counting = false };
+
 		struct RemoveCtx { };
 
 		template<typename HeadT>
@@ -189,6 +398,16 @@ namespace policy {
 		static void remove_post(RemoveCtx &ctx, EntryT *ent) { }
 	};
 
+	/*
+	 * Adds an O(1) size() to a head policy, e.g.
+	 *	template<> struct TailqPolicy<MyEntry> :
+	 *	    policy::Counting<policy::Tailq::Debug> { };
+	 */
+	template<typename PolicyT>
+	struct Counting : PolicyT {
+		enum { counting = true };
+	};
+
 } // namespace policy
 
 } // namespace ecl
@@ -40,7 +40,7 @@ namespace policy { // {{{
 struct List {
 	struct Default : policy::Generic { };
 
-	struct Debug {
+	struct Debug : policy::Generic {
 		struct RemoveCtx {
 			void **old_next;
 			void **old_prev;
@@ -100,7 +100,8 @@ struct ListPolicy : policy::List::Debug { };
 // struct ListPolicy : policy::List::Default { };
 
 template <typename EntryT>
-class ListHead : impl::NonCopyable {
+class ListHead : impl::NonCopyable,
+    impl::Counter<EntryT::Policy::counting> {
 public:
 	typedef EntryT EntryType;
 	typedef typename EntryType::ObjectType ObjectType;
@@ -122,6 +123,13 @@ public:
 		return lh_first;
 	}
 
+	/* O(n) unless the policy is counting */
+	size_t size() const {
+		if (Policy::counting)
+			return this->count_get();
+		return impl::list_count<Link>(lh_first, (ObjectType *)NULL);
+	}
+
 	void insert_head(ObjectType *obj) {
 		Policy::check_head(this);
 
@@ -129,6 +137,101 @@ public:
 			entry(lh_first)->le_prev = &entry(obj)->le_next;
 		lh_first = obj;
 		entry(obj)->le_prev = &lh_first;
+		this->count_add(1);
+	}
+
+	/* Same as the ListEntry methods, but also keep the count */
+	void insert_after(ObjectType *listobj, ObjectType *obj) {
+		entry(obj)->insert_after_impl(listobj);
+		this->count_add(1);
+	}
+
+	void insert_before(ObjectType *listobj, ObjectType *obj) {
+		entry(obj)->insert_before_impl(listobj);
+		this->count_add(1);
+	}
+
+	void remove(ObjectType *obj) {
+		entry(obj)->remove_impl();
+		this->count_sub(1);
+	}
+
+	/*
+	 * Moves [first, last] of nhead after pos, or to the head if pos is
+	 * NULL.  nhead may be this list if pos is not in the range.
+	 */
+	void splice_after(ObjectType *pos, ListHead *nhead, ObjectType *first,
+	    ObjectType *last) {
+		ObjectType **prev;
+
+		Policy::check_prev(entry(first));
+		Policy::check_next(entry(last));
+
+		if (Policy::counting) {
+			size_t n = impl::list_count<Link>(first, last);
+
+			nhead->count_sub(n);
+			this->count_add(n);
+		}
+		if (entry(last)->le_next != NULL)
+			entry(entry(last)->le_next)->le_prev =
+			    entry(first)->le_prev;
+		*entry(first)->le_prev = entry(last)->le_next;
+
+		prev = pos == NULL ? &lh_first : &entry(pos)->le_next;
+		if ((entry(last)->le_next = *prev) != NULL)
+			entry(*prev)->le_prev = &entry(last)->le_next;
+		*prev = first;
+		entry(first)->le_prev = prev;
+	}
+
+	/*
+	 * Single pass removal of the objects matching pred(obj), each is
+	 * passed to disposer(obj) once unlinked.  Returns the number removed.
+	 */
+	template<typename PredT, typename DisposerT>
+	size_t remove_if(PredT pred, DisposerT &disposer) {
+		return remove_matching(pred, disposer, (size_t)-1);
+	}
+
+	/*
+	 * Moves the objects matching pred(obj) in front of the elements of
+	 * other, in order.
+	 */
+	template<typename PredT>
+	size_t partition(PredT pred, ListHead *other) {
+		impl::FrontSink<ListHead> sink(other);
+
+		assert(other != this);
+		return remove_matching(pred, sink, (size_t)-1);
+	}
+
+	/*
+	 * Removes up to max objects matching pred(obj) and stores them in
+	 * out[], the pass stops once max objects are found.
+	 */
+	template<typename PredT>
+	size_t extract_if(PredT pred, ObjectType **out, size_t max) {
+		impl::ExtractSink<ObjectType> sink(out);
+
+		return remove_matching(pred, sink, max);
+	}
+
+	/* Stable merge sort, cmp(a, b) compares objects like compare_fn() */
+	template<typename CompareT>
+	void sort(CompareT cmp) {
+		lh_first = impl::list_sort<Link>(lh_first, cmp);
+		relink();
+	}
+
+	/* Both lists must be sorted, nhead is left empty */
+	template<typename CompareT>
+	void merge(ListHead *nhead, CompareT cmp) {
+		lh_first = impl::list_merge<Link>(lh_first, nhead->lh_first, cmp);
+		nhead->lh_first = NULL;
+		this->count_add(nhead->count_get());
+		nhead->count_reset();
+		relink();
 	}
 
 	void swap(ListHead *nhead) {
@@ -139,6 +242,7 @@ public:
 			entry(swap_tmp)->le_prev = &this->lh_first;
 		if ((swap_tmp = nhead->lh_first) != NULL)
 			entry(swap_tmp)->le_prev = &nhead->lh_first;
+		this->count_swap(nhead);
 	}
 
 protected:
@@ -146,6 +250,58 @@ protected:
 		return EntryType::entry(obj);
 	}
 
+	struct Link {
+		static ObjectType **next(ObjectType *obj) {
+			return &entry(obj)->le_next;
+		}
+	};
+
+	/*
+	 * Back links are only written where the chain changes, sink(obj)
+	 * gets each unlinked object.
+	 */
+	template<typename PredT, typename SinkT>
+	size_t remove_matching(PredT &pred, SinkT &sink, size_t max) {
+		typename Policy::RemoveCtx ctx;
+		ObjectType **prev = &lh_first;
+		ObjectType *obj, *next;
+		size_t n = 0;
+
+		for (obj = lh_first; obj != NULL && n < max; obj = next) {
+			next = entry(obj)->le_next;
+			if (pred(obj)) {
+				Policy::remove_pre(ctx, entry(obj));
+				Policy::remove_post(ctx, entry(obj));
+				n++;
+				sink(obj);
+				continue;
+			}
+			if (*prev != obj) {
+				*prev = obj;
+				entry(obj)->le_prev = prev;
+			}
+			prev = &entry(obj)->le_next;
+		}
+		if (*prev != obj) {
+			*prev = obj;
+			if (obj != NULL)
+				entry(obj)->le_prev = prev;
+		}
+		this->count_sub(n);
+		return n;
+	}
+
+	/* Rebuilds back links from the forward chain */
+	void relink() {
+		ObjectType **prev = &lh_first;
+		ObjectType *obj;
+
+		for (obj = lh_first; obj != NULL; obj = entry(obj)->le_next) {
+			entry(obj)->le_prev = prev;
+			prev = &entry(obj)->le_next;
+		}
+	}
+
 private:
 	ObjectType *lh_first;
 };
@@ -192,7 +348,24 @@ public:
 		return this->le_next;
 	}
 
+	/* Counting policies must use the ListHead methods */
 	void insert_after(ObjectType *listobj) {
+		assert(!Policy::counting);
+		insert_after_impl(listobj);
+	}
+
+	void insert_before(ObjectType *listobj) {
+		assert(!Policy::counting);
+		insert_before_impl(listobj);
+	}
+
+	void remove() {
+		assert(!Policy::counting);
+		remove_impl();
+	}
+
+protected:
+	void insert_after_impl(ObjectType *listobj) {
 		Policy::check_next(entry(listobj));
 
 		if ((this->le_next = entry(listobj)->le_next) != NULL)
@@ -201,7 +374,7 @@ public:
 		this->le_prev = &entry(listobj)->le_next;
 	}
 
-	void insert_before(ObjectType *listobj) {
+	void insert_before_impl(ObjectType *listobj) {
 		Policy::check_prev(entry(listobj));
 
 		this->le_prev = entry(listobj)->le_prev;
@@ -210,7 +383,7 @@ public:
 		entry(listobj)->le_prev = &this->le_next;
 	}
 
-	void remove() {
+	void remove_impl() {
 		typename Policy::RemoveCtx ctx;
 
 		Policy::remove_pre(ctx, this);
@@ -224,7 +397,6 @@ public:
 		Policy::remove_post(ctx, this);
 	}
 
-protected:
 	static EntryType *entry(ObjectType *obj) {
 		return obj;
 	}
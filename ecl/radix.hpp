@@ -0,0 +1,370 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Sparse array of object pointers indexed by 64-bit integers.
+ *
+ * A radix tree of 64-way nodes, the height grows with the largest index
+ * stored.  Every node has a bitmap of present slots and NTAGS tag bitmaps;
+ * a bit in an inner node is set if the child has any present (tagged)
+ * entries, so searches skip empty subtrees with a single ctz.
+ */
+
+#ifndef ECL_RADIX_HPP
+#define ECL_RADIX_HPP
+
+#include "impl.hpp"
+
+namespace ecl {
+
+template <typename ObjectT>
+class RadixArray : impl::NonCopyable {
+public:
+	typedef ObjectT ObjectType;
+
+	enum { NTAGS = 2 };
+
+	struct Iterator;
+
+	RadixArray() : ra_root(NULL), ra_height(0), ra_count(0) { }
+
+	~RadixArray() {
+		clear();
+	}
+
+	bool empty() const {
+		return (ra_count == 0);
+	}
+
+	size_t size() const {
+		return ra_count;
+	}
+
+	void clear() {
+		if (ra_root != NULL)
+			destroy_subtree(ra_root, top_shift());
+		ra_root = NULL;
+		ra_height = 0;
+		ra_count = 0;
+	}
+
+	ObjectType *load(uint64_t index) const {
+		Node *node = ra_root;
+		int shift;
+
+		if (!covers(index))
+			return NULL;
+		for (shift = top_shift(); shift > 0; shift -= BITS) {
+			node = (Node *)node->slots[offset(index, shift)];
+			if (node == NULL)
+				return NULL;
+		}
+		return (ObjectType *)node->slots[offset(index, 0)];
+	}
+
+	/* Returns the object previously stored at index */
+	ObjectType *store(uint64_t index, ObjectType *obj) {
+		ObjectType *old;
+		Node *node, *child;
+		int shift, off;
+
+		assert(obj != NULL);
+		if (ra_root == NULL) {
+			ra_root = new Node();
+			for (ra_height = 1; !covers(index); ra_height++)
+				;
+		}
+		while (!covers(index))
+			grow();
+		node = ra_root;
+		for (shift = top_shift(); shift > 0; shift -= BITS) {
+			off = offset(index, shift);
+			child = (Node *)node->slots[off];
+			if (child == NULL) {
+				child = new Node();
+				node->slots[off] = child;
+				node->present |= bit(off);
+			}
+			node = child;
+		}
+		off = offset(index, 0);
+		old = (ObjectType *)node->slots[off];
+		node->slots[off] = obj;
+		node->present |= bit(off);
+		if (old == NULL)
+			ra_count++;
+		return old;
+	}
+
+	/* Removes and returns the object at index, clears its tags */
+	ObjectType *erase(uint64_t index) {
+		Node *path[MAX_HEIGHT];
+		ObjectType *old;
+		int i, off, t;
+
+		if (!lookup_path(index, path))
+			return NULL;
+		i = ra_height - 1;
+		off = offset(index, 0);
+		old = (ObjectType *)path[i]->slots[off];
+		path[i]->slots[off] = NULL;
+		path[i]->present &= ~bit(off);
+		for (t = 0; t < NTAGS; t++)
+			path[i]->tags[t] &= ~bit(off);
+		for (; i > 0; i--) {
+			off = offset(index, (ra_height - i) * BITS);
+			for (t = 0; t < NTAGS; t++)
+				if (path[i]->tags[t] == 0)
+					path[i - 1]->tags[t] &= ~bit(off);
+			if (path[i]->present == 0) {
+				delete path[i];
+				path[i - 1]->slots[off] = NULL;
+				path[i - 1]->present &= ~bit(off);
+			}
+		}
+		ra_count--;
+		shrink();
+		return old;
+	}
+
+	/*
+	 * Finds the first present entry at or after *index and stores its
+	 * index in *index.
+	 */
+	ObjectType *find_next_present(uint64_t *index) const {
+		return find_next(index, -1);
+	}
+
+	ObjectType *find_next_tagged(uint64_t *index, int tag) const {
+		assert(tag >= 0 && tag < NTAGS);
+		return find_next(index, tag);
+	}
+
+	/* Does nothing unless index is present */
+	void set_tag(uint64_t index, int tag) {
+		Node *path[MAX_HEIGHT];
+		int i;
+
+		assert(tag >= 0 && tag < NTAGS);
+		if (!lookup_path(index, path))
+			return;
+		for (i = 0; i < ra_height; i++)
+			path[i]->tags[tag] |=
+			    bit(offset(index, (ra_height - 1 - i) * BITS));
+	}
+
+	void clear_tag(uint64_t index, int tag) {
+		Node *path[MAX_HEIGHT];
+		int i;
+
+		assert(tag >= 0 && tag < NTAGS);
+		if (!lookup_path(index, path))
+			return;
+		for (i = ra_height - 1; i >= 0; i--) {
+			path[i]->tags[tag] &=
+			    ~bit(offset(index, (ra_height - 1 - i) * BITS));
+			if (path[i]->tags[tag] != 0)
+				break;
+		}
+	}
+
+	bool get_tag(uint64_t index, int tag) const {
+		Node *path[MAX_HEIGHT];
+
+		assert(tag >= 0 && tag < NTAGS);
+		if (!lookup_path(index, path))
+			return false;
+		return (path[ra_height - 1]->tags[tag] &
+		    bit(offset(index, 0))) != 0;
+	}
+
+	/* Ordered iteration, index() is the index of the last object */
+	struct Iterator : impl::NonCopyable {
+		ObjectType *init(const RadixArray *ra, uint64_t start = 0) {
+			it_ra = ra;
+			it_next = start;
+			it_done = false;
+			return next();
+		}
+
+		ObjectType *next() {
+			ObjectType *obj;
+
+			if (it_done)
+				return NULL;
+			it_index = it_next;
+			obj = it_ra->find_next_present(&it_index);
+			if (obj == NULL || it_index == UINT64_MAX)
+				it_done = true;
+			else
+				it_next = it_index + 1;
+			return obj;
+		}
+
+		uint64_t index() const {
+			return it_index;
+		}
+
+	private:
+		const RadixArray *it_ra;
+		uint64_t it_next;
+		uint64_t it_index;
+		bool it_done;
+	};
+
+protected:
+	enum { BITS = 6 };
+	enum { FANOUT = 1 << BITS };
+	enum { MAX_HEIGHT = (64 + BITS - 1) / BITS };
+
+	struct Node {
+		uint64_t present;
+		uint64_t tags[NTAGS];
+		void *slots[FANOUT];
+	};
+
+	static uint64_t bit(int off) {
+		return (uint64_t)1 << off;
+	}
+
+	static int offset(uint64_t index, int shift) {
+		return (index >> shift) & (FANOUT - 1);
+	}
+
+	int top_shift() const {
+		return (ra_height - 1) * BITS;
+	}
+
+	bool covers(uint64_t index) const {
+		if (ra_height == 0)
+			return false;
+		if (ra_height * BITS >= 64)
+			return true;
+		return (index >> (ra_height * BITS)) == 0;
+	}
+
+	/* Fills path[0 .. height - 1], false unless index is present */
+	bool lookup_path(uint64_t index, Node **path) const {
+		Node *node = ra_root;
+		int i;
+
+		if (!covers(index))
+			return false;
+		for (i = 0; i < ra_height - 1; i++) {
+			path[i] = node;
+			node = (Node *)node->slots[
+			    offset(index, (ra_height - 1 - i) * BITS)];
+			if (node == NULL)
+				return false;
+		}
+		path[i] = node;
+		return (node->present & bit(offset(index, 0))) != 0;
+	}
+
+	void grow() {
+		Node *node;
+		int t;
+
+		node = new Node();
+		node->slots[0] = ra_root;
+		node->present = ra_root->present != 0;
+		for (t = 0; t < NTAGS; t++)
+			node->tags[t] = ra_root->tags[t] != 0;
+		ra_root = node;
+		ra_height++;
+	}
+
+	void shrink() {
+		Node *node;
+
+		while (ra_height > 1 && ra_root->present == 1) {
+			node = ra_root;
+			ra_root = (Node *)node->slots[0];
+			ra_height--;
+			delete node;
+		}
+		if (ra_root->present == 0) {
+			delete ra_root;
+			ra_root = NULL;
+			ra_height = 0;
+		}
+	}
+
+	/* tag < 0 searches for present entries */
+	ObjectType *find_next(uint64_t *index, int tag) const {
+		if (!covers(*index))
+			return NULL;
+		return (ObjectType *)find_next_node(ra_root, top_shift(),
+		    index, tag);
+	}
+
+	static void *find_next_node(Node *node, int shift, uint64_t *index,
+	    int tag) {
+		uint64_t bits, base;
+		void *res;
+		int off, i;
+
+		off = offset(*index, shift);
+		bits = tag < 0 ? node->present : node->tags[tag];
+		bits &= ~(uint64_t)0 << off;
+		/* Index bits above this node */
+		base = shift + BITS >= 64 ? 0 :
+		    *index & (~(uint64_t)0 << (shift + BITS));
+		while (bits != 0) {
+			i = __builtin_ctzll(bits);
+			if (i != off)
+				*index = base | ((uint64_t)i << shift);
+			if (shift == 0)
+				return node->slots[i];
+			res = find_next_node((Node *)node->slots[i],
+			    shift - BITS, index, tag);
+			if (res != NULL)
+				return res;
+			bits &= bits - 1;
+		}
+		return NULL;
+	}
+
+	static void destroy_subtree(Node *node, int shift) {
+		uint64_t bits;
+
+		if (shift > 0)
+			for (bits = node->present; bits != 0; bits &= bits - 1)
+				destroy_subtree(
+				    (Node *)node->slots[__builtin_ctzll(bits)],
+				    shift - BITS);
+		delete node;
+	}
+
+private:
+	Node *ra_root;
+	int ra_height;
+	size_t ra_count;
+};
+
+} // namespace ecl
+
+#endif
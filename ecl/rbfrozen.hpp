@@ -0,0 +1,218 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Read-only snapshot of an RBTreeHead stored in Eytzinger (BFS) order.
+ *
+ * Keys are copied out of the objects with EntryType::key_fn() and kept in
+ * a separate cache line aligned array, object pointers are kept in a
+ * parallel array and only touched once the search is complete.  KeyT must
+ * be trivially copyable and its operator< must agree with
+ * EntryType::compare_fn().
+ */
+
+#ifndef ECL_RBFROZEN_HPP
+#define ECL_RBFROZEN_HPP
+
+#include <stdlib.h>
+
+#include "rbtree.hpp"
+
+namespace ecl {
+
+template <typename EntryT, typename KeyT>
+class RBTreeFrozen : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef KeyT KeyType;
+	typedef typename EntryType::ObjectType ObjectType;
+
+	RBTreeFrozen() : rbf_keys(NULL), rbf_objs(NULL), rbf_size(0) { }
+
+	~RBTreeFrozen() {
+		clear();
+	}
+
+	bool empty() const {
+		return (rbf_size == 0);
+	}
+
+	size_t size() const {
+		return rbf_size;
+	}
+
+	void clear() {
+		free(rbf_keys);
+		free(rbf_objs);
+		rbf_keys = NULL;
+		rbf_objs = NULL;
+		rbf_size = 0;
+	}
+
+	/*
+	 * Replaces the snapshot with the contents of head.  Objects are
+	 * referenced, not copied, and must outlive the snapshot.
+	 */
+	void freeze(const RBTreeHead<EntryType> *head) {
+		const ObjectType *obj;
+		size_t n, k;
+
+		clear();
+		for (n = 0, obj = head->first(); obj != NULL;
+		    obj = entry(obj)->next())
+			n++;
+		if (n == 0)
+			return;
+
+		/* Slot 0 holds no key, failed lookups end up there */
+		if (posix_memalign((void **)&rbf_keys, CACHE_LINE,
+		    (n + 1) * sizeof(KeyType)) != 0)
+			abort();
+		if (posix_memalign((void **)&rbf_objs, CACHE_LINE,
+		    (n + 1) * sizeof(ObjectType *)) != 0)
+			abort();
+		rbf_objs[0] = NULL;
+		rbf_size = n;
+
+		for (k = first_index(), obj = head->first(); obj != NULL;
+		    obj = entry(obj)->next(), k = next_index(k)) {
+			rbf_keys[k] = EntryType::key_fn(obj);
+			rbf_objs[k] = const_cast<ObjectType *>(obj);
+		}
+		assert(k == 0);
+	}
+
+	ObjectType *min() const {
+		return empty() ? NULL : rbf_objs[first_index()];
+	}
+
+	ObjectType *max() const {
+		return empty() ? NULL : rbf_objs[last_index()];
+	}
+
+	ObjectType *find(const KeyType &key) const {
+		size_t k;
+
+		if (empty())
+			return NULL;
+		k = lower_bound(key);
+		if (k == 0 || key < rbf_keys[k])
+			return NULL;
+		return rbf_objs[k];
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	ObjectType *nfind(const KeyType &key) const {
+		if (empty())
+			return NULL;
+		return rbf_objs[lower_bound(key)];
+	}
+
+	/* Finds the last node less than or equal to the search key */
+	ObjectType *pfind(const KeyType &key) const {
+		size_t k = 1;
+
+		if (empty())
+			return NULL;
+		while (k <= rbf_size) {
+			prefetch(k);
+			k = 2 * k + !(key < rbf_keys[k]);
+		}
+		/* Drop trailing left turns and the last right turn */
+		k >>= ffs_word(k);
+		return rbf_objs[k];
+	}
+
+protected:
+	enum { CACHE_LINE = 64 };
+
+	/* Descend to the ancestor 4 levels down; 16 keys share a line */
+	enum { PREFETCH_STRIDE = CACHE_LINE / sizeof(KeyType) > 16 ?
+	    16 : CACHE_LINE / sizeof(KeyType) };
+
+	static const EntryType *entry(const ObjectType *obj) {
+		return obj;
+	}
+
+	static int ffs_word(size_t k) {
+		return __builtin_ffsl((long)k);
+	}
+
+	void prefetch(size_t k) const {
+		__builtin_prefetch(rbf_keys + PREFETCH_STRIDE * k);
+	}
+
+	size_t lower_bound(const KeyType &key) const {
+		size_t k = 1;
+
+		while (k <= rbf_size) {
+			prefetch(k);
+			k = 2 * k + (rbf_keys[k] < key);
+		}
+		/* Drop trailing right turns and the last left turn */
+		k >>= ffs_word(~k);
+		return k;
+	}
+
+	size_t first_index() const {
+		size_t k = 1;
+
+		while (2 * k <= rbf_size)
+			k = 2 * k;
+		return k;
+	}
+
+	size_t last_index() const {
+		size_t k = 1;
+
+		while (2 * k + 1 <= rbf_size)
+			k = 2 * k + 1;
+		return k;
+	}
+
+	/* In-order successor in the implicit tree, 0 past the end */
+	size_t next_index(size_t k) const {
+		if (2 * k + 1 <= rbf_size) {
+			k = 2 * k + 1;
+			while (2 * k <= rbf_size)
+				k = 2 * k;
+		} else {
+			while (k & 1)
+				k >>= 1;
+			k >>= 1;
+		}
+		return k;
+	}
+
+private:
+	KeyType *rbf_keys;
+	ObjectType **rbf_objs;
+	size_t rbf_size;
+};
+
+} // namespace ecl
+
+#endif
@@ -0,0 +1,235 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Parallel traversal of an RBTreeHead.
+ *
+ * The tree is cut into subtrees by repeatedly splitting the heaviest one
+ * until there are enough pieces to keep every thread busy.  Subtree weight
+ * is estimated from its black height.  Each worker walks its subtrees in
+ * order with RBTreeEntry::next(), nodes cut off above the subtrees are
+ * visited by the calling thread.  The tree must not be modified during
+ * the traversal, fn is called concurrently and must be thread safe.
+ */
+
+#ifndef ECL_RBPARALLEL_HPP
+#define ECL_RBPARALLEL_HPP
+
+#include <pthread.h>
+
+#include "rbtree.hpp"
+
+namespace ecl {
+
+namespace impl {
+
+template <typename EntryT, typename Fn>
+class RBParallel : NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+
+	/* Subtrees handed out per thread */
+	enum { SPLIT_FACTOR = 4 };
+
+	RBParallel(ObjectType *root, Fn &fn, int nthreads) :
+	    rp_fn(fn), rp_nthreads(nthreads), rp_nparts(0), rp_nsingles(0) {
+		rp_maxparts = nthreads * SPLIT_FACTOR;
+		rp_parts = new Part[rp_maxparts];
+		rp_singles = new ObjectType*[rp_maxparts];
+		rp_workers = new Worker[nthreads];
+		add_part(root);
+	}
+
+	~RBParallel() {
+		delete[] rp_workers;
+		delete[] rp_singles;
+		delete[] rp_parts;
+	}
+
+	void run() {
+		pthread_t *tids;
+		int i;
+
+		split();
+		assign();
+
+		tids = new pthread_t[rp_nthreads];
+		for (i = 1; i < rp_nthreads; i++)
+			if (pthread_create(&tids[i], NULL, worker_main,
+			    &rp_workers[i]) != 0)
+				worker_main(&rp_workers[i]);
+			else
+				rp_workers[i].started = true;
+		for (i = 0; i < rp_nsingles; i++)
+			rp_fn(rp_singles[i]);
+		worker_main(&rp_workers[0]);
+		for (i = 1; i < rp_nthreads; i++)
+			if (rp_workers[i].started)
+				pthread_join(tids[i], NULL);
+		delete[] tids;
+	}
+
+protected:
+	struct Part {
+		ObjectType *root;
+		size_t weight;
+		Part *next_part;
+	};
+
+	struct Worker {
+		Worker() : parts(NULL), load(0), started(false) { }
+
+		Fn *fn;
+		Part *parts;
+		size_t load;
+		bool started;
+	};
+
+	static EntryType *entry(ObjectType *obj) {
+		return obj;
+	}
+
+	/* 2^bh is a lower bound on the subtree size */
+	static size_t weight(ObjectType *obj) {
+		int bh = 0;
+
+		for (; obj != NULL; obj = entry(obj)->left())
+			if (entry(obj)->color() == RBColor::BLACK)
+				bh++;
+		return ((size_t)1 << bh);
+	}
+
+	void add_part(ObjectType *root) {
+		Part *p = &rp_parts[rp_nparts++];
+
+		p->root = root;
+		p->weight = weight(root);
+		p->next_part = NULL;
+	}
+
+	void split() {
+		ObjectType *root;
+		int i, heaviest;
+
+		/* Splitting a node with one child doesn't add a part */
+		while (rp_nparts + 1 < rp_maxparts &&
+		    rp_nsingles < rp_maxparts) {
+			for (i = 1, heaviest = 0; i < rp_nparts; i++)
+				if (rp_parts[i].weight > rp_parts[heaviest].weight)
+					heaviest = i;
+			root = rp_parts[heaviest].root;
+			if (entry(root)->left() == NULL &&
+			    entry(root)->right() == NULL)
+				break;
+			rp_singles[rp_nsingles++] = root;
+			rp_parts[heaviest] = rp_parts[--rp_nparts];
+			if (entry(root)->left() != NULL)
+				add_part(entry(root)->left());
+			if (entry(root)->right() != NULL)
+				add_part(entry(root)->right());
+		}
+	}
+
+	/* Longest processing time first */
+	void assign() {
+		Part tmp;
+		int i, j, w;
+
+		for (i = 1; i < rp_nparts; i++) {
+			tmp = rp_parts[i];
+			for (j = i; j > 0 && rp_parts[j - 1].weight < tmp.weight; j--)
+				rp_parts[j] = rp_parts[j - 1];
+			rp_parts[j] = tmp;
+		}
+		for (i = 0; i < rp_nparts; i++) {
+			for (j = 1, w = 0; j < rp_nthreads; j++)
+				if (rp_workers[j].load < rp_workers[w].load)
+					w = j;
+			rp_parts[i].next_part = rp_workers[w].parts;
+			rp_workers[w].parts = &rp_parts[i];
+			rp_workers[w].load += rp_parts[i].weight;
+		}
+		for (i = 0; i < rp_nthreads; i++)
+			rp_workers[i].fn = &rp_fn;
+	}
+
+	static void *worker_main(void *arg) {
+		Worker *w = (Worker *)arg;
+		ObjectType *obj, *next, *last;
+		Part *p;
+
+		for (p = w->parts; p != NULL; p = p->next_part) {
+			for (last = p->root; entry(last)->right() != NULL;)
+				last = entry(last)->right();
+			for (obj = p->root; entry(obj)->left() != NULL;)
+				obj = entry(obj)->left();
+			for (;;) {
+				next = obj != last ? entry(obj)->next() : NULL;
+				(*w->fn)(obj);
+				if (next == NULL)
+					break;
+				obj = next;
+			}
+		}
+		return NULL;
+	}
+
+private:
+	Fn &rp_fn;
+	Part *rp_parts;
+	ObjectType **rp_singles;
+	Worker *rp_workers;
+	int rp_nthreads;
+	int rp_maxparts;
+	int rp_nparts;
+	int rp_nsingles;
+};
+
+} // namespace impl
+
+template <typename EntryT, typename Fn>
+void parallel_for_each(RBTreeHead<EntryT> *head, Fn &fn, int nthreads)
+{
+	typedef typename EntryT::ObjectType ObjectType;
+	ObjectType *obj, *next;
+
+	if (head->empty())
+		return;
+	if (nthreads <= 1) {
+		for (obj = head->first(); obj != NULL; obj = next) {
+			next = static_cast<EntryT *>(obj)->next();
+			fn(obj);
+		}
+		return;
+	}
+	impl::RBParallel<EntryT, Fn> p(head->root(), fn, nthreads);
+	p.run();
+}
+
+} // namespace ecl
+
+#endif
@@ -0,0 +1,185 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * RBTreeHead with optimistic lock-free lookups.
+ *
+ * Writers must be serialized by the caller; every insert() and remove()
+ * is bracketed by an increment of a sequence counter.  Readers walk the
+ * tree without taking any lock and retry if the counter was odd or has
+ * changed by the end of the walk.  Since a reader may still be looking at
+ * an object after it was removed, objects must not be freed or have their
+ * keys changed until all concurrent readers are done with them.
+ */
+
+#ifndef ECL_RBSEQ_HPP
+#define ECL_RBSEQ_HPP
+
+#include "rbtree.hpp"
+
+namespace ecl {
+
+template <typename EntryT>
+class RBTreeSeqHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+	typedef RBTreeHead<EntryType> HeadType;
+
+	RBTreeSeqHead() : rbs_seq(0) { }
+
+	bool empty() const {
+		return (load(&rbs_head.rbh_root) == NULL);
+	}
+
+	/* Writer side view, only valid with writers excluded */
+	const HeadType *head() const {
+		return &rbs_head;
+	}
+
+	template<typename KeyType>
+	ObjectType *find(const KeyType &key) const {
+		return lookup(key, FIND);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *nfind(const KeyType &key) const {
+		return lookup(key, NFIND);
+	}
+
+	/* Finds the last node less than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *pfind(const KeyType &key) const {
+		return lookup(key, PFIND);
+	}
+
+	ObjectType *insert(ObjectType *obj) {
+		ObjectType *res;
+
+		write_begin();
+		res = rbs_head.insert(obj);
+		write_end();
+		return res;
+	}
+
+	ObjectType *remove(ObjectType *obj) {
+		ObjectType *res;
+
+		write_begin();
+		res = rbs_head.remove(obj);
+		write_end();
+		return res;
+	}
+
+protected:
+	enum Mode { FIND, NFIND, PFIND };
+
+	/* Height of an RB tree never exceeds 2 * log2(n + 1) */
+	enum { MAX_DEPTH = 2 * 8 * sizeof(void *) };
+
+	static EntryType *entry(ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	static ObjectType *load(ObjectType * const *p) {
+		return __atomic_load_n(p, __ATOMIC_RELAXED);
+	}
+
+	unsigned int read_begin() const {
+		unsigned int seq;
+
+		while ((seq = __atomic_load_n(&rbs_seq, __ATOMIC_ACQUIRE)) & 1)
+			impl::cpu_spinwait();
+		return seq;
+	}
+
+	bool read_retry(unsigned int seq) const {
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		return (__atomic_load_n(&rbs_seq, __ATOMIC_RELAXED) != seq);
+	}
+
+	void write_begin() {
+		__atomic_store_n(&rbs_seq, rbs_seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+
+	void write_end() {
+		__atomic_store_n(&rbs_seq, rbs_seq + 1, __ATOMIC_RELEASE);
+	}
+
+	/*
+	 * Same walk as RBTreeHead::find_impl() and friends.  Rotations in
+	 * progress may briefly send the walk around in a loop, so give up
+	 * once the depth can't be valid and let the caller retry.
+	 */
+	template<typename KeyType>
+	bool walk(const KeyType &key, Mode mode, ObjectType **resp) const {
+		ObjectType *tmp = load(&rbs_head.rbh_root);
+		ObjectType *res = NULL;
+		int comp, depth;
+
+		for (depth = 0; tmp != NULL; depth++) {
+			if (depth > MAX_DEPTH)
+				return false;
+			comp = EntryType::compare_key(key, tmp);
+			if (comp < 0) {
+				if (mode == NFIND)
+					res = tmp;
+				tmp = load(&entry(tmp)->rbe_left);
+			} else if (comp > 0) {
+				if (mode == PFIND)
+					res = tmp;
+				tmp = load(&entry(tmp)->rbe_right);
+			} else {
+				res = tmp;
+				break;
+			}
+		}
+		*resp = res;
+		return true;
+	}
+
+	template<typename KeyType>
+	ObjectType *lookup(const KeyType &key, Mode mode) const {
+		ObjectType *res;
+		unsigned int seq;
+
+		for (;;) {
+			seq = read_begin();
+			if (walk(key, mode, &res) && !read_retry(seq))
+				return res;
+		}
+	}
+
+private:
+	unsigned int rbs_seq;
+	HeadType rbs_head;
+};
+
+} // namespace ecl
+
+#endif
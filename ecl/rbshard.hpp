@@ -0,0 +1,358 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Ordered container split into key ranges, each backed by its own
+ * RBTreeHead and mutex, so that writers touching different ranges run in
+ * parallel.
+ *
+ * Shard i holds keys in [lo(i), lo(i + 1)).  Lower bounds of shards i and
+ * i + 1 only move while both shards are locked, a thread picks a shard
+ * without locking and re-checks the range once it holds the shard lock.
+ * KeyT must be an integral type ordered consistently with
+ * EntryType::compare_fn(), keys are extracted with EntryType::key_fn().
+ *
+ * Lookups are only consistent within a shard.  nfind() and pfind() move on
+ * to a neighbouring shard after unlocking the first one and first(),
+ * last() and for_each() lock one shard at a time, so they may miss or
+ * repeat elements moved concurrently between shards.
+ */
+
+#ifndef ECL_RBSHARD_HPP
+#define ECL_RBSHARD_HPP
+
+#include <pthread.h>
+
+#include "rbtree.hpp"
+
+namespace ecl {
+
+template <typename EntryT, typename KeyT>
+class RBTreeShardHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef KeyT KeyType;
+	typedef typename EntryType::ObjectType ObjectType;
+	typedef RBTreeHead<EntryType> HeadType;
+
+	struct Iterator;
+
+	/* bounds[] holds lower bounds of shards 1 .. nshards - 1 */
+	RBTreeShardHead(int nshards, const KeyType *bounds) :
+	    rbs_nshards(nshards) {
+		int i;
+
+		assert(nshards > 0);
+		rbs_shards = new Shard[nshards];
+		for (i = 1; i < nshards; i++) {
+			assert(i == 1 || bounds[i - 2] < bounds[i - 1]);
+			rbs_shards[i].lo = bounds[i - 1];
+		}
+	}
+
+	~RBTreeShardHead() {
+		delete[] rbs_shards;
+	}
+
+	int nshards() const {
+		return rbs_nshards;
+	}
+
+	/* Number of elements in a shard, racy unless writers are excluded */
+	size_t shard_size(int i) const {
+		return __atomic_load_n(&rbs_shards[i].count, __ATOMIC_RELAXED);
+	}
+
+	bool empty() const {
+		int i;
+
+		for (i = 0; i < rbs_nshards; i++)
+			if (shard_size(i) != 0)
+				return false;
+		return true;
+	}
+
+	ObjectType *first() {
+		return first_from(0);
+	}
+
+	ObjectType *last() {
+		return last_from(rbs_nshards - 1);
+	}
+
+	ObjectType *insert(ObjectType *obj) {
+		ObjectType *res;
+		int i;
+
+		i = lock_key(EntryType::key_fn(obj));
+		res = rbs_shards[i].head.insert(obj);
+		if (res == NULL)
+			inc_count(&rbs_shards[i]);
+		unlock(i);
+		return res;
+	}
+
+	ObjectType *remove(ObjectType *obj) {
+		int i;
+
+		i = lock_key(EntryType::key_fn(obj));
+		rbs_shards[i].head.remove(obj);
+		dec_count(&rbs_shards[i]);
+		unlock(i);
+		return obj;
+	}
+
+	ObjectType *find(const KeyType &key) {
+		ObjectType *res;
+		int i;
+
+		i = lock_key(key);
+		res = rbs_shards[i].head.find(key);
+		unlock(i);
+		return res;
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	ObjectType *nfind(const KeyType &key) {
+		ObjectType *res;
+		int i;
+
+		i = lock_key(key);
+		res = rbs_shards[i].head.nfind(key);
+		unlock(i);
+		if (res == NULL && i + 1 < rbs_nshards)
+			res = first_from(i + 1);
+		return res;
+	}
+
+	/* Finds the last node less than or equal to the search key */
+	ObjectType *pfind(const KeyType &key) {
+		ObjectType *res;
+		int i;
+
+		i = lock_key(key);
+		res = rbs_shards[i].head.pfind(key);
+		unlock(i);
+		if (res == NULL && i > 0)
+			res = last_from(i - 1);
+		return res;
+	}
+
+	/*
+	 * Evens out element counts of neighbouring shards by moving up to
+	 * max_moves elements across shard boundaries.  Returns number of
+	 * elements moved, 0 once shards are balanced.
+	 */
+	int rebalance(int max_moves) {
+		int i, moved = 0;
+
+		for (i = 0; i + 1 < rbs_nshards && moved < max_moves; i++) {
+			lock(i);
+			lock(i + 1);
+			moved += balance_pair(i, max_moves - moved);
+			unlock(i + 1);
+			unlock(i);
+		}
+		return moved;
+	}
+
+	/* Calls fn for every element in order, one shard locked at a time */
+	template<typename Fn>
+	void for_each(Fn &fn) {
+		ObjectType *obj;
+		int i;
+
+		for (i = 0; i < rbs_nshards; i++) {
+			lock(i);
+			for (obj = rbs_shards[i].head.first(); obj != NULL;
+			    obj = next_in_shard(obj))
+				fn(obj);
+			unlock(i);
+		}
+	}
+
+	/*
+	 * Ordered iteration across all shards.  Takes no locks, writers must
+	 * be excluded by the caller.
+	 */
+	struct Iterator : impl::NonCopyable {
+		ObjectType *init(RBTreeShardHead *head) {
+			it_head = head;
+			it_shard = 0;
+			it_next = head->rbs_shards[0].head.first();
+			return next();
+		}
+
+		ObjectType *next() {
+			ObjectType *obj;
+
+			while (it_next == NULL) {
+				if (++it_shard >= it_head->rbs_nshards)
+					return NULL;
+				it_next = it_head->rbs_shards[it_shard].head.first();
+			}
+			obj = it_next;
+			it_next = next_in_shard(obj);
+			return obj;
+		}
+
+	private:
+		RBTreeShardHead *it_head;
+		ObjectType *it_next;
+		int it_shard;
+	};
+
+protected:
+	enum { CACHE_LINE = 64 };
+
+	struct Shard {
+		Shard() : count(0) {
+			pthread_mutex_init(&lock, NULL);
+		}
+
+		~Shard() {
+			pthread_mutex_destroy(&lock);
+		}
+
+		pthread_mutex_t lock;
+		KeyType lo;
+		size_t count;
+		HeadType head;
+	} __attribute__((aligned(CACHE_LINE)));
+
+	static ObjectType *next_in_shard(ObjectType *obj) {
+		return static_cast<EntryType *>(obj)->next();
+	}
+
+	KeyType lo(int i) const {
+		return __atomic_load_n(&rbs_shards[i].lo, __ATOMIC_RELAXED);
+	}
+
+	void lock(int i) {
+		pthread_mutex_lock(&rbs_shards[i].lock);
+	}
+
+	void unlock(int i) {
+		pthread_mutex_unlock(&rbs_shards[i].lock);
+	}
+
+	bool owns(int i, const KeyType &key) const {
+		if (i > 0 && key < rbs_shards[i].lo)
+			return false;
+		if (i + 1 < rbs_nshards && !(key < rbs_shards[i + 1].lo))
+			return false;
+		return true;
+	}
+
+	/* Locks and returns the shard currently owning key */
+	int lock_key(const KeyType &key) {
+		int i, l, r;
+
+		for (;;) {
+			for (l = 0, r = rbs_nshards - 1; l < r;) {
+				i = (l + r + 1) / 2;
+				if (key < lo(i))
+					r = i - 1;
+				else
+					l = i;
+			}
+			lock(l);
+			if (owns(l, key))
+				return l;
+			unlock(l);
+		}
+	}
+
+	ObjectType *first_from(int i) {
+		ObjectType *res = NULL;
+
+		for (; i < rbs_nshards && res == NULL; i++) {
+			lock(i);
+			res = rbs_shards[i].head.first();
+			unlock(i);
+		}
+		return res;
+	}
+
+	ObjectType *last_from(int i) {
+		ObjectType *res = NULL;
+
+		for (; i >= 0 && res == NULL; i--) {
+			lock(i);
+			res = rbs_shards[i].head.last();
+			unlock(i);
+		}
+		return res;
+	}
+
+	void set_lo(int i, const KeyType &key) {
+		__atomic_store_n(&rbs_shards[i].lo, key, __ATOMIC_RELAXED);
+	}
+
+	/* Lock holders update count, readers may load it without the lock */
+	static void inc_count(Shard *s) {
+		__atomic_store_n(&s->count, s->count + 1, __ATOMIC_RELAXED);
+	}
+
+	static void dec_count(Shard *s) {
+		__atomic_store_n(&s->count, s->count - 1, __ATOMIC_RELAXED);
+	}
+
+	/* Both shards must be locked */
+	int balance_pair(int i, int max_moves) {
+		Shard *a = &rbs_shards[i], *b = &rbs_shards[i + 1];
+		ObjectType *obj;
+		int moved;
+
+		for (moved = 0; moved < max_moves; moved++) {
+			if (a->count > b->count + 1) {
+				obj = a->head.last();
+				a->head.remove(obj);
+				dec_count(a);
+				set_lo(i + 1, EntryType::key_fn(obj));
+				b->head.insert(obj);
+				inc_count(b);
+			} else if (b->count > a->count + 1) {
+				obj = b->head.first();
+				b->head.remove(obj);
+				dec_count(b);
+				a->head.insert(obj);
+				inc_count(a);
+				set_lo(i + 1, EntryType::key_fn(b->head.first()));
+			} else
+				break;
+		}
+		return moved;
+	}
+
+private:
+	Shard *rbs_shards;
+	int rbs_nshards;
+};
+
+} // namespace ecl
+
+#endif
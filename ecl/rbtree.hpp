@@ -52,13 +52,18 @@ template<typename EntryT>
 struct RBTreePolicy : policy::RBTree::Default { };
 
 template <typename EntryT>
-class RBTreeHead : impl::NonCopyable {
+class RBTreeSeqHead;
+
+template <typename EntryT>
+class RBTreeHead : impl::NonCopyable,
+    impl::Counter<EntryT::Policy::counting> {
 public:
 	typedef EntryT EntryType;
 	typedef typename EntryType::ObjectType ObjectType;
 	typedef typename EntryType::Policy Policy;
 
 	friend struct policy::RBTree;
+	friend class RBTreeSeqHead<EntryType>;
 
 	RBTreeHead() : rbh_root(NULL) { }
 
@@ -66,6 +71,18 @@ public:
 		return (rbh_root == NULL);
 	}
 
+	/* O(n) unless the policy is counting */
+	size_t size() const {
+		const ObjectType *obj;
+		size_t n = 0;
+
+		if (Policy::counting)
+			return this->count_get();
+		for (obj = min(); obj != NULL; obj = EntryType::entry(obj)->next())
+			n++;
+		return n;
+	}
+
 	ObjectType *root() {
 		return rbh_root;
 	}
@@ -189,6 +206,7 @@ public:
 		} else
 			rbh_root = obj;
 		insert_color(obj);
+		this->count_add(1);
 		return NULL;
 	}
 
@@ -196,6 +214,7 @@ public:
 		ObjectType *child, *parent, *old;
 		int color;
 
+		this->count_sub(1);
 		old = elm;
 		if (entry(elm)->rbe_left == NULL)
 			child = entry(elm)->rbe_right;
@@ -221,6 +240,74 @@ public:
 		return old;
 	}
 
+	/*
+	 * Detaches up to max leaves and passes each to disposer(obj), returns
+	 * true once the tree is empty.  No rebalancing is done, so until then
+	 * the tree may only be searched, not modified.
+	 */
+	template<typename DisposerT>
+	bool clear_some(size_t max, DisposerT &disposer) {
+		ObjectType *obj, *parent;
+
+		for (obj = rbh_root; max > 0 && obj != NULL; max--, obj = parent) {
+			for (;;) {
+				if (entry(obj)->rbe_left != NULL)
+					obj = entry(obj)->rbe_left;
+				else if (entry(obj)->rbe_right != NULL)
+					obj = entry(obj)->rbe_right;
+				else
+					break;
+			}
+			parent = entry(obj)->rbe_parent;
+			if (parent == NULL)
+				rbh_root = NULL;
+			else if (entry(parent)->rbe_left == obj)
+				entry(parent)->rbe_left = NULL;
+			else
+				entry(parent)->rbe_right = NULL;
+			this->count_sub(1);
+			disposer(obj);
+		}
+		return empty();
+	}
+
+	/*
+	 * In order scan of up to max objects starting at *cursor, NULL starts
+	 * at the minimum.  Returns false when the end is reached and resets
+	 * *cursor, otherwise *cursor is the next object to visit.  fn may
+	 * remove the object it's given, *cursor must stay in the tree until
+	 * the next call.
+	 */
+	template<typename FnT>
+	bool scan_some(ObjectType **cursor, size_t max, FnT &fn) {
+		ObjectType *obj, *next;
+
+		obj = *cursor == NULL ? min_impl() : *cursor;
+		for (; max > 0 && obj != NULL; max--, obj = next) {
+			next = entry(obj)->next();
+			fn(obj);
+		}
+		*cursor = obj;
+		return (obj != NULL);
+	}
+
+	/*
+	 * Moves up to max objects, smallest first, from old into this tree,
+	 * e.g. to rebuild an index in steps.  Objects whose key is already
+	 * present are passed to dup(obj).  Returns true once old is empty.
+	 */
+	template<typename DupT>
+	bool rebuild_step(RBTreeHead *old, size_t max, DupT &dup) {
+		ObjectType *obj;
+
+		for (; max > 0 && (obj = old->min_impl()) != NULL; max--) {
+			old->remove(obj);
+			if (insert(obj) != NULL)
+				dup(obj);
+		}
+		return old->empty();
+	}
+
 protected:
 	static int compare(const ObjectType *a, const ObjectType *b) {
 		return EntryType::compare(a, b);
@@ -578,6 +665,7 @@ public:
 	friend class impl::ReverseIterator<EntryType>;
 	friend class impl::ConstReverseIterator<EntryType>;
 	friend struct policy::RBTree;
+	friend class RBTreeSeqHead<EntryType>;
 
 	struct Iterator : impl::Iterator<EntryType> {
 		typedef impl::Iterator<EntryType> Base;
@@ -648,6 +736,10 @@ public:
 		return this->rbe_parent;
 	}
 
+	RBColor::Enum color() const {
+		return this->rbe_color;
+	}
+
 	ObjectType *next() {
 		return next_impl();
 	}
@@ -0,0 +1,393 @@
+/*-
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Lock-free skip list.
+ *
+ * Objects embed a SkipListEntry tower of up to Levels links; the height of
+ * a tower is drawn from EntryType::level(), a hash of the object address by
+ * default.  Removal marks the links of the tower, level 0 last, and any
+ * thread walking past a marked object unlinks it.  Insertion links level 0
+ * first and builds the rest of the tower afterwards.
+ *
+ * All operations may run concurrently and never block each other, except
+ * that remove() waits for a concurrent insert() of the same object to
+ * finish building its tower.  Since readers may still be looking at a
+ * removed object, objects may only be freed or inserted again after a
+ * grace period, e.g. with EpochDomain::Thread::retire().  Iterators are
+ * weakly consistent: they never return an object twice and return objects
+ * in order, but may or may not return objects inserted or removed while
+ * iterating.
+ */
+
+#ifndef ECL_SKIPLIST_HPP
+#define ECL_SKIPLIST_HPP
+
+#include "impl.hpp"
+
+namespace ecl {
+
+template <typename EntryT>
+class SkipListHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+
+	enum { LEVELS = EntryType::LEVELS };
+
+	struct Iterator;
+
+	SkipListHead() : slh_level(1) {
+		int i;
+
+		for (i = 0; i < LEVELS; i++)
+			slh_head[i] = 0;
+	}
+
+	bool empty() const {
+		return (first() == NULL);
+	}
+
+	ObjectType *first() const {
+		return next_of(slh_head);
+	}
+
+	template<typename KeyType>
+	ObjectType *find(const KeyType &key) const {
+		ObjectType *obj = lookup(key);
+
+		if (obj != NULL && EntryType::compare_key_fn(key, obj) != 0)
+			return NULL;
+		return obj;
+	}
+
+	/* Finds the first object greater than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *nfind(const KeyType &key) const {
+		return lookup(key);
+	}
+
+	/* Returns an object with the same key if already present */
+	ObjectType *insert(ObjectType *obj) {
+		uintptr_t *preds[LEVELS];
+		ObjectType *succs[LEVELS];
+		EntryType *ent = entry(obj);
+		ElementCompare cmp(obj);
+		int i, level;
+
+		level = EntryType::level(obj);
+		if (level < 1)
+			level = 1;
+		else if (level > LEVELS)
+			level = LEVELS;
+		raise_level(level);
+		for (;;) {
+			/* obj itself may be the one found */
+			if (search(cmp, preds, succs)) {
+				if (succs[0] != obj)
+					store(&ent->ske_state,
+					    (int)EntryType::IDLE);
+				return succs[0];
+			}
+			ent->ske_level = level;
+			store(&ent->ske_state, (int)EntryType::INSERTING);
+			for (i = 0; i < level; i++)
+				store(&ent->ske_next[i], (uintptr_t)succs[i]);
+			if (cas(&preds[0][0], succs[0], obj))
+				break;
+		}
+		for (i = 1; i < level; i++) {
+			/* Nothing marks the tower until it's complete */
+			while (!cas(&preds[i][i], succs[i], obj)) {
+				search(cmp, preds, succs);
+				store(&ent->ske_next[i], (uintptr_t)succs[i]);
+			}
+		}
+		store(&ent->ske_state, (int)EntryType::LINKED);
+		return NULL;
+	}
+
+	/* Returns NULL unless obj was in the list and this call removed it */
+	ObjectType *remove(ObjectType *obj) {
+		uintptr_t *preds[LEVELS];
+		ObjectType *succs[LEVELS];
+		EntryType *ent = entry(obj);
+		uintptr_t succ;
+		int i, state;
+
+		while ((state = load(&ent->ske_state)) == EntryType::INSERTING)
+			impl::cpu_spinwait();
+		if (state != EntryType::LINKED)
+			return NULL;
+		for (i = ent->ske_level - 1; i > 0; i--) {
+			succ = load(&ent->ske_next[i]);
+			while (!marked(succ) && !mark(&ent->ske_next[i], &succ))
+				;
+		}
+		/* Whoever marks level 0 removes the object */
+		succ = load(&ent->ske_next[0]);
+		do {
+			if (marked(succ))
+				return NULL;
+		} while (!mark(&ent->ske_next[0], &succ));
+		/*
+		 * Unlink the whole tower.  An object with the same key may have
+		 * been linked in front of obj on upper levels, walk past it.
+		 */
+		search(IdentityCompare(obj), preds, succs);
+		return obj;
+	}
+
+	/* Weakly consistent ordered iteration */
+	struct Iterator : impl::NonCopyable {
+		ObjectType *init(const SkipListHead *head) {
+			it_obj = head->first();
+			return it_obj;
+		}
+
+		/* Starts at the first object greater than or equal to key */
+		template<typename KeyType>
+		ObjectType *init(const SkipListHead *head, const KeyType &key) {
+			it_obj = head->nfind(key);
+			return it_obj;
+		}
+
+		ObjectType *next() {
+			if (it_obj != NULL)
+				it_obj = next_of(entry(it_obj)->ske_next);
+			return it_obj;
+		}
+
+	private:
+		ObjectType *it_obj;
+	};
+
+protected:
+	enum { MARK = 1 };
+
+	template<typename KeyType>
+	struct KeyCompare {
+		KeyCompare(const KeyType &key) : key(key) { }
+
+		int operator()(const ObjectType *obj) const {
+			return EntryType::compare_key_fn(key, obj);
+		}
+
+		const KeyType &key;
+	};
+
+	struct ElementCompare {
+		ElementCompare(const ObjectType *elm) : elm(elm) { }
+
+		int operator()(const ObjectType *obj) const {
+			return EntryType::compare_fn(elm, obj);
+		}
+
+		const ObjectType *elm;
+	};
+
+	/* Orders other objects with the same key before elm */
+	struct IdentityCompare {
+		IdentityCompare(const ObjectType *elm) : elm(elm) { }
+
+		int operator()(const ObjectType *obj) const {
+			int r = EntryType::compare_fn(elm, obj);
+
+			return (r != 0 || obj == elm ? r : 1);
+		}
+
+		const ObjectType *elm;
+	};
+
+	static EntryType *entry(ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	static bool marked(uintptr_t link) {
+		return (link & MARK) != 0;
+	}
+
+	static ObjectType *ptr(uintptr_t link) {
+		return (ObjectType *)(link & ~(uintptr_t)MARK);
+	}
+
+	template<typename T>
+	static T load(const T *p) {
+		return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+	}
+
+	template<typename T>
+	static void store(T *p, T val) {
+		__atomic_store_n(p, val, __ATOMIC_RELEASE);
+	}
+
+	static bool cas(uintptr_t *link, ObjectType *old, ObjectType *obj) {
+		uintptr_t expected = (uintptr_t)old;
+
+		return __atomic_compare_exchange_n(link, &expected,
+		    (uintptr_t)obj, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+	}
+
+	/* Updates *succ on failure */
+	static bool mark(uintptr_t *link, uintptr_t *succ) {
+		return __atomic_compare_exchange_n(link, succ, *succ | MARK,
+		    false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	}
+
+	/* First unmarked object after the level 0 link */
+	static ObjectType *next_of(const uintptr_t *links) {
+		ObjectType *obj = ptr(load(&links[0]));
+
+		while (obj != NULL && marked(load(&entry(obj)->ske_next[0])))
+			obj = ptr(load(&entry(obj)->ske_next[0]));
+		return obj;
+	}
+
+	void raise_level(int level) {
+		int cur = load(&slh_level);
+
+		while (cur < level && !__atomic_compare_exchange_n(&slh_level,
+		    &cur, level, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			;
+	}
+
+	/*
+	 * Read only descent, passes over marked objects without unlinking
+	 * them.  Returns the first unmarked object not less than key.
+	 */
+	template<typename KeyType>
+	ObjectType *lookup(const KeyType &key) const {
+		const uintptr_t *pred = slh_head;
+		ObjectType *curr = NULL;
+		uintptr_t succ;
+		int i;
+
+		for (i = load(&slh_level) - 1; i >= 0; i--) {
+			curr = ptr(load(&pred[i]));
+			while (curr != NULL) {
+				succ = load(&entry(curr)->ske_next[i]);
+				if (marked(succ))
+					curr = ptr(succ);
+				else if (EntryType::compare_key_fn(key, curr) > 0) {
+					pred = entry(curr)->ske_next;
+					curr = ptr(succ);
+				} else
+					break;
+			}
+		}
+		return curr;
+	}
+
+	/*
+	 * Fills preds[] with the links to update and succs[] with the first
+	 * objects not less than the search element on every level, unlinking
+	 * marked objects on the way.  Returns true if succs[0] matches.
+	 */
+	template<typename CompareT>
+	bool search(const CompareT &cmp, uintptr_t **preds,
+	    ObjectType **succs) {
+		uintptr_t *pred, succ;
+		ObjectType *curr = NULL;
+		int i, top;
+
+	retry:
+		pred = slh_head;
+		top = load(&slh_level);
+		for (i = LEVELS - 1; i >= top; i--) {
+			preds[i] = slh_head;
+			succs[i] = NULL;
+		}
+		for (; i >= 0; i--) {
+			curr = ptr(load(&pred[i]));
+			while (curr != NULL) {
+				succ = load(&entry(curr)->ske_next[i]);
+				if (marked(succ)) {
+					if (!cas(&pred[i], curr, ptr(succ)))
+						goto retry;
+					curr = ptr(succ);
+				} else if (cmp(curr) > 0) {
+					pred = entry(curr)->ske_next;
+					curr = ptr(succ);
+				} else
+					break;
+			}
+			preds[i] = pred;
+			succs[i] = curr;
+		}
+		return (curr != NULL && cmp(curr) == 0);
+	}
+
+private:
+	uintptr_t slh_head[LEVELS];
+	/* Tallest tower ever inserted, lookups start there */
+	int slh_level;
+};
+
+template <typename EntryT, typename ObjectT, int Levels = 16>
+class SkipListEntry : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef ObjectT ObjectType;
+
+	friend class SkipListHead<EntryType>;
+
+	enum { LEVELS = Levels };
+
+	SkipListEntry() : ske_level(0), ske_state(IDLE) {
+		int i;
+
+		for (i = 0; i < LEVELS; i++)
+			ske_next[i] = 0;
+	}
+
+	/* Tower height, about 1 in 2^i objects have more than i levels */
+	static int level(const ObjectType *obj) {
+		uint64_t x = reinterpret_cast<uintptr_t>(obj);
+
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+		return 1 + __builtin_ctzll(x | (uint64_t)1 << (LEVELS - 1));
+	}
+
+protected:
+	enum State { IDLE, INSERTING, LINKED };
+
+	static EntryType *entry(ObjectType *obj) {
+		return obj;
+	}
+
+private:
+	uintptr_t ske_next[LEVELS];
+	int ske_level;
+	int ske_state;
+};
+
+} // namespace ecl
+
+#endif
@@ -40,7 +40,7 @@ namespace policy { // {{{
 struct SList {
 	struct Default : policy::Generic { };
 
-	struct Debug {
+	struct Debug : policy::Generic {
 		struct RemoveCtx {
 			void **old_next;
 		};
@@ -74,7 +74,8 @@ struct SListPolicy : policy::SList::Debug { };
 // struct SListPolicy : policy::SList::Default { };
 
 template <typename EntryT>
-class SListHead : impl::NonCopyable {
+class SListHead : impl::NonCopyable,
+    impl::Counter<EntryT::Policy::counting> {
 public:
 	typedef EntryT EntryType;
 	typedef typename EntryType::ObjectType ObjectType;
@@ -96,9 +97,28 @@ public:
 		return slh_first;
 	}
 
+	/* O(n) unless the policy is counting */
+	size_t size() const {
+		if (Policy::counting)
+			return this->count_get();
+		return impl::list_count<Link>(slh_first, (ObjectType *)NULL);
+	}
+
 	void insert_head(ObjectType *obj) {
 		entry(obj)->sle_next = slh_first;
 		slh_first = obj;
+		this->count_add(1);
+	}
+
+	/* Same as the SListEntry methods, but also keep the count */
+	void insert_after(ObjectType *listobj, ObjectType *obj) {
+		entry(obj)->insert_after_impl(listobj);
+		this->count_add(1);
+	}
+
+	void remove_after(ObjectType *listobj) {
+		entry(listobj)->remove_after_impl();
+		this->count_sub(1);
 	}
 
 	void remove(ObjectType *listobj) {
@@ -108,7 +128,7 @@ public:
 			ObjectType *curobj = slh_first;
 			while (entry(curobj)->sle_next != listobj)
 				curobj = entry(curobj)->sle_next;
-			entry(curobj)->remove_after();
+			remove_after(curobj);
 		}
 	}
 
@@ -120,12 +140,62 @@ public:
 		Policy::remove_pre(ctx, ent);
 		slh_first = ent->sle_next;
 		Policy::remove_post(ctx, ent);
+		this->count_sub(1);
+	}
+
+	/*
+	 * Single pass removal of the objects matching pred(obj), each is
+	 * passed to disposer(obj) once unlinked.  Returns the number removed.
+	 */
+	template<typename PredT, typename DisposerT>
+	size_t remove_if(PredT pred, DisposerT &disposer) {
+		return remove_matching(pred, disposer, (size_t)-1);
+	}
+
+	/*
+	 * Moves the objects matching pred(obj) in front of the elements of
+	 * other, in order.
+	 */
+	template<typename PredT>
+	size_t partition(PredT pred, SListHead *other) {
+		impl::FrontSink<SListHead> sink(other);
+
+		assert(other != this);
+		return remove_matching(pred, sink, (size_t)-1);
+	}
+
+	/*
+	 * Removes up to max objects matching pred(obj) and stores them in
+	 * out[], the pass stops once max objects are found.
+	 */
+	template<typename PredT>
+	size_t extract_if(PredT pred, ObjectType **out, size_t max) {
+		impl::ExtractSink<ObjectType> sink(out);
+
+		return remove_matching(pred, sink, max);
+	}
+
+	/* Stable merge sort, cmp(a, b) compares objects like compare_fn() */
+	template<typename CompareT>
+	void sort(CompareT cmp) {
+		slh_first = impl::list_sort<Link>(slh_first, cmp);
+	}
+
+	/* Both lists must be sorted, nhead is left empty */
+	template<typename CompareT>
+	void merge(SListHead *nhead, CompareT cmp) {
+		slh_first = impl::list_merge<Link>(slh_first, nhead->slh_first,
+		    cmp);
+		nhead->slh_first = NULL;
+		this->count_add(nhead->count_get());
+		nhead->count_reset();
 	}
 
 	void swap(SListHead *nhead) {
 		ObjectType *swap_first = this->slh_first;
 		this->slh_first = nhead->slh_first;
 		nhead->slh_first = swap_first;
+		this->count_swap(nhead);
 	}
 
 protected:
@@ -133,6 +203,44 @@ protected:
 		return EntryType::entry(obj);
 	}
 
+	struct Link {
+		static ObjectType **next(ObjectType *obj) {
+			return &entry(obj)->sle_next;
+		}
+	};
+
+	/* For containers updating the list head atomically */
+	ObjectType **first_link() {
+		return &slh_first;
+	}
+
+	/* sink(obj) gets each unlinked object */
+	template<typename PredT, typename SinkT>
+	size_t remove_matching(PredT &pred, SinkT &sink, size_t max) {
+		typename Policy::RemoveCtx ctx;
+		ObjectType **prev = &slh_first;
+		ObjectType *obj, *next;
+		size_t n = 0;
+
+		for (obj = slh_first; obj != NULL && n < max; obj = next) {
+			next = entry(obj)->sle_next;
+			if (pred(obj)) {
+				Policy::remove_pre(ctx, entry(obj));
+				Policy::remove_post(ctx, entry(obj));
+				n++;
+				sink(obj);
+				continue;
+			}
+			if (*prev != obj)
+				*prev = obj;
+			prev = &entry(obj)->sle_next;
+		}
+		if (*prev != obj)
+			*prev = obj;
+		this->count_sub(n);
+		return n;
+	}
+
 private:
 	ObjectType *slh_first;
 };
@@ -179,12 +287,24 @@ public:
 		return this->sle_next;
 	}
 
+	/* Counting policies must use the SListHead methods */
 	void insert_after(ObjectType *listobj) {
+		assert(!Policy::counting);
+		insert_after_impl(listobj);
+	}
+
+	void remove_after() {
+		assert(!Policy::counting);
+		remove_after_impl();
+	}
+
+protected:
+	void insert_after_impl(ObjectType *listobj) {
 		this->sle_next = entry(listobj)->sle_next;
 		entry(listobj)->sle_next = object();
 	}
 
-	void remove_after() {
+	void remove_after_impl() {
 		typename Policy::RemoveCtx ctx;
 		EntryType *ent;
 
@@ -194,7 +314,6 @@ public:
 		Policy::remove_post(ctx, ent);
 	}
 
-protected:
 	static EntryType *entry(ObjectType *obj) {
 		return obj;
 	}
@@ -0,0 +1,514 @@
+/*-
+ * Copyright 2002 Niels Provos <provos@citi.umich.edu>
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Derived from sys/tree.h SPLAY_* macros.
+ *
+ * Top-down splay tree.  Recently accessed elements migrate towards the
+ * root which favours skewed access patterns.  Entries have no parent
+ * pointer, successor and predecessor lookups go through the head and
+ * splay the tree.  Lookups may be told to restructure the tree only on
+ * every k-th call, in between they are plain binary search tree lookups
+ * that don't write to the tree.
+ */
+
+#ifndef ECL_SPLAYTREE_HPP
+#define ECL_SPLAYTREE_HPP
+
+#include "impl.hpp"
+
+namespace ecl {
+
+namespace policy { // {{{
+
+struct SplayTree {
+	struct Default : policy::Generic { };
+
+};
+
+} // namespace policy }}}
+
+template<typename EntryT>
+struct SplayTreePolicy : policy::SplayTree::Default { };
+
+template <typename EntryT>
+class SplayTreeHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+	typedef typename EntryType::Policy Policy;
+
+	friend struct policy::SplayTree;
+
+	SplayTreeHead() : sph_root(NULL), sph_period(1), sph_count(0) { }
+
+	bool empty() const {
+		return (sph_root == NULL);
+	}
+
+	ObjectType *root() {
+		return sph_root;
+	}
+
+	const ObjectType *root() const {
+		return sph_root;
+	}
+
+	/* Restructure the tree on every period-th lookup only */
+	void set_splay_period(unsigned int period) {
+		assert(period > 0);
+		sph_period = period;
+		sph_count = 0;
+	}
+
+	ObjectType *first() {
+		return min();
+	}
+
+	const ObjectType *first() const {
+		return min();
+	}
+
+	ObjectType *last() {
+		return max();
+	}
+
+	const ObjectType *last() const {
+		return max();
+	}
+
+	ObjectType *min() {
+		return min_impl(sph_root);
+	}
+
+	const ObjectType *min() const {
+		return min_impl(sph_root);
+	}
+
+	ObjectType *max() {
+		return max_impl(sph_root);
+	}
+
+	const ObjectType *max() const {
+		return max_impl(sph_root);
+	}
+
+	template<typename KeyType>
+	ObjectType *find(const KeyType &key) {
+		KeyCompare<KeyType> cmp(key);
+
+		if (!splay_now())
+			return find_impl(cmp);
+		if (sph_root == NULL)
+			return NULL;
+		splay(cmp);
+		return cmp(sph_root) == 0 ? sph_root : NULL;
+	}
+
+	/* Never splays */
+	template<typename KeyType>
+	const ObjectType *find(const KeyType &key) const {
+		return find_impl(KeyCompare<KeyType>(key));
+	}
+
+	ObjectType *find_element(const ObjectType *elm) {
+		ElementCompare cmp(elm);
+
+		if (!splay_now())
+			return find_impl(cmp);
+		if (sph_root == NULL)
+			return NULL;
+		splay(cmp);
+		return cmp(sph_root) == 0 ? sph_root : NULL;
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *nfind(const KeyType &key) {
+		KeyCompare<KeyType> cmp(key);
+
+		if (!splay_now())
+			return nfind_impl(cmp);
+		if (sph_root == NULL)
+			return NULL;
+		splay(cmp);
+		if (cmp(sph_root) <= 0)
+			return sph_root;
+		return min_impl(entry(sph_root)->spe_right);
+	}
+
+	template<typename KeyType>
+	const ObjectType *nfind(const KeyType &key) const {
+		return nfind_impl(KeyCompare<KeyType>(key));
+	}
+
+	/* Finds the last node less than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *pfind(const KeyType &key) {
+		KeyCompare<KeyType> cmp(key);
+
+		if (!splay_now())
+			return pfind_impl(cmp);
+		if (sph_root == NULL)
+			return NULL;
+		splay(cmp);
+		if (cmp(sph_root) >= 0)
+			return sph_root;
+		return max_impl(entry(sph_root)->spe_left);
+	}
+
+	template<typename KeyType>
+	const ObjectType *pfind(const KeyType &key) const {
+		return pfind_impl(KeyCompare<KeyType>(key));
+	}
+
+	ObjectType *next(ObjectType *elm) {
+		splay(ElementCompare(elm));
+		return min_impl(entry(elm)->spe_right);
+	}
+
+	ObjectType *prev(ObjectType *elm) {
+		splay(ElementCompare(elm));
+		return max_impl(entry(elm)->spe_left);
+	}
+
+	ObjectType *insert(ObjectType *obj) {
+		ElementCompare cmp(obj);
+		int comp;
+
+		if (sph_root == NULL) {
+			entry(obj)->spe_left = entry(obj)->spe_right = NULL;
+		} else {
+			splay(cmp);
+			comp = cmp(sph_root);
+			if (comp < 0) {
+				entry(obj)->spe_left = entry(sph_root)->spe_left;
+				entry(obj)->spe_right = sph_root;
+				entry(sph_root)->spe_left = NULL;
+			} else if (comp > 0) {
+				entry(obj)->spe_right = entry(sph_root)->spe_right;
+				entry(obj)->spe_left = sph_root;
+				entry(sph_root)->spe_right = NULL;
+			} else
+				return sph_root;
+		}
+		sph_root = obj;
+		return NULL;
+	}
+
+	ObjectType *remove(ObjectType *elm) {
+		ElementCompare cmp(elm);
+		ObjectType *tmp;
+
+		if (sph_root == NULL)
+			return NULL;
+		splay(cmp);
+		if (sph_root != elm)
+			return NULL;
+		if (entry(elm)->spe_left == NULL) {
+			sph_root = entry(elm)->spe_right;
+		} else {
+			tmp = entry(elm)->spe_right;
+			sph_root = entry(elm)->spe_left;
+			/* Brings maximum of the left subtree up */
+			splay(cmp);
+			entry(sph_root)->spe_right = tmp;
+		}
+		return elm;
+	}
+
+protected:
+	template<typename KeyType>
+	struct KeyCompare {
+		KeyCompare(const KeyType &k) : key(k) { }
+
+		int operator()(const ObjectType *obj) const {
+			return EntryType::compare_key(key, obj);
+		}
+
+		const KeyType &key;
+	};
+
+	struct ElementCompare {
+		ElementCompare(const ObjectType *e) : elm(e) { }
+
+		int operator()(const ObjectType *obj) const {
+			return EntryType::compare(elm, obj);
+		}
+
+		const ObjectType *elm;
+	};
+
+	static EntryType *entry(ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	bool splay_now() {
+		if (sph_period == 1)
+			return true;
+		if (++sph_count < sph_period)
+			return false;
+		sph_count = 0;
+		return true;
+	}
+
+	static ObjectType *min_impl(ObjectType *tmp) {
+		ObjectType *parent;
+
+		for (parent = NULL; tmp;) {
+			parent = tmp;
+			tmp = entry(tmp)->spe_left;
+		}
+		return parent;
+	}
+
+	static ObjectType *max_impl(ObjectType *tmp) {
+		ObjectType *parent;
+
+		for (parent = NULL; tmp;) {
+			parent = tmp;
+			tmp = entry(tmp)->spe_right;
+		}
+		return parent;
+	}
+
+	template<typename Compare>
+	ObjectType *find_impl(const Compare &cmp) const {
+		ObjectType *tmp = sph_root;
+		int comp;
+
+		while (tmp) {
+			comp = cmp(tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->spe_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->spe_right;
+			else
+				return tmp;
+		}
+		return NULL;
+	}
+
+	template<typename Compare>
+	ObjectType *nfind_impl(const Compare &cmp) const {
+		ObjectType *tmp = sph_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = cmp(tmp);
+			if (comp < 0) {
+				res = tmp;
+				tmp = entry(tmp)->spe_left;
+			} else if (comp > 0)
+				tmp = entry(tmp)->spe_right;
+			else
+				return tmp;
+		}
+		return res;
+	}
+
+	template<typename Compare>
+	ObjectType *pfind_impl(const Compare &cmp) const {
+		ObjectType *tmp = sph_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = cmp(tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->spe_left;
+			else if (comp > 0) {
+				res = tmp;
+				tmp = entry(tmp)->spe_right;
+			} else
+				return tmp;
+		}
+		return res;
+	}
+
+	/*
+	 * Top-down splay, brings the node matching cmp or the last node on
+	 * the search path to the root.  Left and right trees are assembled
+	 * through hooks pointing at the link to be filled in next.
+	 */
+	template<typename Compare>
+	void splay(const Compare &cmp) {
+		ObjectType *ltree = NULL, *rtree = NULL;
+		ObjectType **lhook = &ltree, **rhook = &rtree;
+		ObjectType *tmp, *t = sph_root;
+		int comp;
+
+		while ((comp = cmp(t)) != 0) {
+			if (comp < 0) {
+				tmp = entry(t)->spe_left;
+				if (tmp == NULL)
+					break;
+				if (cmp(tmp) < 0) {
+					/* rotate right */
+					entry(t)->spe_left = entry(tmp)->spe_right;
+					entry(tmp)->spe_right = t;
+					t = tmp;
+					if (entry(t)->spe_left == NULL)
+						break;
+				}
+				/* link right */
+				*rhook = t;
+				rhook = &entry(t)->spe_left;
+				t = entry(t)->spe_left;
+			} else {
+				tmp = entry(t)->spe_right;
+				if (tmp == NULL)
+					break;
+				if (cmp(tmp) > 0) {
+					/* rotate left */
+					entry(t)->spe_right = entry(tmp)->spe_left;
+					entry(tmp)->spe_left = t;
+					t = tmp;
+					if (entry(t)->spe_right == NULL)
+						break;
+				}
+				/* link left */
+				*lhook = t;
+				lhook = &entry(t)->spe_right;
+				t = entry(t)->spe_right;
+			}
+		}
+		/* assemble */
+		*lhook = entry(t)->spe_left;
+		*rhook = entry(t)->spe_right;
+		entry(t)->spe_left = ltree;
+		entry(t)->spe_right = rtree;
+		sph_root = t;
+	}
+
+private:
+	ObjectType *sph_root;
+	unsigned int sph_period;
+	unsigned int sph_count;
+};
+
+template <typename EntryT, typename ObjectT>
+class SplayTreeEntry : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef ObjectT ObjectType;
+	typedef SplayTreePolicy<EntryType> Policy;
+
+	friend class SplayTreeHead<EntryType>;
+	friend struct policy::SplayTree;
+
+	/* Iterators splay every visited element to the root */
+	struct Iterator : impl::NonCopyable {
+		ObjectType *init(SplayTreeHead<EntryType> *head) {
+			it_head = head;
+			return start_at(head->first());
+		}
+
+		ObjectType *start_at(ObjectType *obj) {
+			it_next = obj != NULL ? it_head->next(obj) : NULL;
+			return obj;
+		}
+
+		ObjectType *next() {
+			return start_at(it_next);
+		}
+
+	protected:
+		SplayTreeHead<EntryType> *it_head;
+		ObjectType *it_next;
+	};
+
+	struct ReverseIterator : impl::NonCopyable {
+		ObjectType *init(SplayTreeHead<EntryType> *head) {
+			rit_head = head;
+			return start_at(head->last());
+		}
+
+		ObjectType *start_at(ObjectType *obj) {
+			rit_prev = obj != NULL ? rit_head->prev(obj) : NULL;
+			return obj;
+		}
+
+		ObjectType *prev() {
+			return start_at(rit_prev);
+		}
+
+	protected:
+		SplayTreeHead<EntryType> *rit_head;
+		ObjectType *rit_prev;
+	};
+
+	static int compare(const ObjectType *a, const ObjectType *b) {
+		return EntryType::compare_fn(a, b);
+	}
+
+	template<typename KeyType>
+	static int compare_key(const KeyType &key, const ObjectType *obj) {
+		return EntryType::compare_key_fn(key, obj);
+	}
+
+	SplayTreeEntry() {
+		Policy::create_entry(this);
+	}
+
+	~SplayTreeEntry() {
+		Policy::destroy_entry(this);
+	}
+
+	ObjectType *left() {
+		return this->spe_left;
+	}
+
+	const ObjectType *left() const {
+		return this->spe_left;
+	}
+
+	ObjectType *right() {
+		return this->spe_right;
+	}
+
+	const ObjectType *right() const {
+		return this->spe_right;
+	}
+
+protected:
+	static EntryType *entry(ObjectType *obj) {
+		return obj;
+	}
+
+	static const EntryType *entry(const ObjectType *obj) {
+		return obj;
+	}
+
+	ObjectType *spe_left;
+	ObjectType *spe_right;
+};
+
+} // namespace ecl
+
+#endif
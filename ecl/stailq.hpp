@@ -40,7 +40,7 @@ namespace policy { // {{{
 struct STailq {
 	struct Default : policy::Generic { };
 
-	struct Debug {
+	struct Debug : policy::Generic {
 		struct RemoveCtx {
 			void **old_next;
 		};
@@ -74,7 +74,8 @@ struct STailqPolicy : policy::STailq::Debug { };
 // struct STailqPolicy : policy::STailq::Default { };
 
 template <typename EntryT>
-class STailqHead : impl::NonCopyable {
+class STailqHead : impl::NonCopyable,
+    impl::Counter<EntryT::Policy::counting> {
 public:
 	typedef EntryT EntryType;
 	typedef typename EntryType::ObjectType ObjectType;
@@ -106,6 +107,13 @@ public:
 		return stqh_last;
 	}
 
+	/* O(n) unless the policy is counting */
+	size_t size() const {
+		if (Policy::counting)
+			return this->count_get();
+		return impl::list_count<Link>(stqh_first, (ObjectType *)NULL);
+	}
+
 	void concat(STailqHead *nhead) {
 		if (!nhead->empty()) {
 			if (this->stqh_last != NULL)
@@ -115,6 +123,8 @@ public:
 				this->stqh_first = nhead->stqh_first;
 			this->stqh_last = nhead->stqh_last;
 			nhead->init();
+			this->count_add(nhead->count_get());
+			nhead->count_reset();
 		}
 	}
 
@@ -122,19 +132,44 @@ public:
 		if ((entry(obj)->stqe_next = entry(listobj)->stqe_next) == NULL)
 			stqh_last = obj;
 		entry(listobj)->stqe_next = obj;
+		this->count_add(1);
 	}
 
 	void insert_head(ObjectType *obj) {
 		if ((entry(obj)->stqe_next = stqh_first) == NULL)
 			stqh_last = obj;
 		stqh_first = obj;
+		this->count_add(1);
 	}
 
 	void insert_tail(ObjectType *obj) {
 		entry(obj)->stqe_next = NULL;
 		if (stqh_last != NULL)
 			entry(stqh_last)->stqe_next = obj;
+		else
+			stqh_first = obj;
 		stqh_last = obj;
+		this->count_add(1);
+	}
+
+	/*
+	 * Insert objs[0 .. n - 1] in array order.  The chain is linked
+	 * first and published with a single update of the head.
+	 */
+	void insert_head_batch(ObjectType **objs, size_t n) {
+		if (n == 0)
+			return;
+		link_batch(objs, n);
+		link_range(NULL, objs[0], objs[n - 1]);
+		this->count_add(n);
+	}
+
+	void insert_tail_batch(ObjectType **objs, size_t n) {
+		if (n == 0)
+			return;
+		link_batch(objs, n);
+		link_range(stqh_last, objs[0], objs[n - 1]);
+		this->count_add(n);
 	}
 
 	void remove(ObjectType *listobj) {
@@ -158,6 +193,7 @@ public:
 		if (ent->stqe_next == NULL)
 			stqh_last = listobj;
 		Policy::remove_post(ctx, ent);
+		this->count_sub(1);
 	}
 
 	void remove_head() {
@@ -170,6 +206,98 @@ public:
 		if (stqh_first == NULL)
 			stqh_last = NULL;
 		Policy::remove_post(ctx, ent);
+		this->count_sub(1);
+	}
+
+	/*
+	 * Moves [first, last] of nhead after pos, or to the head if pos is
+	 * NULL.  nhead may be this queue if pos is not in the range.  Finding
+	 * the element preceding first takes O(n).
+	 */
+	void splice_after(ObjectType *pos, STailqHead *nhead, ObjectType *first,
+	    ObjectType *last) {
+		splice_after(pos, nhead, nhead->prev_of(first), first, last);
+	}
+
+	void splice_tail(STailqHead *nhead, ObjectType *first,
+	    ObjectType *last) {
+		splice_tail(nhead, nhead->prev_of(first), first, last);
+	}
+
+	/*
+	 * The same in O(1), prev is the element of nhead preceding first or
+	 * NULL if first is the head of nhead.  Counting policies walk the
+	 * range.
+	 */
+	void splice_after(ObjectType *pos, STailqHead *nhead, ObjectType *prev,
+	    ObjectType *first, ObjectType *last) {
+		move_count(nhead, first, last);
+		nhead->unlink_range(prev, first, last);
+		link_range(pos, first, last);
+	}
+
+	void splice_tail(STailqHead *nhead, ObjectType *prev, ObjectType *first,
+	    ObjectType *last) {
+		move_count(nhead, first, last);
+		nhead->unlink_range(prev, first, last);
+		link_range(stqh_last, first, last);
+	}
+
+	/*
+	 * Single pass removal of the objects matching pred(obj), each is
+	 * passed to disposer(obj) once unlinked.  Returns the number removed.
+	 */
+	template<typename PredT, typename DisposerT>
+	size_t remove_if(PredT pred, DisposerT &disposer) {
+		return remove_matching(pred, disposer, (size_t)-1);
+	}
+
+	/* Moves the objects matching pred(obj) to the tail of other in order */
+	template<typename PredT>
+	size_t partition(PredT pred, STailqHead *other) {
+		impl::TailSink<STailqHead> sink(other);
+
+		assert(other != this);
+		return remove_matching(pred, sink, (size_t)-1);
+	}
+
+	/*
+	 * Removes up to max objects matching pred(obj) and stores them in
+	 * out[], the pass stops once max objects are found.
+	 */
+	template<typename PredT>
+	size_t extract_if(PredT pred, ObjectType **out, size_t max) {
+		impl::ExtractSink<ObjectType> sink(out);
+
+		return remove_matching(pred, sink, max);
+	}
+
+	/* Stable merge sort, cmp(a, b) compares objects like compare_fn() */
+	template<typename CompareT>
+	void sort(CompareT cmp) {
+		stqh_first = impl::list_sort<Link>(stqh_first, cmp);
+		relink();
+	}
+
+	/* Both lists must be sorted, nhead is left empty */
+	template<typename CompareT>
+	void merge(STailqHead *nhead, CompareT cmp) {
+		stqh_first = impl::list_merge<Link>(stqh_first,
+		    nhead->stqh_first, cmp);
+		nhead->init();
+		this->count_add(nhead->count_get());
+		nhead->count_reset();
+		relink();
+	}
+
+	/*
+	 * Stable LSD radix sort by key_fn(obj), an unsigned integer of up
+	 * to 64 bits.
+	 */
+	template<typename KeyFnT>
+	void radix_sort(KeyFnT key_fn) {
+		stqh_first = impl::list_radix_sort<Link>(stqh_first, key_fn,
+		    &stqh_last);
 	}
 
 	void swap(STailqHead *nhead) {
@@ -184,6 +312,7 @@ public:
 			this->stqh_last = NULL;
 		if (nhead->empty())
 			nhead->stqh_last = NULL;
+		this->count_swap(nhead);
 	}
 
 protected:
@@ -196,6 +325,102 @@ protected:
 		return EntryType::entry(obj);
 	}
 
+	struct Link {
+		static ObjectType **next(ObjectType *obj) {
+			return &entry(obj)->stqe_next;
+		}
+	};
+
+	ObjectType *prev_of(ObjectType *obj) {
+		ObjectType *prev;
+
+		if (stqh_first == obj)
+			return NULL;
+		for (prev = stqh_first; entry(prev)->stqe_next != obj;
+		    prev = entry(prev)->stqe_next)
+			;
+		return prev;
+	}
+
+	void move_count(STailqHead *nhead, ObjectType *first,
+	    ObjectType *last) {
+		size_t n;
+
+		if (Policy::counting) {
+			n = impl::list_count<Link>(first, last);
+			nhead->count_sub(n);
+			this->count_add(n);
+		}
+	}
+
+	void unlink_range(ObjectType *prev, ObjectType *first,
+	    ObjectType *last) {
+		ObjectType **link;
+
+		link = prev == NULL ? &stqh_first : &entry(prev)->stqe_next;
+		assert(*link == first);
+		*link = entry(last)->stqe_next;
+		if (stqh_last == last)
+			stqh_last = prev;
+	}
+
+	/* Links the chain [first, last] after pos or at the head */
+	void link_range(ObjectType *pos, ObjectType *first, ObjectType *last) {
+		ObjectType **link;
+
+		link = pos == NULL ? &stqh_first : &entry(pos)->stqe_next;
+		if ((entry(last)->stqe_next = *link) == NULL)
+			stqh_last = last;
+		*link = first;
+	}
+
+	/* Links objs[] into a chain, the ends are left for link_range() */
+	static void link_batch(ObjectType **objs, size_t n) {
+		size_t i;
+
+		for (i = 1; i < n; i++)
+			entry(objs[i - 1])->stqe_next = objs[i];
+	}
+
+	/* The tail is set once, sink(obj) gets each unlinked object */
+	template<typename PredT, typename SinkT>
+	size_t remove_matching(PredT &pred, SinkT &sink, size_t max) {
+		typename Policy::RemoveCtx ctx;
+		ObjectType **prev = &stqh_first;
+		ObjectType *obj, *next, *last = NULL;
+		size_t n = 0;
+
+		for (obj = stqh_first; obj != NULL && n < max; obj = next) {
+			next = entry(obj)->stqe_next;
+			if (pred(obj)) {
+				Policy::remove_pre(ctx, entry(obj));
+				Policy::remove_post(ctx, entry(obj));
+				n++;
+				sink(obj);
+				continue;
+			}
+			if (*prev != obj)
+				*prev = obj;
+			prev = &entry(obj)->stqe_next;
+			last = obj;
+		}
+		if (*prev != obj)
+			*prev = obj;
+		if (obj == NULL)
+			stqh_last = last;
+		this->count_sub(n);
+		return n;
+	}
+
+	/* Finds the new tail after the chain was rearranged */
+	void relink() {
+		ObjectType *obj;
+
+		stqh_last = NULL;
+		for (obj = stqh_first; obj != NULL; obj = entry(obj)->stqe_next)
+			stqh_last = obj;
+	}
+
 private:
 	ObjectType *stqh_first;
 	ObjectType *stqh_last;
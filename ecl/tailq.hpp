@@ -40,7 +40,7 @@ namespace policy { // {{{
 struct Tailq {
 	struct Default : Generic { };
 
-	struct Debug {
+	struct Debug : Generic {
 		struct RemoveCtx {
 			void **old_next;
 			void **old_prev;
@@ -105,7 +105,8 @@ struct TailqPolicy : policy::Tailq::Debug { };
 // struct TailqPolicy : policy::Tailq::Default { };
 
 template <typename EntryT>
-class TailqHead : impl::NonCopyable {
+class TailqHead : impl::NonCopyable,
+    impl::Counter<EntryT::Policy::counting> {
 public:
 	typedef EntryT EntryType;
 	typedef typename EntryType::ObjectType ObjectType;
@@ -137,12 +138,21 @@ public:
 		return tqh.prevent->prevent->next;
 	}
 
+	/* O(n) unless the policy is counting */
+	size_t size() const {
+		if (Policy::counting)
+			return this->count_get();
+		return impl::list_count<Link>(tqh.next, (ObjectType *)NULL);
+	}
+
 	void concat(TailqHead *nhead) {
 		if (!nhead->empty()) {
 			this->tqh.prevent->next = nhead->tqh.next;
 			entry(nhead->tqh.next)->tqe.prevent = this->tqh.prevent;
 			this->tqh.prevent = nhead->tqh.prevent;
 			nhead->init();
+			this->count_add(nhead->count_get());
+			nhead->count_reset();
 		}
 	}
 
@@ -157,6 +167,7 @@ public:
 		}
 		entry(listobj)->tqe.next = obj;
 		entry(obj)->tqe.prevent = &entry(listobj)->tqe;
+		this->count_add(1);
 	}
 
 	void insert_before(ObjectType *listobj, ObjectType *obj) {
@@ -166,6 +177,7 @@ public:
 		entry(obj)->tqe.next = listobj;
 		entry(listobj)->tqe.prevent->next = obj;
 		entry(listobj)->tqe.prevent = &entry(obj)->tqe;
+		this->count_add(1);
 	}
 
 	void insert_head(ObjectType *obj) {
@@ -178,6 +190,7 @@ public:
 			tqh.prevent = &entry(obj)->tqe;
 		tqh.next = obj;
 		entry(obj)->tqe.prevent = &tqh;
+		this->count_add(1);
 	}
 
 	void insert_tail(ObjectType *obj) {
@@ -187,6 +200,29 @@ public:
 		entry(obj)->tqe.prevent = tqh.prevent;
 		tqh.prevent->next = obj;
 		tqh.prevent = &entry(obj)->tqe;
+		this->count_add(1);
+	}
+
+	/*
+	 * Insert objs[0 .. n - 1] in array order.  The chain is linked
+	 * first and published with a single update of the head.
+	 */
+	void insert_head_batch(ObjectType **objs, size_t n) {
+		if (n == 0)
+			return;
+		Policy::check_head(this);
+		link_batch(objs, n);
+		link_range(&tqh, objs[0], objs[n - 1]);
+		this->count_add(n);
+	}
+
+	void insert_tail_batch(ObjectType **objs, size_t n) {
+		if (n == 0)
+			return;
+		Policy::check_tail(this);
+		link_batch(objs, n);
+		link_range(tqh.prevent, objs[0], objs[n - 1]);
+		this->count_add(n);
 	}
 
 	void remove(ObjectType *obj) {
@@ -204,6 +240,120 @@ public:
 		entry(obj)->tqe.prevent->next = entry(obj)->tqe.next;
 
 		Policy::remove_post(ctx, entry(obj));
+		this->count_sub(1);
+	}
+
+	/*
+	 * Moves [first, last] of nhead after pos, or to the head if pos is
+	 * NULL.  nhead may be this queue if pos is not in the range.
+	 * Counting policies walk the range.
+	 */
+	void splice_after(ObjectType *pos, TailqHead *nhead, ObjectType *first,
+	    ObjectType *last) {
+		move_count(nhead, first, last);
+		nhead->unlink_range(first, last);
+		link_range(pos == NULL ? &tqh : &entry(pos)->tqe, first, last);
+	}
+
+	void splice_tail(TailqHead *nhead, ObjectType *first,
+	    ObjectType *last) {
+		move_count(nhead, first, last);
+		nhead->unlink_range(first, last);
+		link_range(tqh.prevent, first, last);
+	}
+
+	/*
+	 * Removes up to max objects from the head and passes each to
+	 * disposer(obj), returns true once only parked markers are left.
+	 */
+	template<typename DisposerT>
+	bool clear_some(size_t max, DisposerT &disposer) {
+		ObjectType *obj;
+
+		for (; max > 0 && (obj = skip_markers(tqh.next)) != NULL;
+		    max--) {
+			remove(obj);
+			disposer(obj);
+		}
+		return (skip_markers(tqh.next) == NULL);
+	}
+
+	/*
+	 * Calls fn(obj) for up to max objects starting at *cursor, NULL
+	 * starts at the head.  Returns false when the end is reached and
+	 * resets *cursor, otherwise *cursor is the next object to visit.
+	 * fn may remove the object it's given, *cursor must stay linked
+	 * until the next call; MarkerIterator allows any change in between.
+	 */
+	template<typename FnT>
+	bool scan_some(ObjectType **cursor, size_t max, FnT &fn) {
+		ObjectType *obj, *next;
+
+		obj = skip_markers(*cursor == NULL ? tqh.next : *cursor);
+		for (; max > 0 && obj != NULL; max--, obj = next) {
+			next = skip_markers(entry(obj)->tqe.next);
+			fn(obj);
+		}
+		*cursor = obj;
+		return (obj != NULL);
+	}
+
+	/*
+	 * Single pass removal of the objects matching pred(obj), each is
+	 * passed to disposer(obj) once unlinked.  Returns the number removed.
+	 */
+	template<typename PredT, typename DisposerT>
+	size_t remove_if(PredT pred, DisposerT &disposer) {
+		return remove_matching(pred, disposer, (size_t)-1);
+	}
+
+	/* Moves the objects matching pred(obj) to the tail of other in order */
+	template<typename PredT>
+	size_t partition(PredT pred, TailqHead *other) {
+		impl::TailSink<TailqHead> sink(other);
+
+		assert(other != this);
+		return remove_matching(pred, sink, (size_t)-1);
+	}
+
+	/*
+	 * Removes up to max objects matching pred(obj) and stores them in
+	 * out[], the pass stops once max objects are found.
+	 */
+	template<typename PredT>
+	size_t extract_if(PredT pred, ObjectType **out, size_t max) {
+		impl::ExtractSink<ObjectType> sink(out);
+
+		return remove_matching(pred, sink, max);
+	}
+
+	/* Stable merge sort, cmp(a, b) compares objects like compare_fn() */
+	template<typename CompareT>
+	void sort(CompareT cmp) {
+		tqh.next = impl::list_sort<Link>(tqh.next, cmp);
+		relink();
+	}
+
+	/* Both lists must be sorted, nhead is left empty */
+	template<typename CompareT>
+	void merge(TailqHead *nhead, CompareT cmp) {
+		tqh.next = impl::list_merge<Link>(tqh.next, nhead->tqh.next, cmp);
+		nhead->init();
+		this->count_add(nhead->count_get());
+		nhead->count_reset();
+		relink();
+	}
+
+	/*
+	 * Stable LSD radix sort by key_fn(obj), an unsigned integer of up
+	 * to 64 bits.
+	 */
+	template<typename KeyFnT>
+	void radix_sort(KeyFnT key_fn) {
+		/* relink() sets the tail along with the back links */
+		tqh.next = impl::list_radix_sort<Link>(tqh.next, key_fn,
+		    (ObjectType **)NULL);
+		relink();
 	}
 
 	void swap(TailqHead *nhead) {
@@ -222,6 +372,7 @@ public:
 			entry(swap_first)->tqe.prevent = &nhead->tqh;
 		else
 			nhead->tqh.prevent = &nhead->tqh;
+		this->count_swap(nhead);
 	}
 
 protected:
@@ -234,6 +385,111 @@ protected:
 		return EntryType::entry(obj);
 	}
 
+	struct Link {
+		static ObjectType **next(ObjectType *obj) {
+			return &entry(obj)->tqe.next;
+		}
+	};
+
+	void move_count(TailqHead *nhead, ObjectType *first, ObjectType *last) {
+		size_t n;
+
+		if (Policy::counting) {
+			n = impl::list_count<Link>(first, last);
+			nhead->count_sub(n);
+			this->count_add(n);
+		}
+	}
+
+	void unlink_range(ObjectType *first, ObjectType *last) {
+		Policy::check_prev(entry(first));
+		Policy::check_next(entry(last));
+
+		if (entry(last)->tqe.next != NULL)
+			entry(entry(last)->tqe.next)->tqe.prevent =
+			    entry(first)->tqe.prevent;
+		else
+			tqh.prevent = entry(first)->tqe.prevent;
+		entry(first)->tqe.prevent->next = entry(last)->tqe.next;
+	}
+
+	void link_range(typename EntryType::Data *prev, ObjectType *first,
+	    ObjectType *last) {
+		if ((entry(last)->tqe.next = prev->next) != NULL)
+			entry(prev->next)->tqe.prevent = &entry(last)->tqe;
+		else
+			tqh.prevent = &entry(last)->tqe;
+		prev->next = first;
+		entry(first)->tqe.prevent = prev;
+	}
+
+	/*
+	 * Back links are only written where the chain changes, the tail is
+	 * set once.  sink(obj) gets each unlinked object, parked markers
+	 * stay in place.
+	 */
+	template<typename PredT, typename SinkT>
+	size_t remove_matching(PredT &pred, SinkT &sink, size_t max) {
+		typename Policy::RemoveCtx ctx;
+		typename EntryType::Data *prev = &tqh;
+		ObjectType *obj, *next;
+		size_t n = 0;
+
+		for (obj = tqh.next; obj != NULL && n < max; obj = next) {
+			next = entry(obj)->tqe.next;
+			if (!EntryType::is_marker(obj) && pred(obj)) {
+				Policy::remove_pre(ctx, entry(obj));
+				Policy::remove_post(ctx, entry(obj));
+				n++;
+				sink(obj);
+				continue;
+			}
+			if (prev->next != obj) {
+				prev->next = obj;
+				entry(obj)->tqe.prevent = prev;
+			}
+			prev = &entry(obj)->tqe;
+		}
+		if (prev->next != obj) {
+			prev->next = obj;
+			if (obj != NULL)
+				entry(obj)->tqe.prevent = prev;
+		}
+		if (obj == NULL)
+			tqh.prevent = prev;
+		this->count_sub(n);
+		return n;
+	}
+
+	/* Parked markers are never passed to callbacks */
+	static ObjectType *skip_markers(ObjectType *obj) {
+		while (obj != NULL && EntryType::is_marker(obj))
+			obj = entry(obj)->tqe.next;
+		return obj;
+	}
+
+	/* Links objs[] into a chain, the ends are left for link_range() */
+	static void link_batch(ObjectType **objs, size_t n) {
+		size_t i;
+
+		for (i = 1; i < n; i++) {
+			entry(objs[i - 1])->tqe.next = objs[i];
+			entry(objs[i])->tqe.prevent = &entry(objs[i - 1])->tqe;
+		}
+	}
+
+	/* Rebuilds back links from the forward chain */
+	void relink() {
+		typename EntryType::Data *prev = &tqh;
+		ObjectType *obj;
+
+		for (obj = tqh.next; obj != NULL; obj = entry(obj)->tqe.next) {
+			entry(obj)->tqe.prevent = prev;
+			prev = &entry(obj)->tqe;
+		}
+		tqh.prevent = prev;
+	}
+
 private:
 	typename EntryType::Data tqh;
 };
@@ -252,34 +508,160 @@ public:
 	friend class impl::ConstReverseIterator<EntryType>;
 	friend struct policy::Tailq;
 
+	/* Iterators skip markers, see MarkerIterator */
 	struct Iterator : impl::Iterator<EntryType> {
 		typedef impl::Iterator<EntryType> Base;
 		ObjectType *init(TailqHead<EntryType> *head) {
-			return Base::start_at(head->first());
+			return start_at(head->first());
+		}
+
+		ObjectType *start_at(ObjectType *obj) {
+			obj = Base::start_at(obj);
+			return obj != NULL && EntryType::is_marker(obj) ?
+			    next() : obj;
+		}
+
+		ObjectType *next() {
+			ObjectType *obj;
+
+			while ((obj = Base::next()) != NULL &&
+			    EntryType::is_marker(obj))
+				;
+			return obj;
 		}
 	};
 
 	struct ConstIterator : impl::ConstIterator<EntryType> {
 		typedef impl::ConstIterator<EntryType> Base;
 		const ObjectType *init(const TailqHead<EntryType> *head) {
-			return Base::start_at(head->first());
+			return start_at(head->first());
+		}
+
+		const ObjectType *start_at(const ObjectType *obj) {
+			obj = Base::start_at(obj);
+			return obj != NULL && EntryType::is_marker(obj) ?
+			    next() : obj;
+		}
+
+		const ObjectType *next() {
+			const ObjectType *obj;
+
+			while ((obj = Base::next()) != NULL &&
+			    EntryType::is_marker(obj))
+				;
+			return obj;
 		}
 	};
 
 	struct ReverseIterator : impl::ReverseIterator<EntryType> {
 		typedef impl::ReverseIterator<EntryType> Base;
 		ObjectType *init(TailqHead<EntryType> *head) {
-			return Base::start_at(head->last());
+			return start_at(head->last());
+		}
+
+		ObjectType *start_at(ObjectType *obj) {
+			obj = Base::start_at(obj);
+			return obj != NULL && EntryType::is_marker(obj) ?
+			    prev() : obj;
+		}
+
+		ObjectType *prev() {
+			ObjectType *obj;
+
+			while ((obj = Base::prev()) != NULL &&
+			    EntryType::is_marker(obj))
+				;
+			return obj;
 		}
 	};
 
 	struct ConstReverseIterator : impl::ConstReverseIterator<EntryType> {
 		typedef impl::ConstReverseIterator<EntryType> Base;
 		const ObjectType *init(const TailqHead<EntryType> *head) {
-			return Base::start_at(head->last());
+			return start_at(head->last());
+		}
+
+		const ObjectType *start_at(const ObjectType *obj) {
+			obj = Base::start_at(obj);
+			return obj != NULL && EntryType::is_marker(obj) ?
+			    prev() : obj;
+		}
+
+		const ObjectType *prev() {
+			const ObjectType *obj;
+
+			while ((obj = Base::prev()) != NULL &&
+			    EntryType::is_marker(obj))
+				;
+			return obj;
 		}
 	};
 
+	/*
+	 * Resumable iteration for queues that change between next() calls.
+	 * The marker is an object owned by the caller, linked into the queue
+	 * and for which EntryType::is_marker() returns true.  It is parked
+	 * after the last returned object, so any other object may be
+	 * inserted or removed before the next call.  Markers are part of the
+	 * queue while parked: first(), last() and size() see them, the
+	 * iterators skip them.
+	 */
+	class MarkerIterator : impl::NonCopyable {
+	public:
+		explicit MarkerIterator(ObjectType *marker) : mi_head(NULL),
+		    mi_marker(marker) { }
+
+		~MarkerIterator() {
+			finish();
+		}
+
+		ObjectType *init(TailqHead<EntryType> *head) {
+			finish();
+			mi_head = head;
+			head->insert_head(mi_marker);
+			return next();
+		}
+
+		ObjectType *next() {
+			ObjectType *obj;
+
+			if (mi_head == NULL)
+				return NULL;
+			obj = static_cast<EntryType *>(mi_marker)->next();
+			while (obj != NULL && EntryType::is_marker(obj))
+				obj = static_cast<EntryType *>(obj)->next();
+			mi_head->remove(mi_marker);
+			if (obj == NULL) {
+				mi_head = NULL;
+				return NULL;
+			}
+			mi_head->insert_after(obj, mi_marker);
+			return obj;
+		}
+
+		/* False once the end was reached */
+		bool active() const {
+			return (mi_head != NULL);
+		}
+
+		/* Unlinks the marker before the end is reached */
+		void finish() {
+			if (mi_head != NULL) {
+				mi_head->remove(mi_marker);
+				mi_head = NULL;
+			}
+		}
+
+	private:
+		TailqHead<EntryType> *mi_head;
+		ObjectType *mi_marker;
+	};
+
+	/* Entries that use markers hide this */
+	static bool is_marker(const ObjectType *obj) {
+		return false;
+	}
+
 	TailqEntry() {
 		Policy::create_entry(this);
 	}
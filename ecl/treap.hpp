@@ -0,0 +1,651 @@
+/*-
+ * Copyright 2002 Niels Provos <provos@citi.umich.edu>
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Treap with the same interface as RBTreeHead plus split() and merge().
+ * Node priorities are derived from a hash of the object address, so the
+ * entry holds only the three tree links and no balance information.
+ * Expected depth is O(log n) as long as addresses hash well.
+ */
+
+#ifndef ECL_TREAP_HPP
+#define ECL_TREAP_HPP
+
+#include "impl.hpp"
+
+namespace ecl {
+
+namespace policy { // {{{
+
+struct Treap {
+	struct Default : policy::Generic { };
+
+};
+
+} // namespace policy }}}
+
+template<typename EntryT>
+struct TreapPolicy : policy::Treap::Default { };
+
+template <typename EntryT>
+class TreapHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+	typedef typename EntryType::Policy Policy;
+
+	friend struct policy::Treap;
+
+	TreapHead() : trh_root(NULL) { }
+
+	bool empty() const {
+		return (trh_root == NULL);
+	}
+
+	ObjectType *root() {
+		return trh_root;
+	}
+
+	const ObjectType *root() const {
+		return trh_root;
+	}
+
+	ObjectType *first() {
+		return min();
+	}
+
+	const ObjectType *first() const {
+		return min();
+	}
+
+	ObjectType *last() {
+		return max();
+	}
+
+	const ObjectType *last() const {
+		return max();
+	}
+
+	ObjectType *min() {
+		return min_impl();
+	}
+
+	const ObjectType *min() const {
+		return min_impl();
+	}
+
+	ObjectType *max() {
+		return max_impl();
+	}
+
+	const ObjectType *max() const {
+		return max_impl();
+	}
+
+	template<typename KeyType>
+	ObjectType *find(const KeyType &key) {
+		return find_impl(key);
+	}
+
+	/* Finds the node with the same key as elm */
+	template<typename KeyType>
+	const ObjectType *find(const KeyType &key) const {
+		return find_impl(key);
+	}
+
+	ObjectType *find_element(const ObjectType *elm) {
+		return find_element_impl(elm);
+	}
+
+	const ObjectType *find_element(const ObjectType *elm) const {
+		return find_element_impl(elm);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *nfind(const KeyType &key) {
+		return nfind_impl(key);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	const ObjectType *nfind(const KeyType &key) const {
+		return nfind_impl(key);
+	}
+
+	ObjectType *nfind_element(const ObjectType *elm) {
+		return nfind_element_impl(elm);
+	}
+
+	const ObjectType *nfind_element(const ObjectType *elm) const {
+		return nfind_element_impl(elm);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *pfind(const KeyType &key) {
+		return pfind_impl(key);
+	}
+
+	template<typename KeyType>
+	const ObjectType *pfind(const KeyType &key) const {
+		return pfind_impl(key);
+	}
+
+	ObjectType *pfind_element(const ObjectType *elm) {
+		return pfind_element_impl(elm);
+	}
+
+	const ObjectType *pfind_element(const ObjectType *elm) const {
+		return pfind_element_impl(elm);
+	}
+
+	ObjectType *insert(ObjectType *obj) {
+		ObjectType *tmp;
+		ObjectType *parent = NULL;
+		int comp = 0;
+
+		tmp = trh_root;
+		while (tmp) {
+			parent = tmp;
+			comp = compare(obj, parent);
+			if (comp < 0)
+				tmp = entry(tmp)->tre_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->tre_right;
+			else
+				return tmp;
+		}
+		entry(obj)->init(parent);
+		if (parent != NULL) {
+			if (comp < 0)
+				entry(parent)->tre_left = obj;
+			else
+				entry(parent)->tre_right = obj;
+		} else
+			trh_root = obj;
+		while ((parent = entry(obj)->tre_parent) != NULL &&
+		    priority(obj) > priority(parent)) {
+			if (entry(parent)->tre_left == obj)
+				rotate_right(parent);
+			else
+				rotate_left(parent);
+		}
+		return NULL;
+	}
+
+	ObjectType *remove(ObjectType *elm) {
+		ObjectType *child, *parent, *left, *right;
+
+		/* Rotate elm down until it has at most one child */
+		while ((left = entry(elm)->tre_left) != NULL &&
+		    (right = entry(elm)->tre_right) != NULL) {
+			if (priority(left) > priority(right))
+				rotate_right(elm);
+			else
+				rotate_left(elm);
+		}
+		child = left != NULL ? left : entry(elm)->tre_right;
+		parent = entry(elm)->tre_parent;
+		if (child)
+			entry(child)->tre_parent = parent;
+		if (parent) {
+			if (entry(parent)->tre_left == elm)
+				entry(parent)->tre_left = child;
+			else
+				entry(parent)->tre_right = child;
+		} else
+			trh_root = child;
+		return elm;
+	}
+
+	/*
+	 * Moves all elements greater than or equal to key into nhead, which
+	 * must be empty.
+	 */
+	template<typename KeyType>
+	void split(const KeyType &key, TreapHead *nhead) {
+		ObjectType *ltree = NULL, *rtree = NULL;
+		ObjectType **lhook = &ltree, **rhook = &rtree;
+		ObjectType *lparent = NULL, *rparent = NULL;
+		ObjectType *tmp = trh_root;
+
+		assert(nhead->empty());
+		while (tmp) {
+			if (compare_key(key, tmp) <= 0) {
+				*rhook = tmp;
+				entry(tmp)->tre_parent = rparent;
+				rparent = tmp;
+				rhook = &entry(tmp)->tre_left;
+				tmp = *rhook;
+			} else {
+				*lhook = tmp;
+				entry(tmp)->tre_parent = lparent;
+				lparent = tmp;
+				lhook = &entry(tmp)->tre_right;
+				tmp = *lhook;
+			}
+		}
+		*lhook = NULL;
+		*rhook = NULL;
+		trh_root = ltree;
+		nhead->trh_root = rtree;
+	}
+
+	/*
+	 * Appends all elements of nhead, leaving it empty.  Every element of
+	 * nhead must be greater than elements in this tree.
+	 */
+	void merge(TreapHead *nhead) {
+		ObjectType *a = trh_root, *b = nhead->trh_root;
+		ObjectType **hook = &trh_root, *parent = NULL;
+
+		assert(a == NULL || b == NULL || compare(max(), nhead->min()) < 0);
+		while (a && b) {
+			if (priority(a) > priority(b)) {
+				*hook = a;
+				entry(a)->tre_parent = parent;
+				parent = a;
+				hook = &entry(a)->tre_right;
+				a = *hook;
+			} else {
+				*hook = b;
+				entry(b)->tre_parent = parent;
+				parent = b;
+				hook = &entry(b)->tre_left;
+				b = *hook;
+			}
+		}
+		if ((*hook = a != NULL ? a : b) != NULL)
+			entry(*hook)->tre_parent = parent;
+		nhead->trh_root = NULL;
+	}
+
+protected:
+	static int compare(const ObjectType *a, const ObjectType *b) {
+		return EntryType::compare(a, b);
+	}
+
+	template<typename KeyType>
+	static int compare_key(const KeyType &k, const ObjectType *obj) {
+		return EntryType::compare_key(k, obj);
+	}
+
+	static EntryType *entry(ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	static uintptr_t priority(const ObjectType *obj) {
+		return EntryType::priority(obj);
+	}
+
+	ObjectType *min_impl() const {
+		ObjectType *parent, *tmp;
+
+		for (tmp = trh_root, parent = NULL; tmp;) {
+			parent = tmp;
+			tmp = entry(tmp)->tre_left;
+		}
+		return parent;
+	}
+
+	ObjectType *max_impl() const {
+		ObjectType *parent, *tmp;
+
+		for (tmp = trh_root, parent = NULL; tmp;) {
+			parent = tmp;
+			tmp = entry(tmp)->tre_right;
+		}
+		return parent;
+	}
+
+	template<typename KeyType>
+	ObjectType *find_impl(const KeyType &key) const {
+		ObjectType *tmp = trh_root;
+		int comp;
+
+		while (tmp) {
+			comp = compare_key(key, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->tre_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->tre_right;
+			else
+				return tmp;
+		}
+		return NULL;
+	}
+
+	ObjectType *find_element_impl(const ObjectType *elm) const {
+		ObjectType *tmp = trh_root;
+		int comp;
+
+		while (tmp) {
+			comp = compare(elm, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->tre_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->tre_right;
+			else
+				return tmp;
+		}
+		return NULL;
+	}
+
+	template<typename KeyType>
+	ObjectType *nfind_impl(const KeyType &key) const {
+		ObjectType *tmp = trh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare_key(key, tmp);
+			if (comp < 0) {
+				res = tmp;
+				tmp = entry(tmp)->tre_left;
+			} else if (comp > 0)
+				tmp = entry(tmp)->tre_right;
+			else
+				return tmp;
+		}
+		return res;
+	}
+
+	ObjectType *nfind_element_impl(const ObjectType *elm) const {
+		ObjectType *tmp = trh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare(elm, tmp);
+			if (comp < 0) {
+				res = tmp;
+				tmp = entry(tmp)->tre_left;
+			} else if (comp > 0)
+				tmp = entry(tmp)->tre_right;
+			else
+				return tmp;
+		}
+		return res;
+	}
+
+	template<typename KeyType>
+	ObjectType *pfind_impl(const KeyType &key) const {
+		ObjectType *tmp = trh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare_key(key, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->tre_left;
+			else if (comp > 0) {
+				res = tmp;
+				tmp = entry(tmp)->tre_right;
+			} else
+				return tmp;
+		}
+		return res;
+	}
+
+	ObjectType *pfind_element_impl(const ObjectType *elm) const {
+		ObjectType *tmp = trh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare(elm, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->tre_left;
+			else if (comp > 0) {
+				res = tmp;
+				tmp = entry(tmp)->tre_right;
+			} else
+				return tmp;
+		}
+		return res;
+	}
+
+	void rotate_left(ObjectType *elm) {
+		ObjectType *tmp;
+
+		tmp = entry(elm)->tre_right;
+		if ((entry(elm)->tre_right = entry(tmp)->tre_left) != NULL) {
+			entry(entry(tmp)->tre_left)->tre_parent = elm;
+		}
+		if ((entry(tmp)->tre_parent = entry(elm)->tre_parent) != NULL) {
+			if ((elm) == entry(entry(elm)->tre_parent)->tre_left)
+				entry(entry(elm)->tre_parent)->tre_left = tmp;
+			else
+				entry(entry(elm)->tre_parent)->tre_right = tmp;
+		} else
+			trh_root = tmp;
+		entry(tmp)->tre_left = elm;
+		entry(elm)->tre_parent = tmp;
+	}
+
+	void rotate_right(ObjectType *elm) {
+		ObjectType *tmp;
+
+		tmp = entry(elm)->tre_left;
+		if ((entry(elm)->tre_left = entry(tmp)->tre_right) != NULL) {
+			entry(entry(tmp)->tre_right)->tre_parent = elm;
+		}
+		if ((entry(tmp)->tre_parent = entry(elm)->tre_parent) != NULL) {
+			if ((elm) == entry(entry(elm)->tre_parent)->tre_left)
+				entry(entry(elm)->tre_parent)->tre_left = tmp;
+			else
+				entry(entry(elm)->tre_parent)->tre_right = tmp;
+		} else
+			trh_root = tmp;
+		entry(tmp)->tre_right = elm;
+		entry(elm)->tre_parent = tmp;
+	}
+
+private:
+	ObjectType *trh_root;
+};
+
+template <typename EntryT, typename ObjectT>
+class TreapEntry : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef ObjectT ObjectType;
+	typedef TreapPolicy<EntryType> Policy;
+
+	friend class TreapHead<EntryType>;
+	friend class impl::Iterator<EntryType>;
+	friend class impl::ConstIterator<EntryType>;
+	friend class impl::ReverseIterator<EntryType>;
+	friend class impl::ConstReverseIterator<EntryType>;
+	friend struct policy::Treap;
+
+	struct Iterator : impl::Iterator<EntryType> {
+		typedef impl::Iterator<EntryType> Base;
+		ObjectType *init(TreapHead<EntryType> *head) {
+			return Base::start_at(head->first());
+		}
+	};
+
+	struct ConstIterator : impl::ConstIterator<EntryType> {
+		typedef impl::ConstIterator<EntryType> Base;
+		const ObjectType *init(const TreapHead<EntryType> *head) {
+			return Base::start_at(head->first());
+		}
+	};
+
+	struct ReverseIterator : impl::ReverseIterator<EntryType> {
+		typedef impl::ReverseIterator<EntryType> Base;
+		ObjectType *init(TreapHead<EntryType> *head) {
+			return Base::start_at(head->last());
+		}
+	};
+
+	struct ConstReverseIterator : impl::ConstReverseIterator<EntryType> {
+		typedef impl::ConstReverseIterator<EntryType> Base;
+		const ObjectType *init(const TreapHead<EntryType> *head) {
+			return Base::start_at(head->last());
+		}
+	};
+
+	static int compare(const ObjectType *a, const ObjectType *b) {
+		return EntryType::compare_fn(a, b);
+	}
+
+	template<typename KeyType>
+	static int compare_key(const KeyType &key, const ObjectType *obj) {
+		return EntryType::compare_key_fn(key, obj);
+	}
+
+	/* Heap priority, a hash of the object address */
+	static uintptr_t priority(const ObjectType *obj) {
+		uint64_t x = reinterpret_cast<uintptr_t>(obj);
+
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+		return (uintptr_t)x;
+	}
+
+	TreapEntry() {
+		Policy::create_entry(this);
+	}
+
+	~TreapEntry() {
+		Policy::destroy_entry(this);
+	}
+
+	ObjectType *left() {
+		return this->tre_left;
+	}
+
+	const ObjectType *left() const {
+		return this->tre_left;
+	}
+
+	ObjectType *right() {
+		return this->tre_right;
+	}
+
+	const ObjectType *right() const {
+		return this->tre_right;
+	}
+
+	ObjectType *parent() {
+		return this->tre_parent;
+	}
+
+	const ObjectType *parent() const {
+		return this->tre_parent;
+	}
+
+	ObjectType *next() {
+		return next_impl();
+	}
+
+	const ObjectType *next() const {
+		return next_impl();
+	}
+
+	ObjectType *prev() {
+		return prev_impl();
+	}
+
+	const ObjectType *prev() const {
+		return prev_impl();
+	}
+
+protected:
+	static EntryType *entry(ObjectType *obj) {
+		return obj;
+	}
+
+	static const EntryType *entry(const ObjectType *obj) {
+		return obj;
+	}
+
+	void init(ObjectType *parent) {
+		tre_parent = parent;
+		tre_left = tre_right = NULL;
+	}
+
+	ObjectType *object() const {
+		return impl::entry_to_object<ObjectType, TreapEntry>(this);
+	}
+
+	ObjectType *next_impl() const {
+		ObjectType *elm = object();
+
+		if (entry(elm)->tre_right) {
+			elm = entry(elm)->tre_right;
+			while (entry(elm)->tre_left)
+				elm = entry(elm)->tre_left;
+		} else {
+			if (entry(elm)->tre_parent &&
+			    (elm == entry(entry(elm)->tre_parent)->tre_left))
+				elm = entry(elm)->tre_parent;
+			else {
+				while (entry(elm)->tre_parent &&
+				    (elm == entry(entry(elm)->tre_parent)->tre_right))
+					elm = entry(elm)->tre_parent;
+				elm = entry(elm)->tre_parent;
+			}
+		}
+		return elm;
+	}
+
+	ObjectType *prev_impl() const {
+		ObjectType *elm = object();
+
+		if (entry(elm)->tre_left) {
+			elm = entry(elm)->tre_left;
+			while (entry(elm)->tre_right)
+				elm = entry(elm)->tre_right;
+		} else {
+			if (entry(elm)->tre_parent &&
+			    (elm == entry(entry(elm)->tre_parent)->tre_right))
+				elm = entry(elm)->tre_parent;
+			else {
+				while (entry(elm)->tre_parent &&
+				    (elm == entry(entry(elm)->tre_parent)->tre_left))
+					elm = entry(elm)->tre_parent;
+				elm = entry(elm)->tre_parent;
+			}
+		}
+		return elm;
+	}
+
+	ObjectType *tre_left;
+	ObjectType *tre_right;
+	ObjectType *tre_parent;
+};
+
+} // namespace ecl
+
+#endif
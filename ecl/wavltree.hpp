@@ -0,0 +1,741 @@
+/*-
+ * Copyright 2002 Niels Provos <provos@citi.umich.edu>
+ * Copyright (c) 2012 Gleb Kurtsou <gleb@FreeBSD.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Weak AVL tree, see B. Haeupler, S. Sen, R. E. Tarjan, "Rank-balanced
+ * trees".  Same interface as RBTreeHead.  Rebalancing takes O(1)
+ * amortized rank changes and at most two rotations per insert or
+ * remove.  Without deletions the tree is an AVL tree.
+ */
+
+#ifndef ECL_WAVLTREE_HPP
+#define ECL_WAVLTREE_HPP
+
+#include "impl.hpp"
+
+namespace ecl {
+
+namespace policy { // {{{
+
+struct WAVLTree {
+	struct Default : policy::Generic { };
+
+};
+
+} // namespace policy }}}
+
+template<typename EntryT>
+struct WAVLTreePolicy : policy::WAVLTree::Default { };
+
+template <typename EntryT>
+class WAVLTreeHead : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef typename EntryType::ObjectType ObjectType;
+	typedef typename EntryType::Policy Policy;
+
+	friend struct policy::WAVLTree;
+
+	WAVLTreeHead() : wavlh_root(NULL) { }
+
+	bool empty() const {
+		return (wavlh_root == NULL);
+	}
+
+	ObjectType *root() {
+		return wavlh_root;
+	}
+
+	const ObjectType *root() const {
+		return wavlh_root;
+	}
+
+	ObjectType *first() {
+		return min();
+	}
+
+	const ObjectType *first() const {
+		return min();
+	}
+
+	ObjectType *last() {
+		return max();
+	}
+
+	const ObjectType *last() const {
+		return max();
+	}
+
+	ObjectType *min() {
+		return min_impl();
+	}
+
+	const ObjectType *min() const {
+		return min_impl();
+	}
+
+	ObjectType *max() {
+		return max_impl();
+	}
+
+	const ObjectType *max() const {
+		return max_impl();
+	}
+
+	template<typename KeyType>
+	ObjectType *find(const KeyType &key) {
+		return find_impl(key);
+	}
+
+	/* Finds the node with the same key as elm */
+	template<typename KeyType>
+	const ObjectType *find(const KeyType &key) const {
+		return find_impl(key);
+	}
+
+	ObjectType *find_element(const ObjectType *elm) {
+		return find_element_impl(elm);
+	}
+
+	const ObjectType *find_element(const ObjectType *elm) const {
+		return find_element_impl(elm);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *nfind(const KeyType &key) {
+		return nfind_impl(key);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	const ObjectType *nfind(const KeyType &key) const {
+		return nfind_impl(key);
+	}
+
+	ObjectType *nfind_element(const ObjectType *elm) {
+		return nfind_element_impl(elm);
+	}
+
+	const ObjectType *nfind_element(const ObjectType *elm) const {
+		return nfind_element_impl(elm);
+	}
+
+	/* Finds the first node greater than or equal to the search key */
+	template<typename KeyType>
+	ObjectType *pfind(const KeyType &key) {
+		return pfind_impl(key);
+	}
+
+	template<typename KeyType>
+	const ObjectType *pfind(const KeyType &key) const {
+		return pfind_impl(key);
+	}
+
+	ObjectType *pfind_element(const ObjectType *elm) {
+		return pfind_element_impl(elm);
+	}
+
+	const ObjectType *pfind_element(const ObjectType *elm) const {
+		return pfind_element_impl(elm);
+	}
+
+	ObjectType *insert(ObjectType *obj) {
+		ObjectType *tmp;
+		ObjectType *parent = NULL;
+		int comp = 0;
+
+		tmp = wavlh_root;
+		while (tmp) {
+			parent = tmp;
+			comp = compare(obj, parent);
+			if (comp < 0)
+				tmp = entry(tmp)->wavle_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->wavle_right;
+			else
+				return tmp;
+		}
+		entry(obj)->init(parent);
+		if (parent != NULL) {
+			if (comp < 0)
+				entry(parent)->wavle_left = obj;
+			else
+				entry(parent)->wavle_right = obj;
+		} else
+			wavlh_root = obj;
+		insert_rank(obj);
+		return NULL;
+	}
+
+	ObjectType *remove(ObjectType *elm) {
+		ObjectType *child, *parent, *old;
+
+		old = elm;
+		if (entry(elm)->wavle_left == NULL)
+			child = entry(elm)->wavle_right;
+		else if (entry(elm)->wavle_right == NULL)
+			child = entry(elm)->wavle_left;
+		else {
+			remove_nontrivial(elm);
+			return old;
+		}
+		parent = entry(elm)->wavle_parent;
+		if (child)
+			entry(child)->wavle_parent = parent;
+		if (parent) {
+			if (entry(parent)->wavle_left == elm)
+				entry(parent)->wavle_left = child;
+			else
+				entry(parent)->wavle_right = child;
+		} else
+			wavlh_root = child;
+		remove_rank(parent, child);
+		return old;
+	}
+
+protected:
+	static int compare(const ObjectType *a, const ObjectType *b) {
+		return EntryType::compare(a, b);
+	}
+
+	template<typename KeyType>
+	static int compare_key(const KeyType &k, const ObjectType *obj) {
+		return EntryType::compare_key(k, obj);
+	}
+
+	static EntryType *entry(ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	static const EntryType *entry(const ObjectType *obj) {
+		return EntryType::entry(obj);
+	}
+
+	static int rank(const ObjectType *obj) {
+		return obj != NULL ? entry(obj)->wavle_rank : -1;
+	}
+
+	static int rank_diff(const ObjectType *parent, const ObjectType *obj) {
+		return rank(parent) - rank(obj);
+	}
+
+	ObjectType *min_impl() const {
+		ObjectType *parent, *tmp;
+
+		for (tmp = wavlh_root, parent = NULL; tmp;) {
+			parent = tmp;
+			tmp = entry(tmp)->wavle_left;
+		}
+		return parent;
+	}
+
+	ObjectType *max_impl() const {
+		ObjectType *parent, *tmp;
+
+		for (tmp = wavlh_root, parent = NULL; tmp;) {
+			parent = tmp;
+			tmp = entry(tmp)->wavle_right;
+		}
+		return parent;
+	}
+
+	template<typename KeyType>
+	ObjectType *find_impl(const KeyType &key) const {
+		ObjectType *tmp = wavlh_root;
+		int comp;
+
+		while (tmp) {
+			comp = compare_key(key, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->wavle_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->wavle_right;
+			else
+				return tmp;
+		}
+		return NULL;
+	}
+
+	ObjectType *find_element_impl(const ObjectType *elm) const {
+		ObjectType *tmp = wavlh_root;
+		int comp;
+
+		while (tmp) {
+			comp = compare(elm, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->wavle_left;
+			else if (comp > 0)
+				tmp = entry(tmp)->wavle_right;
+			else
+				return tmp;
+		}
+		return NULL;
+	}
+
+	template<typename KeyType>
+	ObjectType *nfind_impl(const KeyType &key) const {
+		ObjectType *tmp = wavlh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare_key(key, tmp);
+			if (comp < 0) {
+				res = tmp;
+				tmp = entry(tmp)->wavle_left;
+			} else if (comp > 0)
+				tmp = entry(tmp)->wavle_right;
+			else
+				return tmp;
+		}
+		return res;
+	}
+
+	ObjectType *nfind_element_impl(const ObjectType *elm) const {
+		ObjectType *tmp = wavlh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare(elm, tmp);
+			if (comp < 0) {
+				res = tmp;
+				tmp = entry(tmp)->wavle_left;
+			} else if (comp > 0)
+				tmp = entry(tmp)->wavle_right;
+			else
+				return tmp;
+		}
+		return res;
+	}
+
+	template<typename KeyType>
+	ObjectType *pfind_impl(const KeyType &key) const {
+		ObjectType *tmp = wavlh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare_key(key, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->wavle_left;
+			else if (comp > 0) {
+				res = tmp;
+				tmp = entry(tmp)->wavle_right;
+			} else
+				return tmp;
+		}
+		return res;
+	}
+
+	ObjectType *pfind_element_impl(const ObjectType *elm) const {
+		ObjectType *tmp = wavlh_root;
+		ObjectType *res = NULL;
+		int comp;
+
+		while (tmp) {
+			comp = compare(elm, tmp);
+			if (comp < 0)
+				tmp = entry(tmp)->wavle_left;
+			else if (comp > 0) {
+				res = tmp;
+				tmp = entry(tmp)->wavle_right;
+			} else
+				return tmp;
+		}
+		return res;
+	}
+
+	/* elm is a new leaf of rank 0, fix up 0-children bottom up */
+	void insert_rank(ObjectType *elm) {
+		ObjectType *parent, *sibling, *inner;
+
+		while ((parent = entry(elm)->wavle_parent) != NULL &&
+		    rank_diff(parent, elm) == 0) {
+			if (entry(parent)->wavle_left == elm)
+				sibling = entry(parent)->wavle_right;
+			else
+				sibling = entry(parent)->wavle_left;
+			if (rank_diff(parent, sibling) == 1) {
+				/* 0,1 node: promote and continue upwards */
+				entry(parent)->wavle_rank++;
+				elm = parent;
+				continue;
+			}
+			/* 0,2 node: one or two rotations finish the job */
+			if (entry(parent)->wavle_left == elm) {
+				inner = entry(elm)->wavle_right;
+				if (inner == NULL || rank_diff(elm, inner) == 2) {
+					rotate_right(parent);
+				} else {
+					rotate_left(elm);
+					rotate_right(parent);
+					entry(inner)->wavle_rank++;
+					entry(elm)->wavle_rank--;
+				}
+			} else {
+				inner = entry(elm)->wavle_left;
+				if (inner == NULL || rank_diff(elm, inner) == 2) {
+					rotate_left(parent);
+				} else {
+					rotate_right(elm);
+					rotate_left(parent);
+					entry(inner)->wavle_rank++;
+					entry(elm)->wavle_rank--;
+				}
+			}
+			entry(parent)->wavle_rank--;
+			break;
+		}
+	}
+
+	/*
+	 * elm replaced a removed node under parent and may be NULL.  Demote
+	 * 2,2 leaves and 3-children on the way up, at most two rotations.
+	 */
+	void remove_rank(ObjectType *parent, ObjectType *elm) {
+		ObjectType *sibling, *outer, *inner;
+
+		if (parent == NULL)
+			return;
+		if (entry(parent)->wavle_left == NULL &&
+		    entry(parent)->wavle_right == NULL && rank(parent) == 1) {
+			entry(parent)->wavle_rank = 0;
+			elm = parent;
+			parent = entry(elm)->wavle_parent;
+		}
+		while (parent != NULL && rank_diff(parent, elm) == 3) {
+			if (entry(parent)->wavle_left == elm)
+				sibling = entry(parent)->wavle_right;
+			else
+				sibling = entry(parent)->wavle_left;
+			if (rank_diff(parent, sibling) == 2) {
+				entry(parent)->wavle_rank--;
+				elm = parent;
+				parent = entry(elm)->wavle_parent;
+				continue;
+			}
+			if (rank_diff(sibling, entry(sibling)->wavle_left) == 2 &&
+			    rank_diff(sibling, entry(sibling)->wavle_right) == 2) {
+				entry(parent)->wavle_rank--;
+				entry(sibling)->wavle_rank--;
+				elm = parent;
+				parent = entry(elm)->wavle_parent;
+				continue;
+			}
+			if (entry(parent)->wavle_right == sibling) {
+				outer = entry(sibling)->wavle_right;
+				inner = entry(sibling)->wavle_left;
+				if (rank_diff(sibling, outer) == 1) {
+					rotate_left(parent);
+					entry(sibling)->wavle_rank++;
+					entry(parent)->wavle_rank--;
+				} else {
+					rotate_right(sibling);
+					rotate_left(parent);
+					entry(inner)->wavle_rank += 2;
+					entry(sibling)->wavle_rank--;
+					entry(parent)->wavle_rank -= 2;
+				}
+			} else {
+				outer = entry(sibling)->wavle_left;
+				inner = entry(sibling)->wavle_right;
+				if (rank_diff(sibling, outer) == 1) {
+					rotate_right(parent);
+					entry(sibling)->wavle_rank++;
+					entry(parent)->wavle_rank--;
+				} else {
+					rotate_left(sibling);
+					rotate_right(parent);
+					entry(inner)->wavle_rank += 2;
+					entry(sibling)->wavle_rank--;
+					entry(parent)->wavle_rank -= 2;
+				}
+			}
+			if (entry(parent)->wavle_left == NULL &&
+			    entry(parent)->wavle_right == NULL)
+				entry(parent)->wavle_rank = 0;
+			break;
+		}
+	}
+
+	ObjectType *remove_nontrivial(ObjectType *elm) {
+		ObjectType *child, *parent, *left, *old;
+
+		old = elm;
+		elm = entry(elm)->wavle_right;
+		while ((left = entry(elm)->wavle_left) != NULL)
+			elm = left;
+		child = entry(elm)->wavle_right;
+		parent = entry(elm)->wavle_parent;
+		if (child)
+			entry(child)->wavle_parent = parent;
+		if (parent) {
+			if (entry(parent)->wavle_left == elm)
+				entry(parent)->wavle_left = child;
+			else
+				entry(parent)->wavle_right = child;
+		} else
+			wavlh_root = child;
+		if (entry(elm)->wavle_parent == old)
+			parent = elm;
+		entry(elm)->init_copy(entry(old));
+		if (entry(old)->wavle_parent) {
+			if (entry(entry(old)->wavle_parent)->wavle_left == old)
+				entry(entry(old)->wavle_parent)->wavle_left = elm;
+			else
+				entry(entry(old)->wavle_parent)->wavle_right = elm;
+		} else
+			wavlh_root = elm;
+		entry(entry(old)->wavle_left)->wavle_parent = elm;
+		if (entry(old)->wavle_right)
+			entry(entry(old)->wavle_right)->wavle_parent = elm;
+		remove_rank(parent, child);
+		return old;
+	}
+
+	void rotate_left(ObjectType *elm) {
+		ObjectType *tmp;
+
+		tmp = entry(elm)->wavle_right;
+		if ((entry(elm)->wavle_right = entry(tmp)->wavle_left) != NULL) {
+			entry(entry(tmp)->wavle_left)->wavle_parent = elm;
+		}
+		if ((entry(tmp)->wavle_parent = entry(elm)->wavle_parent) != NULL) {
+			if ((elm) == entry(entry(elm)->wavle_parent)->wavle_left)
+				entry(entry(elm)->wavle_parent)->wavle_left = tmp;
+			else
+				entry(entry(elm)->wavle_parent)->wavle_right = tmp;
+		} else
+			wavlh_root = tmp;
+		entry(tmp)->wavle_left = elm;
+		entry(elm)->wavle_parent = tmp;
+	}
+
+	void rotate_right(ObjectType *elm) {
+		ObjectType *tmp;
+
+		tmp = entry(elm)->wavle_left;
+		if ((entry(elm)->wavle_left = entry(tmp)->wavle_right) != NULL) {
+			entry(entry(tmp)->wavle_right)->wavle_parent = elm;
+		}
+		if ((entry(tmp)->wavle_parent = entry(elm)->wavle_parent) != NULL) {
+			if ((elm) == entry(entry(elm)->wavle_parent)->wavle_left)
+				entry(entry(elm)->wavle_parent)->wavle_left = tmp;
+			else
+				entry(entry(elm)->wavle_parent)->wavle_right = tmp;
+		} else
+			wavlh_root = tmp;
+		entry(tmp)->wavle_right = elm;
+		entry(elm)->wavle_parent = tmp;
+	}
+
+private:
+	ObjectType *wavlh_root;
+};
+
+template <typename EntryT, typename ObjectT>
+class WAVLTreeEntry : impl::NonCopyable {
+public:
+	typedef EntryT EntryType;
+	typedef ObjectT ObjectType;
+	typedef WAVLTreePolicy<EntryType> Policy;
+
+	friend class WAVLTreeHead<EntryType>;
+	friend class impl::Iterator<EntryType>;
+	friend class impl::ConstIterator<EntryType>;
+	friend class impl::ReverseIterator<EntryType>;
+	friend class impl::ConstReverseIterator<EntryType>;
+	friend struct policy::WAVLTree;
+
+	struct Iterator : impl::Iterator<EntryType> {
+		typedef impl::Iterator<EntryType> Base;
+		ObjectType *init(WAVLTreeHead<EntryType> *head) {
+			return Base::start_at(head->first());
+		}
+	};
+
+	struct ConstIterator : impl::ConstIterator<EntryType> {
+		typedef impl::ConstIterator<EntryType> Base;
+		const ObjectType *init(const WAVLTreeHead<EntryType> *head) {
+			return Base::start_at(head->first());
+		}
+	};
+
+	struct ReverseIterator : impl::ReverseIterator<EntryType> {
+		typedef impl::ReverseIterator<EntryType> Base;
+		ObjectType *init(WAVLTreeHead<EntryType> *head) {
+			return Base::start_at(head->last());
+		}
+	};
+
+	struct ConstReverseIterator : impl::ConstReverseIterator<EntryType> {
+		typedef impl::ConstReverseIterator<EntryType> Base;
+		const ObjectType *init(const WAVLTreeHead<EntryType> *head) {
+			return Base::start_at(head->last());
+		}
+	};
+
+	static int compare(const ObjectType *a, const ObjectType *b) {
+		return EntryType::compare_fn(a, b);
+	}
+
+	template<typename KeyType>
+	static int compare_key(const KeyType &key, const ObjectType *obj) {
+		return EntryType::compare_key_fn(key, obj);
+	}
+
+	WAVLTreeEntry() {
+		Policy::create_entry(this);
+	}
+
+	~WAVLTreeEntry() {
+		Policy::destroy_entry(this);
+	}
+
+	ObjectType *left() {
+		return this->wavle_left;
+	}
+
+	const ObjectType *left() const {
+		return this->wavle_left;
+	}
+
+	ObjectType *right() {
+		return this->wavle_right;
+	}
+
+	const ObjectType *right() const {
+		return this->wavle_right;
+	}
+
+	ObjectType *parent() {
+		return this->wavle_parent;
+	}
+
+	const ObjectType *parent() const {
+		return this->wavle_parent;
+	}
+
+	int rank() const {
+		return this->wavle_rank;
+	}
+
+	ObjectType *next() {
+		return next_impl();
+	}
+
+	const ObjectType *next() const {
+		return next_impl();
+	}
+
+	ObjectType *prev() {
+		return prev_impl();
+	}
+
+	const ObjectType *prev() const {
+		return prev_impl();
+	}
+
+protected:
+	static EntryType *entry(ObjectType *obj) {
+		return obj;
+	}
+
+	static const EntryType *entry(const ObjectType *obj) {
+		return obj;
+	}
+
+	void init(ObjectType *parent) {
+		wavle_parent = parent;
+		wavle_left = wavle_right = NULL;
+		wavle_rank = 0;
+	}
+
+	void init_copy(EntryType *a) {
+		wavle_parent = a->wavle_parent;
+		wavle_left = a->wavle_left;
+		wavle_right = a->wavle_right;
+		wavle_rank = a->wavle_rank;
+	}
+
+	ObjectType *object() const {
+		return impl::entry_to_object<ObjectType, WAVLTreeEntry>(this);
+	}
+
+	ObjectType *next_impl() const {
+		ObjectType *elm = object();
+
+		if (entry(elm)->wavle_right) {
+			elm = entry(elm)->wavle_right;
+			while (entry(elm)->wavle_left)
+				elm = entry(elm)->wavle_left;
+		} else {
+			if (entry(elm)->wavle_parent &&
+			    (elm == entry(entry(elm)->wavle_parent)->wavle_left))
+				elm = entry(elm)->wavle_parent;
+			else {
+				while (entry(elm)->wavle_parent &&
+				    (elm == entry(entry(elm)->wavle_parent)->wavle_right))
+					elm = entry(elm)->wavle_parent;
+				elm = entry(elm)->wavle_parent;
+			}
+		}
+		return elm;
+	}
+
+	ObjectType *prev_impl() const {
+		ObjectType *elm = object();
+
+		if (entry(elm)->wavle_left) {
+			elm = entry(elm)->wavle_left;
+			while (entry(elm)->wavle_right)
+				elm = entry(elm)->wavle_right;
+		} else {
+			if (entry(elm)->wavle_parent &&
+			    (elm == entry(entry(elm)->wavle_parent)->wavle_right))
+				elm = entry(elm)->wavle_parent;
+			else {
+				while (entry(elm)->wavle_parent &&
+				    (elm == entry(entry(elm)->wavle_parent)->wavle_left))
+					elm = entry(elm)->wavle_parent;
+				elm = entry(elm)->wavle_parent;
+			}
+		}
+		return elm;
+	}
+
+	ObjectType *wavle_left;
+	ObjectType *wavle_right;
+	ObjectType *wavle_parent;
+	int wavle_rank;
+};
+
+} // namespace ecl
+
+#endif
@@ -25,14 +25,34 @@
  */
 
 #include <sys/types.h>
+#include <pthread.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ecl/slist.hpp"
 #include "ecl/stailq.hpp"
 #include "ecl/list.hpp"
 #include "ecl/tailq.hpp"
 #include "ecl/rbtree.hpp"
+#include "ecl/rbfrozen.hpp"
+#include "ecl/rbseq.hpp"
+#include "ecl/rbshard.hpp"
+#include "ecl/rbparallel.hpp"
+#include "ecl/wavltree.hpp"
+#include "ecl/avltree.hpp"
+#include "ecl/splaytree.hpp"
+#include "ecl/treap.hpp"
+#include "ecl/bptree.hpp"
+#include "ecl/art.hpp"
+#include "ecl/radix.hpp"
+#include "ecl/hashtable.hpp"
+#include "ecl/hashindex.hpp"
+#include "ecl/chashtable.hpp"
+#include "ecl/epoch.hpp"
+#include "ecl/skiplist.hpp"
+#include "ecl/algorithm.hpp"
 
 // {{{ genetric
 
@@ -64,6 +84,473 @@ void test_basic_init_generic(HeadT1 &q1, HeadT2 &q2, EntryT *s[], int n)
 	}
 }
 
+/* list1 sorts in ascending and list2 in descending order of generation */
+template<template<typename> class HeadT, typename ValT>
+void test_basic_tree(int n)
+{
+	typedef typename ValT::list1 list1;
+	typedef typename ValT::list2 list2;
+
+	ValT **s, *si, *sprev, *snext;
+	const ValT *sc;
+	HeadT<list1> q1;
+	HeadT<list2> q2;
+	const HeadT<list1> *q1c = &q1;
+	int i;
+
+	s = new ValT*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValT(i);
+
+	for (i = 0; i < n; i+=2) {
+		q1.insert(s[i]);
+		q2.insert(s[i]);
+	}
+	for (i = 1; i < n; i+=2) {
+		q1.insert(s[i]);
+		q2.insert(s[i]);
+	}
+
+	assert(q1.min() == s[0]);
+	assert(q1.max() == s[n - 1]);
+	assert(q2.min() == s[n - 1]);
+	assert(q2.max() == s[0]);
+
+	for (si = q1.first(), i = 0; si != NULL; si = si->list1::next(), i++) {
+		assert(i < n);
+		assert(si == s[i]);
+		if (i > 0)
+			assert(si->list1::prev() == s[i - 1]);
+		if (i + 1 < n)
+			assert(si->list1::next() == s[i + 1]);
+		else
+			assert(si->list1::next() == NULL);
+	}
+	assert(i == n);
+
+	typename list2::ReverseIterator rit;
+	for (si = rit.init(&q2), i = 0; si != NULL; si = rit.prev(), i++) {
+		assert(si == s[i]);
+	}
+
+	for (i = 0; i < n; i++) {
+		assert(q1.find(i) == s[i]);
+		assert(q2.find(i) == s[i]);
+	}
+
+	for (i = 0, sc = q1c->first(); sc != NULL; sc = sc->list1::next())
+		i += sc->generation();
+	assert(i == n * (n - 1) / 2); // start at 0
+	typename list1::ConstIterator cit;
+	for (i = 0, sc = cit.init(q1c); sc != NULL; sc = cit.next())
+		i += sc->generation();
+	assert(i == n * (n - 1) / 2); // start at 0
+	typename list1::ConstReverseIterator crit;
+	for (i = 0, sc = crit.init(q1c); sc != NULL; sc = crit.prev())
+		i += sc->generation();
+	assert(i == n * (n - 1) / 2); // start at 0
+
+	sc = q1c->find(n / 2);
+	assert(sc == s[n / 2]);
+
+	for (i = 0; i < n; i+=2) {
+		q1.remove(s[i]);
+		q2.remove(s[i]);
+	}
+	for (i = 1; i < n; i+=2) {
+		q1.remove(s[i]);
+		q2.remove(s[i]);
+	}
+	assert(q1.empty());
+	assert(q2.empty());
+
+	for (i = 0; i < n; i += 2) {
+		q1.insert(s[i]);
+		q2.insert(s[i]);
+	}
+
+	assert(q1.min() == s[0]);
+	assert(q1.max() == s[n - 2 + (n % 2)]);
+	assert(q2.min() == s[n - 2 + (n % 2)]);
+	assert(q2.max() == s[0]);
+
+	for (i = 0; i < n; i++) {
+		snext = q1.nfind(i);
+		sprev = q1.pfind(i);
+		if (i == 0) {
+			assert(snext == s[i + (i % 2)]);
+			assert(sprev == s[0]);
+		} else if (i == n - 1) {
+			if ((n - 1) % 2 == 0)
+				assert(snext == s[i]);
+			else
+				assert(snext == NULL);
+			assert(sprev == s[i - (i % 2)]);
+		} else {
+			assert(snext == s[i + (i % 2)]);
+			assert(sprev == s[i - (i % 2)]);
+		}
+	}
+
+	while (!q1.empty())
+		q1.remove(q1.root());
+
+	typename list2::Iterator it;
+	for (si = it.init(&q2); si != NULL; si = it.next())
+		q2.remove(si);
+	assert(q2.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+/* Objects are generation key * n + position, compares keys only */
+template<typename ValT>
+struct TestSortCompare {
+	TestSortCompare(int n_) : n(n_) { }
+
+	int operator()(const ValT *a, const ValT *b) const {
+		return a->generation() / n - b->generation() / n;
+	}
+
+	int n;
+};
+
+/* Sorted by key and stable, i.e. equal keys keep their positions */
+template<typename HeadT, typename EntryT>
+void test_sort_check(HeadT &q, int n, int count)
+{
+	typedef typename EntryT::list1 list1;
+
+	EntryT *si, *sprev = NULL;
+	int i;
+
+	for (si = q.first(), i = 0; si != NULL; si = si->list1::next(), i++) {
+		if (sprev != NULL) {
+			assert(sprev->generation() / n <= si->generation() / n);
+			assert(sprev->generation() / n < si->generation() / n ||
+			    sprev->generation() < si->generation());
+		}
+		sprev = si;
+	}
+	assert(i == count);
+}
+
+/* Sorts halves of s[] in q1 and q2 and merges q2 into q1 */
+template<typename HeadT, typename EntryT>
+void test_sort_generic(HeadT &q1, HeadT &q2, EntryT *s[], int n)
+{
+	TestSortCompare<EntryT> cmp(n);
+	int i;
+
+	q1.sort(cmp);
+	q1.merge(&q2, cmp);
+	assert(q1.empty());
+	for (i = n - 1; i >= n / 2; i--)
+		q2.insert_head(s[i]);
+	for (; i >= 0; i--)
+		q1.insert_head(s[i]);
+	q1.sort(cmp);
+	test_sort_check<HeadT, EntryT>(q1, n, n / 2);
+	q2.sort(cmp);
+	test_sort_check<HeadT, EntryT>(q2, n, n - n / 2);
+	q1.merge(&q2, cmp);
+	assert(q2.empty());
+	test_sort_check<HeadT, EntryT>(q1, n, n);
+	q1.sort(cmp);
+	test_sort_check<HeadT, EntryT>(q1, n, n);
+	q2.merge(&q1, cmp);
+	assert(q1.empty());
+	test_sort_check<HeadT, EntryT>(q2, n, n);
+}
+
+/* Key of TestSortCompare shifted left, upper bytes must be skipped */
+template<typename ValT>
+struct TestRadixKey {
+	TestRadixKey(int n_, int shift_) : n(n_), shift(shift_) { }
+
+	uint64_t operator()(const ValT *a) const {
+		return (uint64_t)(a->generation() / n) << shift;
+	}
+
+	int n;
+	int shift;
+};
+
+/* Radix sorts s[] in q by keys of different widths, leaves q sorted */
+template<typename HeadT, typename EntryT>
+void test_radix_sort_generic(HeadT &q, EntryT *s[], int n)
+{
+	static const int shifts[] = { 0, 12, 40 };
+	int i, j;
+
+	q.radix_sort(TestRadixKey<EntryT>(n, 0));
+	assert(q.empty());
+	for (j = 0; j < (int)(sizeof(shifts) / sizeof(shifts[0])); j++) {
+		while (!q.empty())
+			q.remove(q.first());
+		for (i = 0; i < n; i++)
+			q.insert_tail(s[i]);
+		q.radix_sort(TestRadixKey<EntryT>(n, shifts[j]));
+		test_sort_check<HeadT, EntryT>(q, n, n);
+	}
+	/* All keys equal, nothing moves */
+	q.radix_sort(TestRadixKey<EntryT>(n * n, 0));
+	test_sort_check<HeadT, EntryT>(q, n, n);
+}
+
+/* Generations in q are gens[0 .. count - 1] */
+template<typename HeadT, typename EntryT>
+void test_splice_check(HeadT &q, const int *gens, int count)
+{
+	typedef typename EntryT::list1 list1;
+
+	EntryT *si;
+	int i;
+
+	for (si = q.first(), i = 0; si != NULL; si = si->list1::next(), i++) {
+		assert(i < count);
+		assert(si->generation() == gens[i]);
+	}
+	assert(i == count);
+}
+
+/* s[i] has generation i + 1, q1 holds all of s[] in order when done */
+template<typename HeadT, typename EntryT>
+void test_splice_generic(HeadT &q1, HeadT &q2, EntryT *s[], int n)
+{
+	int *gens, a, b, i, j;
+
+	gens = new int[n];
+	a = n / 3;
+	b = 2 * n / 3;
+	for (i = n - 1; i >= 0; i--)
+		q1.insert_head(s[i]);
+
+	/* Middle run to the other list */
+	q2.splice_after(NULL, &q1, s[a], s[b]);
+	for (i = 0, j = 0; i < n; i++)
+		if (i < a || i > b)
+			gens[j++] = i + 1;
+	test_splice_check<HeadT, EntryT>(q1, gens, j);
+	for (i = a, j = 0; i <= b; i++)
+		gens[j++] = i + 1;
+	test_splice_check<HeadT, EntryT>(q2, gens, j);
+
+	/* And back */
+	q1.splice_after(a > 0 ? s[a - 1] : NULL, &q2, s[a], s[b]);
+	assert(q2.empty());
+	for (i = 0; i < n; i++)
+		gens[i] = i + 1;
+	test_splice_check<HeadT, EntryT>(q1, gens, n);
+
+	/* Head run behind the tail of the same list */
+	if (a < n - 1) {
+		q1.splice_after(s[n - 1], &q1, s[0], s[a]);
+		for (i = a + 1, j = 0; i < n; i++)
+			gens[j++] = i + 1;
+		for (i = 0; i <= a; i++)
+			gens[j++] = i + 1;
+		test_splice_check<HeadT, EntryT>(q1, gens, n);
+		q1.splice_after(NULL, &q1, s[0], s[a]);
+		for (i = 0; i < n; i++)
+			gens[i] = i + 1;
+		test_splice_check<HeadT, EntryT>(q1, gens, n);
+	}
+
+	/* Single element */
+	q2.splice_after(NULL, &q1, s[b], s[b]);
+	q1.splice_after(b > 0 ? s[b - 1] : NULL, &q2, s[b], s[b]);
+	assert(q2.empty());
+	test_splice_check<HeadT, EntryT>(q1, gens, n);
+
+	delete[] gens;
+}
+
+template<typename ValT>
+struct TestFilterMod {
+	TestFilterMod(int mod_, int rem_) : mod(mod_), rem(rem_) { }
+
+	bool operator()(const ValT *obj) const {
+		return obj->generation() % mod == rem;
+	}
+
+	int mod;
+	int rem;
+};
+
+template<typename ValT>
+struct TestFilterDispose {
+	TestFilterDispose() : count(0) { }
+
+	void operator()(ValT *obj) {
+		count++;
+	}
+
+	int count;
+};
+
+/* Lists have no tail */
+template<typename HeadT, typename ValT>
+void test_filter_last(HeadT &q, ValT *last)
+{
+}
+
+template<typename EntryT, typename ValT>
+void test_filter_last(ecl::TailqHead<EntryT> &q, ValT *last)
+{
+	assert(q.last() == last);
+}
+
+template<typename EntryT, typename ValT>
+void test_filter_last(ecl::STailqHead<EntryT> &q, ValT *last)
+{
+	assert(q.last() == last);
+}
+
+template<typename EntryT, typename HeadT>
+void test_filter_check(HeadT &q, const int *gens, int count)
+{
+	typename HeadT::ObjectType *si, *last = NULL;
+	int i;
+
+	for (si = q.first(), i = 0; si != NULL; si = si->EntryT::next(), i++) {
+		assert(i < count);
+		assert(si->generation() == gens[i]);
+		last = si;
+	}
+	assert(i == count);
+	assert((int)q.size() == count);
+	test_filter_last(q, last);
+}
+
+/*
+ * s[i] has generation i + 1.  partition() moves to the front of lists and
+ * to the tail of queues.
+ */
+template<typename EntryT, typename HeadT, typename ValT>
+void test_filter_generic(HeadT &q1, HeadT &q2, ValT *s[], int n, bool front)
+{
+	TestFilterMod<ValT> mod0(3, 0), mod1(3, 1), odd(2, 1), all(1, 0);
+	TestFilterDispose<ValT> dispose;
+	ValT **out;
+	int *gens, i, j, k, m;
+
+	out = new ValT*[n];
+	gens = new int[n];
+	for (i = n - 1; i >= 0; i--)
+		q1.insert_head(s[i]);
+
+	m = q1.partition(mod0, &q2);
+	assert(m == n / 3);
+	for (i = 1, j = 0; i <= n; i++)
+		if (i % 3 != 0)
+			gens[j++] = i;
+	test_filter_check<EntryT>(q1, gens, j);
+	for (i = 1, j = 0; i <= n; i++)
+		if (i % 3 == 0)
+			gens[j++] = i;
+	test_filter_check<EntryT>(q2, gens, j);
+
+	/* Into a list that isn't empty */
+	m = q1.partition(mod1, &q2);
+	assert(m == (n + 2) / 3);
+	for (k = 0, j = 0; k < 2; k++)
+		for (i = 1; i <= n; i++)
+			if (i % 3 == (front ? 1 - k : k))
+				gens[j++] = i;
+	test_filter_check<EntryT>(q2, gens, j);
+	for (i = 1, j = 0; i <= n; i++)
+		if (i % 3 == 2)
+			gens[j++] = i;
+	test_filter_check<EntryT>(q1, gens, j);
+
+	/* Stops after max objects and leaves the rest linked */
+	k = q1.extract_if(all, out, 2);
+	assert(k == (j < 2 ? j : 2));
+	for (i = 0; i < k; i++)
+		assert(out[i]->generation() == gens[i]);
+	test_filter_check<EntryT>(q1, gens + k, j - k);
+	for (i = k, m = 0; i < j; i++)
+		if (gens[i] % 2 == 0)
+			gens[m++] = gens[i];
+	i = q1.remove_if(odd, dispose);
+	assert(i == j - k - m);
+	test_filter_check<EntryT>(q1, gens, m);
+	i = q1.extract_if(odd, out + k, n);
+	assert(i == 0);
+	i = q1.remove_if(all, dispose);
+	assert(i == m);
+	assert(dispose.count == j - k);
+	test_filter_check<EntryT>(q1, gens, 0);
+	/* Extracted objects can be linked again */
+	if (k > 0) {
+		q1.insert_head(out[0]);
+		assert(q1.first() == out[0] && (int)q1.size() == 1);
+		i = q1.extract_if(all, out, n);
+		assert(i == 1);
+		test_filter_check<EntryT>(q1, gens, 0);
+	}
+
+	/* Removal checks back links */
+	while (!q2.empty())
+		q2.remove(q2.first());
+	test_filter_check<EntryT>(q2, gens, 0);
+
+	delete[] out;
+	delete[] gens;
+}
+
+/* s[i] has generation i + 1, q holds all of s[] in order when done */
+template<typename EntryT, typename HeadT, typename ValT>
+void test_batch_generic(HeadT &q, ValT *s[], int n)
+{
+	int *gens, a, b, i;
+
+	gens = new int[n];
+	for (i = 0; i < n; i++)
+		gens[i] = i + 1;
+	a = n / 3;
+	b = 2 * n / 3;
+
+	q.insert_tail_batch(s, 0);
+	q.insert_head_batch(s, 0);
+	test_filter_check<EntryT>(q, gens, 0);
+	q.insert_tail_batch(s + a, b - a);
+	test_filter_check<EntryT>(q, gens + a, b - a);
+	q.insert_head_batch(s, a);
+	test_filter_check<EntryT>(q, gens, b);
+	q.insert_tail_batch(s + b, n - b);
+	test_filter_check<EntryT>(q, gens, n);
+
+	/* Single objects link to the batches */
+	if (n > 1) {
+		q.remove(s[0]);
+		q.remove(s[n - 1]);
+		q.insert_head(s[0]);
+		q.insert_tail(s[n - 1]);
+	} else if (n == 1) {
+		q.remove(s[0]);
+		q.insert_tail_batch(s, 1);
+	}
+	test_filter_check<EntryT>(q, gens, n);
+
+	delete[] gens;
+}
+
+template<typename EntryT>
+EntryT **test_sort_alloc(int n)
+{
+	EntryT **s;
+	int i;
+
+	s = new EntryT*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new EntryT((int)((int64_t)i * 7919 % (n / 4 + 1)) * n + i);
+	return s;
+}
+
 // }}}
 
 class ValList; // {{{
@@ -185,6 +672,44 @@ void test_basic_list(int n)
 	delete[] s;
 }
 
+void test_sort_list(int n)
+{
+	HeadList1 q1, q2;
+	ValList **s;
+	int i;
+
+	s = test_sort_alloc<ValList>(n);
+	test_sort_generic(q1, q2, s, n);
+	/* Removal checks back links */
+	for (i = 0; i < n; i++)
+		s[i]->list1::remove();
+	assert(q2.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+void test_splice_list(int n)
+{
+	HeadList1 q1, q2;
+	ValList **s;
+	int i;
+
+	s = new ValList*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValList(i + 1);
+	test_splice_generic(q1, q2, s, n);
+	/* Removal checks back links */
+	for (i = n - 1; i >= 0; i--)
+		s[i]->list1::remove();
+	assert(q1.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
 template class ecl::ListEntry<ValList_Entry1, ValList>;
 template class ecl::ListHead<ValList_Entry1>;
 template class ecl::ListHead<ValList_Entry2>;
@@ -310,6 +835,22 @@ void test_basic_slist(int n)
 	delete[] s;
 }
 
+void test_sort_slist(int n)
+{
+	HeadSList1 q1, q2;
+	ValSList **s;
+	int i;
+
+	s = test_sort_alloc<ValSList>(n);
+	test_sort_generic(q1, q2, s, n);
+	while (!q2.empty())
+		q2.remove_head();
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
 template class ecl::SListEntry<ValSList_Entry1, ValSList>;
 template class ecl::SListHead<ValSList_Entry1>;
 template class ecl::SListHead<ValSList_Entry2>;
@@ -485,16 +1026,364 @@ void test_basic_tailq(int n)
 	delete[] s;
 }
 
-template class ecl::TailqEntry<ValTailq_Entry1, ValTailq>;
-template class ecl::TailqHead<ValTailq_Entry1>;
-template class ecl::TailqHead<ValTailq_Entry2>;
-
-// }}}
+void test_sort_tailq(int n)
+{
+	HeadTailq1 q1, q2;
+	ValTailq::list1::ReverseIterator rit;
+	ValTailq **s, *si, *snext;
+	int i;
 
-class ValSTailq; // {{{
+	s = test_sort_alloc<ValTailq>(n);
+	test_sort_generic(q1, q2, s, n);
+	for (si = rit.init(&q2), snext = NULL, i = 0; si != NULL;
+	    snext = si, si = rit.prev(), i++)
+		assert(si->list1::next() == snext);
+	assert(i == n);
+	for (i = 0; i < n; i++)
+		q2.remove(s[i]);
+	assert(q2.empty());
 
-struct ValSTailq_Entry1 : ecl::STailqEntry<ValSTailq_Entry1, ValSTailq> { };
-struct ValSTailq_Entry2 : ecl::STailqEntry<ValSTailq_Entry2, ValSTailq> { };
+	test_radix_sort_generic(q1, s, n);
+	for (si = rit.init(&q1), snext = NULL, i = 0; si != NULL;
+	    snext = si, si = rit.prev(), i++)
+		assert(si->list1::next() == snext);
+	assert(i == n);
+	for (i = 0; i < n; i++)
+		q1.remove(s[i]);
+	assert(q1.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+void test_splice_tailq(int n)
+{
+	HeadTailq1 q1, q2;
+	ValTailq::list1::ReverseIterator rit;
+	ValTailq **s, *si, *snext;
+	int i, a = n / 3, b = 2 * n / 3;
+
+	s = new ValTailq*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValTailq(i + 1);
+	test_splice_generic(q1, q2, s, n);
+
+	q2.splice_tail(&q1, s[a], s[b]);
+	assert(q2.first() == s[a] && q2.last() == s[b]);
+	if (!q1.empty())
+		q2.splice_tail(&q1, q1.first(), q1.last());
+	assert(q1.empty());
+	assert(q2.last() == (b < n - 1 ? s[n - 1] : a > 0 ? s[a - 1] : s[b]));
+	q1.splice_tail(&q2, q2.first(), q2.last());
+	assert(q2.empty());
+	for (si = rit.init(&q1), snext = NULL, i = 0; si != NULL;
+	    snext = si, si = rit.prev(), i++)
+		assert(si->list1::next() == snext);
+	assert(i == n);
+	for (i = 0; i < n; i++)
+		q1.remove(s[i]);
+	assert(q1.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+/* Removes odd generations while scanning */
+struct TestScanTailq {
+	TestScanTailq(HeadTailq1 *q_) : q(q_), last(0), count(0) { }
+
+	void operator()(ValTailq *obj) {
+		assert(obj->generation() > last);
+		last = obj->generation();
+		count++;
+		if (last % 2 == 1)
+			q->remove(obj);
+	}
+
+	HeadTailq1 *q;
+	int last;
+	int count;
+};
+
+struct TestDisposeTailq {
+	TestDisposeTailq() : last(0), count(0) { }
+
+	void operator()(ValTailq *obj) {
+		assert(obj->generation() > last);
+		last = obj->generation();
+		count++;
+	}
+
+	int last;
+	int count;
+};
+
+void test_incremental_tailq(int n, int step)
+{
+	HeadTailq1 q1;
+	TestScanTailq scan(&q1);
+	TestDisposeTailq dispose;
+	ValTailq **s, *cursor = NULL;
+	int i, calls;
+	bool done;
+
+	s = new ValTailq*[n];
+	for (i = 0; i < n; i++) {
+		s[i] = new ValTailq(i + 1);
+		q1.insert_tail(s[i]);
+	}
+
+	for (calls = 1; q1.scan_some(&cursor, step, scan); calls++)
+		assert(cursor != NULL);
+	assert(cursor == NULL);
+	assert(scan.count == n);
+	assert(calls == (n == 0 ? 1 : (n + step - 1) / step));
+	assert((int)q1.size() == n / 2);
+
+	for (calls = 1; !q1.clear_some(step, dispose); calls++)
+		assert((int)q1.size() == n / 2 - calls * step);
+	assert(q1.empty());
+	assert(dispose.count == n / 2);
+	assert(calls == (n / 2 == 0 ? 1 : (n / 2 + step - 1) / step));
+	done = q1.clear_some(step, dispose);
+	assert(done);
+	done = q1.scan_some(&cursor, step, scan);
+	assert(!done);
+	assert(cursor == NULL);
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+template class ecl::TailqEntry<ValTailq_Entry1, ValTailq>;
+template class ecl::TailqHead<ValTailq_Entry1>;
+template class ecl::TailqHead<ValTailq_Entry2>;
+
+// }}}
+
+class ValMarker; // {{{
+
+struct ValMarker_Tailq : ecl::TailqEntry<ValMarker_Tailq, ValMarker> {
+	/* Markers have negative generations */
+	template<typename T>
+	static bool is_marker(const T *obj) {
+		return obj->generation() < 0;
+	}
+};
+
+typedef ecl::TailqHead<ValMarker_Tailq> HeadMarkerTailq;
+
+extern template class ecl::TailqEntry<ValMarker_Tailq, ValMarker>;
+extern template class ecl::TailqHead<ValMarker_Tailq>;
+
+class ValMarker : public ValMarker_Tailq {
+public:
+	typedef ValMarker_Tailq list1;
+
+	ValMarker(int gen_) : gen(gen_) { }
+
+	int generation() const {
+		return gen;
+	}
+
+private:
+	int gen;
+};
+
+/*
+ * Two marker iterators walk q1 in slices while elements around the
+ * markers are removed and added.
+ */
+void test_marker_tailq(int n, int slice)
+{
+	HeadMarkerTailq q1;
+	ValMarker m1(-1), m2(-2);
+	ValMarker::list1::MarkerIterator it1(&m1), it2(&m2);
+	ValMarker::list1::Iterator it;
+	ValMarker::list1::ReverseIterator rit;
+	ValMarker **s, *si, *snext;
+	char *live;
+	int i, last1, last2, count, added;
+
+	s = new ValMarker*[2 * n];
+	live = new char[2 * n];
+	for (i = 0; i < 2 * n; i++) {
+		s[i] = new ValMarker(i + 1);
+		live[i] = i < n;
+	}
+	for (i = 0; i < n; i++)
+		q1.insert_tail(s[i]);
+	added = n;
+
+	last1 = last2 = 0;
+	si = it1.init(&q1);
+	assert(si == s[0]);
+	last1 = 1;
+	while (it1.active() || it2.active()) {
+		for (i = 0; i < slice && it1.active(); i++) {
+			if ((si = it1.next()) == NULL)
+				break;
+			/* Never goes back and never skips a live element */
+			assert(si->generation() > last1);
+			while (++last1 < si->generation())
+				assert(!live[last1 - 1]);
+			if (last1 == n / 2) {
+				si = it2.init(&q1);
+				assert(si != NULL);
+			}
+		}
+		for (i = 0; i < slice && it2.active(); i++) {
+			if ((si = it2.next()) == NULL)
+				break;
+			assert(si->generation() > last2);
+			last2 = si->generation();
+		}
+
+		/* Drop the last returned element and the one after it */
+		if (it1.active()) {
+			q1.remove(s[last1 - 1]);
+			live[last1 - 1] = 0;
+			snext = m1.list1::next();
+			if (snext != NULL && !ValMarker_Tailq::is_marker(snext)) {
+				q1.remove(snext);
+				live[snext->generation() - 1] = 0;
+			}
+		}
+		/* Plain iterators skip parked markers */
+		for (si = it.init(&q1), count = 0; si != NULL; si = it.next())
+			count++;
+		for (si = rit.init(&q1); si != NULL; si = rit.prev())
+			count--;
+		assert(count == 0);
+		if (added < 2 * n) {
+			live[added] = 1;
+			q1.insert_tail(s[added++]);
+		}
+	}
+	assert(!it1.active() && !it2.active());
+	si = it1.next();
+	assert(si == NULL);
+
+	while (!q1.empty())
+		q1.remove(q1.first());
+	it1.init(&q1);
+	assert(!it1.active());
+	assert(q1.empty());
+	q1.insert_tail(s[0]);
+	si = it1.init(&q1);
+	assert(si == s[0]);
+	it1.finish();
+	assert(q1.first() == s[0] && q1.last() == s[0]);
+	q1.remove(s[0]);
+
+	for (i = 0; i < 2 * n; i++)
+		delete s[i];
+	delete[] s;
+	delete[] live;
+}
+
+/* Callbacks must never see a parked marker */
+struct TestVisitMarker {
+	TestVisitMarker() : count(0) { }
+
+	void operator()(ValMarker *obj) {
+		assert(!ValMarker_Tailq::is_marker(obj));
+		count++;
+	}
+
+	int count;
+};
+
+void test_marker_incremental_tailq(int n, int step)
+{
+	HeadMarkerTailq q1;
+	ValMarker m1(-1);
+	ValMarker::list1::MarkerIterator it1(&m1);
+	TestVisitMarker scan, dispose;
+	ValMarker **s, *si, *cursor = NULL;
+	int i;
+
+	s = new ValMarker*[n];
+	for (i = 0; i < n; i++) {
+		s[i] = new ValMarker(i + 1);
+		q1.insert_tail(s[i]);
+	}
+	/* Park the marker in the middle */
+	si = it1.init(&q1);
+	for (i = 1; i < (n + 1) / 2; i++)
+		si = it1.next();
+	assert(si == s[i - 1]);
+
+	while (q1.scan_some(&cursor, step, scan))
+		assert(cursor != &m1);
+	assert(scan.count == n);
+	while (!q1.clear_some(step, dispose))
+		;
+	assert(dispose.count == n);
+	assert(q1.first() == &m1 && q1.last() == &m1);
+	assert(it1.active());
+	si = it1.next();
+	assert(si == NULL);
+	assert(q1.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+void test_marker_filter_tailq(int n)
+{
+	HeadMarkerTailq q1, q2;
+	ValMarker m1(-1);
+	ValMarker::list1::MarkerIterator it1(&m1);
+	TestFilterMod<ValMarker> odd(2, 1), all(1, 0);
+	TestVisitMarker dispose;
+	ValMarker **s, *out[1], *si;
+	int i, k;
+
+	s = new ValMarker*[n];
+	for (i = 0; i < n; i++) {
+		s[i] = new ValMarker(i + 1);
+		q1.insert_tail(s[i]);
+	}
+	si = it1.init(&q1);
+	for (i = 1; i < (n + 1) / 2; i++)
+		si = it1.next();
+	assert(si == s[i - 1]);
+
+	/* The marker matches all but must stay parked */
+	k = q1.partition(odd, &q2);
+	assert(k == (n + 1) / 2);
+	k = q1.extract_if(all, out, 1);
+	assert(k == (n > 1));
+	assert(k == 0 || out[0] == s[1]);
+	k = q1.remove_if(all, dispose);
+	assert(k == n / 2 - (n > 1));
+	assert(dispose.count == k);
+	assert(q1.first() == &m1 && q1.last() == &m1);
+	si = it1.next();
+	assert(si == NULL);
+	assert(q1.empty());
+
+	while (!q2.empty())
+		q2.remove(q2.first());
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+template class ecl::TailqEntry<ValMarker_Tailq, ValMarker>;
+template class ecl::TailqHead<ValMarker_Tailq>;
+
+// }}}
+
+class ValSTailq; // {{{
+
+struct ValSTailq_Entry1 : ecl::STailqEntry<ValSTailq_Entry1, ValSTailq> { };
+struct ValSTailq_Entry2 : ecl::STailqEntry<ValSTailq_Entry2, ValSTailq> { };
 
 typedef ecl::STailqHead<ValSTailq_Entry1> HeadSTailq1;
 typedef ecl::STailqHead<ValSTailq_Entry2> HeadSTailq2;
@@ -621,6 +1510,69 @@ void test_basic_stailq(int n)
 	delete[] s;
 }
 
+void test_sort_stailq(int n)
+{
+	HeadSTailq1 q1, q2;
+	ValSTailq **s, *si;
+	int i;
+
+	s = test_sort_alloc<ValSTailq>(n);
+	test_sort_generic(q1, q2, s, n);
+	for (si = q2.first(); si->list1::next() != NULL;
+	    si = si->list1::next())
+		;
+	assert(q2.last() == si);
+	while (!q2.empty())
+		q2.remove_head();
+	assert(q2.last() == NULL);
+
+	test_radix_sort_generic(q1, s, n);
+	for (si = q1.first(); si->list1::next() != NULL;
+	    si = si->list1::next())
+		;
+	assert(q1.last() == si);
+	while (!q1.empty())
+		q1.remove_head();
+	assert(q1.last() == NULL);
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+void test_splice_stailq(int n)
+{
+	HeadSTailq1 q1, q2;
+	ValSTailq **s, *si;
+	int i, a = n / 3, b = 2 * n / 3;
+
+	s = new ValSTailq*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValSTailq(i + 1);
+	test_splice_generic(q1, q2, s, n);
+	assert(q1.last() == s[n - 1]);
+
+	q2.splice_tail(&q1, a > 0 ? s[a - 1] : NULL, s[a], s[b]);
+	assert(q2.first() == s[a] && q2.last() == s[b]);
+	assert(q1.last() == (b < n - 1 ? s[n - 1] : a > 0 ? s[a - 1] : NULL));
+	if (!q1.empty())
+		q2.splice_after(NULL, &q1, NULL, q1.first(), q1.last());
+	assert(q1.empty() && q1.last() == NULL);
+	q1.splice_tail(&q2, q2.first(), q2.last());
+	assert(q2.empty() && q2.last() == NULL);
+	for (si = q1.first(), i = 0; si->list1::next() != NULL;
+	    si = si->list1::next(), i++)
+		;
+	assert(q1.last() == si);
+	assert(i == n - 1);
+	while (!q1.empty())
+		q1.remove_head();
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
 template class ecl::STailqEntry<ValSTailq_Entry1, ValSTailq>;
 template class ecl::STailqHead<ValSTailq_Entry1>;
 template class ecl::STailqHead<ValSTailq_Entry2>;
@@ -635,6 +1587,11 @@ struct ValRBTree_Entry1 : ecl::RBTreeEntry<ValRBTree_Entry1, ValRBTree> {
 		return compare_key_fn(a->gen, b);
 	}
 
+	template<typename T>
+	static int key_fn(const T *obj) {
+		return obj->gen;
+	}
+
 	template<typename T>
 	static int compare_key_fn(int key, const T *obj) {
 		if (key > obj->gen)
@@ -686,125 +1643,2670 @@ private:
 	int gen;
 };
 
-void test_basic_rbtree(int n)
+void test_frozen_rbtree(int n)
 {
-	ValRBTree **s, *si, *sprev, *snext;
-	const ValRBTree *sc;
+	ecl::RBTreeFrozen<ValRBTree_Entry1, int> f;
+	ValRBTree **s;
 	HeadRBTree1 q1;
-	HeadRBTree2 q2;
-	const HeadRBTree1 *q1c = &q1;
 	int i;
 
+	assert(f.empty());
+	assert(f.find(0) == NULL);
+	assert(f.nfind(0) == NULL);
+	assert(f.pfind(0) == NULL);
+
 	s = new ValRBTree*[n];
 	for (i = 0; i < n; i++)
-		s[i] = new ValRBTree(i);
-
-	for (i = 0; i < n; i+=2) {
-		q1.insert(s[i]);
-		q2.insert(s[i]);
-	}
-	for (i = 1; i < n; i+=2) {
+		s[i] = new ValRBTree(i * 2);
+	for (i = 0; i < n; i++)
 		q1.insert(s[i]);
-		q2.insert(s[i]);
+
+	f.freeze(&q1);
+	assert((int)f.size() == n);
+	assert(f.min() == q1.min());
+	assert(f.max() == q1.max());
+	for (i = -1; i <= 2 * n; i++) {
+		assert(f.find(i) == q1.find(i));
+		assert(f.nfind(i) == q1.nfind(i));
+		assert(f.pfind(i) == q1.pfind(i));
 	}
 
-	assert(q1.min() == s[0]);
-	assert(q1.max() == s[n - 1]);
-	assert(q2.min() == s[n - 1]);
-	assert(q2.max() == s[0]);
+	while (!q1.empty())
+		q1.remove(q1.root());
+	f.freeze(&q1);
+	assert(f.empty());
+	assert(f.min() == NULL);
 
-	for (si = q1.first(), i = 0; si != NULL; si = si->list1::next(), i++) {
-		assert(i < n);
-		assert(si == s[i]);
-		if (i > 0)
-			assert(si->list1::prev() == s[i - 1]);
-		if (i + 1 < n)
-			assert(si->list1::next() == s[i + 1]);
-		else
-			assert(si->list1::next() == NULL);
-	}
-	assert(i == n);
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
 
-	ValRBTree::list2::ReverseIterator rit;
-	for (si = rit.init(&q2), i = 0; si != NULL; si = rit.prev(), i++) {
-		assert(si == s[i]);
-	}
+template<typename KeyT>
+void test_bptree(int n)
+{
+	ecl::BPTreeHead<ValRBTree_Entry1, KeyT> q;
+	typename ecl::BPTreeHead<ValRBTree_Entry1, KeyT>::Iterator it;
+	typename ecl::BPTreeHead<ValRBTree_Entry1, KeyT>::ReverseIterator rit;
+	ValRBTree **s, *si, *sa, *sb, odd(1);
+	HeadRBTree1 q1;
+	int i, j, k;
 
-	for (i = 0; i < n; i++) {
-		assert(q1.find(i) == s[i]);
-		assert(q2.find(i) == s[i]);
+	assert(q.empty());
+	assert(q.first() == NULL);
+	assert(q.find(0) == NULL);
+	assert(q.nfind(0) == NULL);
+	assert(q.pfind(0) == NULL);
+	assert(it.init(&q) == NULL);
+	assert(rit.init(&q) == NULL);
+
+	s = new ValRBTree*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValRBTree(i * 2);
+
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < n; i++) {
+			si = s[(i * 7919) % n];
+			sa = q.insert(si);
+			sb = q1.insert(si);
+			assert(sa == sb);
+		}
+		si = q.insert(s[0]);
+		assert(si == s[0]);
+		assert(q.size() == (size_t)n);
+		assert(q.min() == q1.min());
+		assert(q.max() == q1.max());
+		for (i = -1; i <= 2 * n; i++) {
+			assert(q.find(i) == q1.find(i));
+			assert(q.nfind(i) == q1.nfind(i));
+			assert(q.pfind(i) == q1.pfind(i));
+		}
+		for (si = it.init(&q), i = 0; si != NULL; si = it.next(), i++)
+			assert(si == s[i]);
+		assert(i == n);
+		for (si = rit.init(&q), i = n; si != NULL; si = rit.prev())
+			assert(si == s[--i]);
+		assert(i == 0);
+		for (si = it.init(&q, 2 * (n / 2) - 1), i = n / 2; si != NULL;
+		    si = it.next(), i++)
+			assert(si == s[i]);
+		assert(i == n);
+
+		/* Remove a different subset each round */
+		for (i = 0, k = n; i < n; i++) {
+			si = s[(i * 7919) % n];
+			if ((i + j) % 3 == 0)
+				continue;
+			sa = q.remove(si);
+			assert(sa == si);
+			q1.remove(si);
+			k--;
+		}
+		si = q.remove(&odd);
+		assert(si == NULL);
+		/* Removal is by identity, not by key */
+		if (!q.empty()) {
+			ValRBTree twin(q.first()->generation());
+
+			si = q.remove(&twin);
+			assert(si == NULL);
+			assert(q.find(twin.generation()) == q1.min());
+		}
+		assert(q.size() == (size_t)k);
+		for (i = -1; i <= 2 * n; i++) {
+			assert(q.find(i) == q1.find(i));
+			assert(q.nfind(i) == q1.nfind(i));
+			assert(q.pfind(i) == q1.pfind(i));
+		}
+		for (si = it.init(&q), i = 0; si != NULL; si = it.next(), i++)
+			assert(si == q1.find(si->generation()));
+		assert(i == (int)q.size());
+		while (!q1.empty()) {
+			si = q1.root();
+			sa = q.remove(si);
+			sb = q1.remove(si);
+			assert(sa == sb && sa == si);
+		}
+		assert(q.empty());
+		assert(q.first() == NULL);
 	}
 
-	for (i = 0, sc = q1c->first(); sc != NULL; sc = sc->list1::next())
-		i += sc->generation();
-	assert(i == n * (n - 1) / 2); // start at 0
-	ValRBTree::list1::ConstIterator cit;
-	for (i = 0, sc = cit.init(q1c); sc != NULL; sc = cit.next())
-		i += sc->generation();
-	assert(i == n * (n - 1) / 2); // start at 0
-	ValRBTree::list1::ConstReverseIterator crit;
-	for (i = 0, sc = crit.init(q1c); sc != NULL; sc = crit.prev())
-		i += sc->generation();
-	assert(i == n * (n - 1) / 2); // start at 0
+	for (i = 0; i < n; i++)
+		q.insert(s[i]);
+	q.clear();
+	assert(q.empty());
+	assert(q.find(0) == NULL);
 
-	sc = q1c->find(n / 2);
-	assert(sc == s[n / 2]);
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
 
-	for (i = 0; i < n; i+=2) {
-		q1.remove(s[i]);
-		q2.remove(s[i]);
-	}
-	for (i = 1; i < n; i+=2) {
-		q1.remove(s[i]);
-		q2.remove(s[i]);
+struct SeqRBTreeArg {
+	ecl::RBTreeSeqHead<ValRBTree_Entry1> *q;
+	ValRBTree **s;
+	int n;
+	int done;
+};
+
+static void *
+test_seq_rbtree_reader(void *xarg)
+{
+	SeqRBTreeArg *arg = (SeqRBTreeArg *)xarg;
+	ValRBTree *si;
+	int i;
+
+	while (!__atomic_load_n(&arg->done, __ATOMIC_ACQUIRE)) {
+		for (i = 0; i < arg->n; i++) {
+			si = arg->q->find(i);
+			if (i % 2 == 0)
+				assert(si == arg->s[i]);
+			else
+				assert(si == NULL || si == arg->s[i]);
+			si = arg->q->nfind(i);
+			assert(si == arg->s[i] || si == arg->s[i + i % 2]);
+			si = arg->q->pfind(i);
+			assert(si == arg->s[i] || si == arg->s[i - i % 2]);
+		}
 	}
-	assert(q1.empty());
-	assert(q2.empty());
+	return NULL;
+}
 
-	for (i = 0; i < n; i += 2) {
-		q1.insert(s[i]);
-		q2.insert(s[i]);
+void test_seq_rbtree(int n, int nreaders, int niter)
+{
+	ecl::RBTreeSeqHead<ValRBTree_Entry1> q;
+	pthread_t *tids;
+	SeqRBTreeArg arg;
+	ValRBTree **s, *si;
+	int i, j;
+
+	/* One extra element so nfind() of the last odd key stays valid */
+	n += (n % 2 == 0);
+	s = new ValRBTree*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValRBTree(i);
+	for (i = 0; i < n; i++)
+		q.insert(s[i]);
+
+	for (i = 0; i < n; i++)
+		assert(q.find(i) == s[i]);
+	assert(q.find(n) == NULL);
+	assert(q.nfind(-1) == s[0]);
+	assert(q.pfind(n) == s[n - 1]);
+
+	arg.q = &q;
+	arg.s = s;
+	arg.n = n - 1;
+	arg.done = 0;
+	tids = new pthread_t[nreaders];
+	for (i = 0; i < nreaders; i++)
+		pthread_create(&tids[i], NULL, test_seq_rbtree_reader, &arg);
+
+	for (j = 0; j < niter; j++) {
+		for (i = 1; i < n; i += 2)
+			q.remove(s[i]);
+		for (i = n - 2; i > 0; i -= 2)
+			q.insert(s[i]);
 	}
 
-	assert(q1.min() == s[0]);
-	assert(q1.max() == s[n - 2 + (n % 2)]);
-	assert(q2.min() == s[n - 2 + (n % 2)]);
-	assert(q2.max() == s[0]);
+	__atomic_store_n(&arg.done, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < nreaders; i++)
+		pthread_join(tids[i], NULL);
+	delete[] tids;
 
 	for (i = 0; i < n; i++) {
-		snext = q1.nfind(i);
-		sprev = q1.pfind(i);
-		if (i == 0) {
-			assert(snext == s[i + (i % 2)]);
-			assert(sprev == s[0]);
-		} else if (i == n - 1) {
-			if ((n - 1) % 2 == 0)
-				assert(snext == s[i]);
+		si = q.remove(s[i]);
+		assert(si == s[i]);
+	}
+	assert(q.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+typedef ecl::RBTreeShardHead<ValRBTree_Entry1, int> ShardRBTree1;
+
+struct ShardRBTreeArg {
+	ShardRBTree1 *q;
+	ValRBTree **s;
+	int from;
+	int to;
+};
+
+static void *
+test_shard_rbtree_writer(void *xarg)
+{
+	ShardRBTreeArg *arg = (ShardRBTreeArg *)xarg;
+	ValRBTree *si;
+	int i;
+
+	for (i = arg->from; i < arg->to; i++) {
+		si = arg->q->insert(arg->s[i]);
+		assert(si == NULL);
+	}
+	for (i = arg->from; i < arg->to; i++)
+		assert(arg->q->find(i) == arg->s[i]);
+	arg->q->rebalance(16);
+	return NULL;
+}
+
+void test_shard_rbtree(int n, int nthreads)
+{
+	const int nshards = 4;
+	int bounds[nshards - 1];
+	ShardRBTreeArg *args;
+	ShardRBTree1::Iterator it;
+	pthread_t *tids;
+	ValRBTree **s, *si;
+	int i;
+
+	/* Everything lands in the last shard */
+	for (i = 0; i < nshards - 1; i++)
+		bounds[i] = -nshards + i;
+	ShardRBTree1 q(nshards, bounds);
+
+	s = new ValRBTree*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValRBTree(i * 2);
+
+	assert(q.empty());
+	assert(q.first() == NULL);
+	assert(q.nfind(0) == NULL);
+	assert(q.pfind(0) == NULL);
+
+	for (i = 0; i < n; i++) {
+		si = q.insert(s[i]);
+		assert(si == NULL);
+	}
+	si = q.insert(s[0]);
+	assert(si == s[0]);
+	assert((int)q.shard_size(nshards - 1) == n);
+
+	while (q.rebalance(n / 3 + 1) != 0)
+		;
+	for (i = 0; i < nshards; i++)
+		assert((int)q.shard_size(i) >= n / nshards - 1);
+
+	for (si = it.init(&q), i = 0; si != NULL; si = it.next(), i++)
+		assert(si == s[i]);
+	assert(i == n);
+	assert(q.first() == s[0]);
+	assert(q.last() == s[n - 1]);
+	for (i = 0; i < n; i++) {
+		assert(q.find(i * 2) == s[i]);
+		assert(q.find(i * 2 + 1) == NULL);
+		assert(q.nfind(i * 2 - 1) == s[i]);
+		assert(q.pfind(i * 2 + 1) == s[i]);
+	}
+	assert(q.nfind(n * 2) == NULL);
+	assert(q.pfind(-1) == NULL);
+
+	for (i = 0; i < n; i++) {
+		si = q.remove(s[i]);
+		assert(si == s[i]);
+	}
+	assert(q.empty());
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+
+	/* Concurrent writers */
+	s = new ValRBTree*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValRBTree(i);
+	args = new ShardRBTreeArg[nthreads];
+	tids = new pthread_t[nthreads];
+	for (i = 0; i < nthreads; i++) {
+		args[i].q = &q;
+		args[i].s = s;
+		args[i].from = n * i / nthreads;
+		args[i].to = n * (i + 1) / nthreads;
+		pthread_create(&tids[i], NULL, test_shard_rbtree_writer, &args[i]);
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tids[i], NULL);
+	for (si = it.init(&q), i = 0; si != NULL; si = it.next(), i++)
+		assert(si == s[i]);
+	assert(i == n);
+	for (i = 0; i < n; i++)
+		q.remove(s[i]);
+	assert(q.empty());
+
+	delete[] tids;
+	delete[] args;
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+struct ParallelRBTreeVisitor {
+	int *visited;
+	long sum;
+
+	void operator()(ValRBTree *obj) {
+		__atomic_add_fetch(&visited[obj->generation()], 1,
+		    __ATOMIC_RELAXED);
+		__atomic_add_fetch(&sum, obj->generation(), __ATOMIC_RELAXED);
+	}
+};
+
+void test_parallel_rbtree(int n, int nthreads)
+{
+	ParallelRBTreeVisitor v;
+	ValRBTree **s;
+	HeadRBTree1 q1;
+	int i;
+
+	s = new ValRBTree*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValRBTree(i);
+	for (i = 0; i < n; i++)
+		q1.insert(s[i]);
+
+	v.visited = new int[n];
+	for (i = 0; i < n; i++)
+		v.visited[i] = 0;
+	v.sum = 0;
+	ecl::parallel_for_each(&q1, v, nthreads);
+	for (i = 0; i < n; i++)
+		assert(v.visited[i] == 1);
+	assert(v.sum == (long)n * (n - 1) / 2);
+	delete[] v.visited;
+
+	while (!q1.empty())
+		q1.remove(q1.root());
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+/* Random inserts and deletes leave nodes with a single child */
+void test_parallel_random_rbtree(int n, int nthreads, int niter)
+{
+	ParallelRBTreeVisitor v;
+	ValRBTree **s;
+	HeadRBTree1 q1;
+	char *present;
+	long sum;
+	int i, k, iter;
+
+	s = new ValRBTree*[n];
+	present = new char[n];
+	v.visited = new int[n];
+	for (i = 0; i < n; i++) {
+		s[i] = new ValRBTree(i);
+		present[i] = 0;
+	}
+	for (iter = 0; iter < niter; iter++) {
+		for (k = 0; k < n; k++) {
+			i = random() % n;
+			if (present[i])
+				q1.remove(s[i]);
+			else
+				q1.insert(s[i]);
+			present[i] = !present[i];
+		}
+		for (i = 0, sum = 0; i < n; i++) {
+			v.visited[i] = 0;
+			if (present[i])
+				sum += i;
+		}
+		v.sum = 0;
+		ecl::parallel_for_each(&q1, v, nthreads);
+		for (i = 0; i < n; i++)
+			assert(v.visited[i] == present[i]);
+		assert(v.sum == sum);
+	}
+
+	while (!q1.empty())
+		q1.remove(q1.root());
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+	delete[] present;
+	delete[] v.visited;
+}
+
+struct TestScanRBTree {
+	TestScanRBTree() : last(-1), count(0) { }
+
+	void operator()(ValRBTree *obj) {
+		assert(obj->generation() > last);
+		last = obj->generation();
+		count++;
+	}
+
+	int last;
+	int count;
+};
+
+struct TestDisposeRBTree {
+	TestDisposeRBTree(char *gone_) : gone(gone_), count(0) { }
+
+	void operator()(ValRBTree *obj) {
+		assert(!gone[obj->generation()]);
+		gone[obj->generation()] = 1;
+		count++;
+	}
+
+	char *gone;
+	int count;
+};
+
+void test_incremental_rbtree(int n, int step)
+{
+	HeadRBTree1 q1, q2;
+	TestScanRBTree scan;
+	TestDisposeRBTree dup(NULL), dispose(NULL);
+	ValRBTree **s, **t, *cursor = NULL;
+	char *gone;
+	int i, k, nt;
+	bool done;
+
+	nt = n / 4;
+	s = new ValRBTree*[n];
+	t = new ValRBTree*[nt];
+	gone = new char[n];
+	for (i = 0; i < n; i++) {
+		s[i] = new ValRBTree(i);
+		q1.insert(s[i]);
+		gone[i] = 0;
+	}
+	for (i = 0; i < nt; i++) {
+		t[i] = new ValRBTree(i * 2);
+		q2.insert(t[i]);
+	}
+
+	/* Collisions go to dup, old elements keep their place */
+	dup.gone = gone;
+	while (!q2.rebuild_step(&q1, step, dup))
+		assert(!q1.empty());
+	assert(q1.empty());
+	assert(dup.count == nt);
+	for (i = 0; i < n; i++)
+		gone[i] = 0;
+	for (i = 0; i < nt; i++)
+		assert(q2.find(i * 2) == t[i]);
+
+	while (q2.scan_some(&cursor, step, scan))
+		;
+	assert(scan.count == n);
+	assert((int)q2.size() == n);
+
+	/* Remaining elements can be found between steps */
+	dispose.gone = gone;
+	while (!q2.clear_some(step, dispose)) {
+		if (n > 100)
+			continue;
+		for (k = 0; k < n; k++)
+			assert((q2.find(k) == NULL) == (gone[k] != 0));
+	}
+	assert(q2.empty());
+	assert(dispose.count == n);
+	done = q2.clear_some(step, dispose);
+	assert(done);
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	for (i = 0; i < nt; i++)
+		delete t[i];
+	delete[] s;
+	delete[] t;
+	delete[] gone;
+}
+
+template class ecl::RBTreeEntry<ValRBTree_Entry1, ValRBTree>;
+template class ecl::RBTreeHead<ValRBTree_Entry1>;
+template class ecl::RBTreeHead<ValRBTree_Entry2>;
+template class ecl::RBTreeFrozen<ValRBTree_Entry1, int>;
+
+// }}}
+
+class ValCount; // {{{
+
+struct ValCount_List;
+struct ValCount_SList;
+struct ValCount_Tailq;
+struct ValCount_STailq;
+struct ValCount_RBTree;
+
+namespace ecl {
+template<> struct ListPolicy<ValCount_List> :
+    policy::Counting<policy::List::Debug> { };
+template<> struct SListPolicy<ValCount_SList> :
+    policy::Counting<policy::SList::Debug> { };
+template<> struct TailqPolicy<ValCount_Tailq> :
+    policy::Counting<policy::Tailq::Debug> { };
+template<> struct STailqPolicy<ValCount_STailq> :
+    policy::Counting<policy::STailq::Debug> { };
+template<> struct RBTreePolicy<ValCount_RBTree> :
+    policy::Counting<policy::RBTree::Default> { };
+}
+
+struct ValCount_List : ecl::ListEntry<ValCount_List, ValCount> { };
+struct ValCount_SList : ecl::SListEntry<ValCount_SList, ValCount> { };
+struct ValCount_Tailq : ecl::TailqEntry<ValCount_Tailq, ValCount> { };
+struct ValCount_STailq : ecl::STailqEntry<ValCount_STailq, ValCount> { };
+struct ValCount_RBTree : ecl::RBTreeEntry<ValCount_RBTree, ValCount> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		if (key > obj->gen)
+			return -1;
+		else if (key < obj->gen)
+			return 1;
+		return 0;
+	}
+};
+
+typedef ecl::ListHead<ValCount_List> HeadCountList;
+typedef ecl::SListHead<ValCount_SList> HeadCountSList;
+typedef ecl::TailqHead<ValCount_Tailq> HeadCountTailq;
+typedef ecl::STailqHead<ValCount_STailq> HeadCountSTailq;
+typedef ecl::RBTreeHead<ValCount_RBTree> HeadCountRBTree;
+
+class ValCount : public ValCount_List, public ValCount_SList,
+    public ValCount_Tailq, public ValCount_STailq, public ValCount_RBTree {
+public:
+	friend struct ValCount_RBTree;
+
+	ValCount(int gen_) : gen(gen_) { }
+
+	int generation() const {
+		return gen;
+	}
+
+private:
+	int gen;
+};
+
+/* size() agrees with the number of elements reachable from the head */
+template<typename EntryT, typename HeadT>
+void test_count_check(HeadT &q, size_t count)
+{
+	ValCount *si;
+	size_t n = 0;
+
+	for (si = q.first(); si != NULL; si = si->EntryT::next())
+		n++;
+	assert(n == count);
+	assert(q.size() == count);
+}
+
+void test_count_list(ValCount **s, int n)
+{
+	TestSortCompare<ValCount> cmp(1);
+	HeadCountList q1, q2;
+	int i;
+
+	q1.insert_head(s[0]);
+	for (i = 1; i < n; i++) {
+		if (i % 2 == 0)
+			q1.insert_after(s[0], s[i]);
+		else
+			q1.insert_before(s[0], s[i]);
+	}
+	test_count_check<ValCount_List>(q1, n);
+	/* s[0] is in the middle */
+	q2.splice_after(NULL, &q1, q1.first(), s[0]);
+	test_count_check<ValCount_List>(q1, n - n / 2 - 1);
+	test_count_check<ValCount_List>(q2, n / 2 + 1);
+	q1.sort(cmp);
+	q2.sort(cmp);
+	q1.merge(&q2, cmp);
+	test_count_check<ValCount_List>(q1, n);
+	test_count_check<ValCount_List>(q2, 0);
+	q1.swap(&q2);
+	test_count_check<ValCount_List>(q1, 0);
+	test_count_check<ValCount_List>(q2, n);
+	for (i = 0; i < n; i++)
+		q2.remove(s[i]);
+	test_count_check<ValCount_List>(q2, 0);
+}
+
+void test_count_slist(ValCount **s, int n)
+{
+	TestSortCompare<ValCount> cmp(1);
+	HeadCountSList q1, q2;
+	int i;
+
+	q1.insert_head(s[0]);
+	for (i = 1; i < n; i++)
+		q1.insert_after(s[0], s[i]);
+	test_count_check<ValCount_SList>(q1, n);
+	if (n > 1) {
+		/* Inserted last */
+		q1.remove_after(s[0]);
+		q2.insert_head(s[n - 1]);
+	}
+	q1.remove(s[0]);
+	q2.insert_head(s[0]);
+	test_count_check<ValCount_SList>(q1, n - (n > 1 ? 2 : 1));
+	test_count_check<ValCount_SList>(q2, n > 1 ? 2 : 1);
+	q1.sort(cmp);
+	q2.sort(cmp);
+	q2.merge(&q1, cmp);
+	test_count_check<ValCount_SList>(q1, 0);
+	q1.swap(&q2);
+	test_count_check<ValCount_SList>(q1, n);
+	test_count_check<ValCount_SList>(q2, 0);
+	while (!q1.empty())
+		q1.remove_head();
+	test_count_check<ValCount_SList>(q1, 0);
+}
+
+void test_count_tailq(ValCount **s, int n)
+{
+	TestSortCompare<ValCount> cmp(1);
+	HeadCountTailq q1, q2;
+	int i;
+
+	q1.insert_head(s[0]);
+	for (i = 1; i < n; i++) {
+		switch (i % 4) {
+		case 0: q1.insert_head(s[i]); break;
+		case 1: q1.insert_tail(s[i]); break;
+		case 2: q1.insert_after(s[0], s[i]); break;
+		case 3: q1.insert_before(s[0], s[i]); break;
+		}
+	}
+	test_count_check<ValCount_Tailq>(q1, n);
+	q2.splice_tail(&q1, q1.first(), s[0]);
+	test_count_check<ValCount_Tailq>(q1, n - q2.size());
+	if (!q1.empty())
+		q2.splice_after(NULL, &q1, q1.first(), q1.first());
+	test_count_check<ValCount_Tailq>(q1, n - q2.size());
+	q1.concat(&q2);
+	test_count_check<ValCount_Tailq>(q1, n);
+	test_count_check<ValCount_Tailq>(q2, 0);
+	q2.splice_tail(&q1, s[0], s[0]);
+	q1.sort(cmp);
+	q2.merge(&q1, cmp);
+	test_count_check<ValCount_Tailq>(q2, n);
+	q1.swap(&q2);
+	test_count_check<ValCount_Tailq>(q1, n);
+	test_count_check<ValCount_Tailq>(q2, 0);
+	for (i = 0; i < n; i++)
+		q1.remove(s[i]);
+	test_count_check<ValCount_Tailq>(q1, 0);
+}
+
+void test_count_stailq(ValCount **s, int n)
+{
+	TestSortCompare<ValCount> cmp(1);
+	HeadCountSTailq q1, q2;
+	int i;
+
+	q1.insert_head(s[0]);
+	for (i = 1; i < n; i++) {
+		switch (i % 3) {
+		case 0: q1.insert_head(s[i]); break;
+		case 1: q1.insert_tail(s[i]); break;
+		case 2: q1.insert_after(s[0], s[i]); break;
+		}
+	}
+	test_count_check<ValCount_STailq>(q1, n);
+	q2.splice_tail(&q1, q1.first(), s[0]);
+	test_count_check<ValCount_STailq>(q1, n - q2.size());
+	if (!q1.empty())
+		q2.splice_after(NULL, &q1, NULL, q1.first(), q1.first());
+	test_count_check<ValCount_STailq>(q1, n - q2.size());
+	q1.concat(&q2);
+	test_count_check<ValCount_STailq>(q1, n);
+	test_count_check<ValCount_STailq>(q2, 0);
+	q2.splice_tail(&q1, s[0], s[0]);
+	q1.sort(cmp);
+	q2.merge(&q1, cmp);
+	test_count_check<ValCount_STailq>(q2, n);
+	q1.swap(&q2);
+	test_count_check<ValCount_STailq>(q2, 0);
+	if (n > 1)
+		q1.remove_after(q1.first());
+	q1.remove(q1.last());
+	test_count_check<ValCount_STailq>(q1, n > 1 ? n - 2 : 0);
+	while (!q1.empty())
+		q1.remove_head();
+	test_count_check<ValCount_STailq>(q1, 0);
+}
+
+void test_count_rbtree(ValCount **s, int n)
+{
+	HeadCountRBTree q1;
+	ValCount *si;
+	size_t count;
+	int i;
+
+	for (i = 0; i < n; i++)
+		q1.insert(s[i]);
+	assert(q1.size() == (size_t)n);
+	si = q1.insert(s[n / 2]);
+	assert(si == s[n / 2]);
+	assert(q1.size() == (size_t)n);
+	for (i = 0; i < n; i += 2)
+		q1.remove(s[i]);
+	for (si = q1.first(), count = 0; si != NULL;
+	    si = si->ValCount_RBTree::next())
+		count++;
+	assert(q1.size() == count);
+	assert(count == (size_t)n / 2);
+	for (i = 1; i < n; i += 2)
+		q1.remove(s[i]);
+	assert(q1.size() == 0);
+}
+
+void test_counting(int n)
+{
+	ValCount **s;
+	int i;
+
+	/* Heads without counting don't grow */
+	assert(sizeof(HeadList1) == sizeof(void *));
+	assert(sizeof(HeadSList1) == sizeof(void *));
+	assert(sizeof(HeadTailq1) == 2 * sizeof(void *));
+	assert(sizeof(HeadSTailq1) == 2 * sizeof(void *));
+	assert(sizeof(HeadRBTree1) == sizeof(void *));
+	assert(sizeof(HeadCountTailq) == 2 * sizeof(void *) + sizeof(size_t));
+
+	s = new ValCount*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValCount(i + 1);
+	test_count_list(s, n);
+	test_count_slist(s, n);
+	test_count_tailq(s, n);
+	test_count_stailq(s, n);
+	test_count_rbtree(s, n);
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+/* With and without counting */
+void test_filter(int n)
+{
+	ValList **sl;
+	ValSList **ss;
+	ValTailq **st;
+	ValSTailq **sst;
+	ValCount **s;
+	int i;
+
+	sl = new ValList*[n];
+	ss = new ValSList*[n];
+	st = new ValTailq*[n];
+	sst = new ValSTailq*[n];
+	s = new ValCount*[n];
+	for (i = 0; i < n; i++) {
+		sl[i] = new ValList(i + 1);
+		ss[i] = new ValSList(i + 1);
+		st[i] = new ValTailq(i + 1);
+		sst[i] = new ValSTailq(i + 1);
+		s[i] = new ValCount(i + 1);
+	}
+	{
+		HeadList1 q1, q2;
+		test_filter_generic<ValList_Entry1>(q1, q2, sl, n, true);
+	}
+	{
+		HeadSList1 q1, q2;
+		test_filter_generic<ValSList_Entry1>(q1, q2, ss, n, true);
+	}
+	{
+		HeadTailq1 q1, q2;
+		test_filter_generic<ValTailq_Entry1>(q1, q2, st, n, false);
+	}
+	{
+		HeadSTailq1 q1, q2;
+		test_filter_generic<ValSTailq_Entry1>(q1, q2, sst, n, false);
+	}
+	{
+		HeadCountList q1, q2;
+		test_filter_generic<ValCount_List>(q1, q2, s, n, true);
+	}
+	{
+		HeadCountSList q1, q2;
+		test_filter_generic<ValCount_SList>(q1, q2, s, n, true);
+	}
+	{
+		HeadCountTailq q1, q2;
+		test_filter_generic<ValCount_Tailq>(q1, q2, s, n, false);
+	}
+	{
+		HeadCountSTailq q1, q2;
+		test_filter_generic<ValCount_STailq>(q1, q2, s, n, false);
+	}
+
+	for (i = 0; i < n; i++) {
+		delete sl[i];
+		delete ss[i];
+		delete st[i];
+		delete sst[i];
+		delete s[i];
+	}
+	delete[] sl;
+	delete[] ss;
+	delete[] st;
+	delete[] sst;
+	delete[] s;
+}
+
+void test_batch(int n)
+{
+	ValTailq **st;
+	ValSTailq **sst;
+	ValCount **s;
+	int i;
+
+	st = new ValTailq*[n];
+	sst = new ValSTailq*[n];
+	s = new ValCount*[n];
+	for (i = 0; i < n; i++) {
+		st[i] = new ValTailq(i + 1);
+		sst[i] = new ValSTailq(i + 1);
+		s[i] = new ValCount(i + 1);
+	}
+	{
+		HeadTailq1 q;
+		test_batch_generic<ValTailq_Entry1>(q, st, n);
+		while (!q.empty())
+			q.remove(q.last());
+	}
+	{
+		HeadSTailq1 q;
+		test_batch_generic<ValSTailq_Entry1>(q, sst, n);
+		while (!q.empty())
+			q.remove_head();
+	}
+	{
+		HeadCountTailq q;
+		test_batch_generic<ValCount_Tailq>(q, s, n);
+		while (!q.empty())
+			q.remove(q.first());
+	}
+	{
+		HeadCountSTailq q;
+		test_batch_generic<ValCount_STailq>(q, s, n);
+		while (!q.empty())
+			q.remove_head();
+	}
+
+	for (i = 0; i < n; i++) {
+		delete st[i];
+		delete sst[i];
+		delete s[i];
+	}
+	delete[] st;
+	delete[] sst;
+	delete[] s;
+}
+
+template class ecl::ListHead<ValCount_List>;
+template class ecl::SListHead<ValCount_SList>;
+template class ecl::TailqHead<ValCount_Tailq>;
+template class ecl::STailqHead<ValCount_STailq>;
+template class ecl::RBTreeHead<ValCount_RBTree>;
+
+// }}}
+
+// {{{ algorithm
+
+template<typename ValT>
+struct TestAlgoSum {
+	TestAlgoSum() : sum(0) { }
+
+	void operator()(ValT *obj) {
+		sum += obj->generation();
+	}
+
+	int sum;
+};
+
+template<typename ValT>
+struct TestAlgoEqual {
+	TestAlgoEqual(int gen_) : gen(gen_) { }
+
+	bool operator()(const ValT *obj) const {
+		return obj->generation() == gen;
+	}
+
+	int gen;
+};
+
+template<typename ValT>
+struct TestAlgoEven {
+	bool operator()(const ValT *obj) const {
+		return obj->generation() % 2 == 0;
+	}
+};
+
+struct TestAlgoRemove {
+	TestAlgoRemove(HeadTailq1 *q_) : q(q_) { }
+
+	void operator()(ValTailq *obj) {
+		q->remove(obj);
+	}
+
+	HeadTailq1 *q;
+};
+
+/* q holds objects with generations 1 .. n in order */
+template<typename HeadT, typename ValT>
+void test_algorithm_generic(HeadT &q, int n)
+{
+	typedef typename HeadT::EntryType EntryType;
+
+	static const int distances[] = { 0, 1, 2, 3, 16 };
+	ValT *si;
+	int i, j;
+
+	for (j = 0; j < (int)(sizeof(distances) / sizeof(distances[0])); j++) {
+		ecl::PrefetchIterator<EntryType> it(distances[j],
+		    j % 2 == 0 ? ecl::impl::PREFETCH_NO_PAYLOAD : 64);
+
+		for (si = it.init(&q), i = 0; si != NULL; si = it.next(), i++)
+			assert(si->generation() == i + 1);
+		assert(i == n);
+		assert(ecl::for_each(&q, TestAlgoSum<ValT>(),
+		    distances[j]).sum == n * (n + 1) / 2);
+		assert(ecl::find_if(&q, TestAlgoEqual<ValT>(n / 2 + 1),
+		    distances[j])->generation() == n / 2 + 1);
+		assert(ecl::find_if(&q, TestAlgoEqual<ValT>(n + 1),
+		    distances[j]) == NULL);
+		assert(ecl::count_if(&q, TestAlgoEven<ValT>(),
+		    distances[j]) == (size_t)n / 2);
+	}
+}
+
+void test_algorithm(int n)
+{
+	HeadTailq1 q1;
+	HeadSList1 l1;
+	ValTailq **s;
+	ValSList **sl;
+	int i;
+
+	s = new ValTailq*[n];
+	sl = new ValSList*[n];
+	for (i = 0; i < n; i++) {
+		s[i] = new ValTailq(i + 1);
+		sl[i] = new ValSList(n - i);
+		q1.insert_tail(s[i]);
+		l1.insert_head(sl[i]);
+	}
+	test_algorithm_generic<HeadTailq1, ValTailq>(q1, n);
+	test_algorithm_generic<HeadSList1, ValSList>(l1, n);
+
+	/* Visited objects can be removed */
+	ecl::for_each(&q1, TestAlgoRemove(&q1));
+	assert(q1.empty());
+	assert(ecl::find_if(&q1, TestAlgoEqual<ValTailq>(1)) == NULL);
+	while (!l1.empty())
+		l1.remove_head();
+
+	for (i = 0; i < n; i++) {
+		delete s[i];
+		delete sl[i];
+	}
+	delete[] s;
+	delete[] sl;
+}
+
+/* Sums generations per chain, stops a chain after a generation of stop */
+template<typename ValT>
+struct TestMultiVisitor {
+	TestMultiVisitor(int *sums_, int stop_) : sums(sums_), stop(stop_),
+	    visited(0) { }
+
+	bool operator()(ValT *obj, size_t tag) {
+		sums[tag] += obj->generation();
+		visited++;
+		return obj->generation() % stop != 0;
+	}
+
+	int *sums;
+	int stop;
+	int visited;
+};
+
+/* Spreads n objects over nchains chains of different lengths */
+template<typename HeadT, typename ValT>
+void test_multi_cursor_generic(HeadT *heads, ValT **s, int n, int nchains)
+{
+	typedef typename HeadT::EntryType EntryType;
+
+	TestMultiVisitor<ValT> *v;
+	ValT *si;
+	int *sums, *expect, i, stop, visited;
+
+	sums = new int[nchains];
+	expect = new int[nchains];
+	for (i = 0; i < n; i++)
+		heads[(int)((int64_t)i * i % nchains)].insert_head(s[i]);
+	for (stop = 3; stop <= n + 1; stop += n - 2) {
+		for (i = 0, visited = 0; i < nchains; i++) {
+			expect[i] = sums[i] = 0;
+			for (si = heads[i].first(); si != NULL;
+			    si = si->EntryType::next()) {
+				expect[i] += si->generation();
+				visited++;
+				if (si->generation() % stop == 0)
+					break;
+			}
+		}
+		v = new TestMultiVisitor<ValT>(sums, stop);
+		ecl::walk_chains(heads, nchains, *v);
+		assert(v->visited == visited);
+		for (i = 0; i < nchains; i++)
+			assert(sums[i] == expect[i]);
+		delete v;
+
+		for (i = 0; i < nchains; i++)
+			sums[i] = 0;
+		v = new TestMultiVisitor<ValT>(sums, stop);
+		ecl::walk_chains<3>(heads, nchains, *v, 64);
+		assert(v->visited == visited);
+		for (i = 0; i < nchains; i++)
+			assert(sums[i] == expect[i]);
+		delete v;
+	}
+	for (i = 0; i < nchains; i++)
+		while (!heads[i].empty())
+			heads[i].remove(heads[i].first());
+
+	delete[] sums;
+	delete[] expect;
+}
+
+void test_multi_cursor(int n, int nchains)
+{
+	HeadTailq1 *tq = new HeadTailq1[nchains];
+	HeadSList1 *sl = new HeadSList1[nchains];
+	ValTailq **s;
+	ValSList **ss;
+	int i;
+
+	s = new ValTailq*[n];
+	ss = new ValSList*[n];
+	for (i = 0; i < n; i++) {
+		s[i] = new ValTailq(i + 1);
+		ss[i] = new ValSList(i + 1);
+	}
+	test_multi_cursor_generic(tq, s, n, nchains);
+	test_multi_cursor_generic(sl, ss, n, nchains);
+
+	for (i = 0; i < n; i++) {
+		delete s[i];
+		delete ss[i];
+	}
+	delete[] s;
+	delete[] ss;
+	delete[] tq;
+	delete[] sl;
+}
+
+template class ecl::PrefetchIterator<ValTailq_Entry1>;
+template class ecl::MultiCursor<ValTailq_Entry1>;
+template class ecl::MultiCursor<ValSList_Entry1, 16>;
+
+// }}}
+
+class ValWAVLTree; // {{{
+
+struct ValWAVLTree_Entry1 : ecl::WAVLTreeEntry<ValWAVLTree_Entry1, ValWAVLTree> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		if (key > obj->gen)
+			return 1;
+		else if (key < obj->gen)
+			return -1;
+		return 0;
+	}
+};
+
+struct ValWAVLTree_Entry2 : ecl::WAVLTreeEntry<ValWAVLTree_Entry2, ValWAVLTree> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		if (key > obj->gen)
+			return -1;
+		else if (key < obj->gen)
+			return 1;
+		return 0;
+	}
+};
+
+typedef ecl::WAVLTreeHead<ValWAVLTree_Entry1> HeadWAVLTree1;
+typedef ecl::WAVLTreeHead<ValWAVLTree_Entry2> HeadWAVLTree2;
+
+extern template class ecl::WAVLTreeEntry<ValWAVLTree_Entry1, ValWAVLTree>;
+extern template class ecl::WAVLTreeHead<ValWAVLTree_Entry1>;
+extern template class ecl::WAVLTreeHead<ValWAVLTree_Entry2>;
+
+class ValWAVLTree : public ValWAVLTree_Entry1, public ValWAVLTree_Entry2 {
+public:
+	typedef ValWAVLTree_Entry1 list1;
+	typedef ValWAVLTree_Entry2 list2;
+
+	friend struct ValWAVLTree_Entry1;
+	friend struct ValWAVLTree_Entry2;
+
+	ValWAVLTree(int gen_) : gen(gen_) { }
+
+	int generation() const {
+		return gen;
+	}
+
+private:
+	int gen;
+};
+
+template<typename T, typename EntryT>
+static int
+test_check_wavltree(T *obj)
+{
+	EntryT *ent = obj;
+	int lrank, rrank;
+
+	if (obj == NULL)
+		return -1;
+	if (ent->left() != NULL)
+		assert(static_cast<EntryT *>(ent->left())->parent() == obj);
+	if (ent->right() != NULL)
+		assert(static_cast<EntryT *>(ent->right())->parent() == obj);
+	lrank = test_check_wavltree<T, EntryT>(ent->left());
+	rrank = test_check_wavltree<T, EntryT>(ent->right());
+	assert(ent->rank() - lrank == 1 || ent->rank() - lrank == 2);
+	assert(ent->rank() - rrank == 1 || ent->rank() - rrank == 2);
+	if (ent->left() == NULL && ent->right() == NULL)
+		assert(ent->rank() == 0);
+	return ent->rank();
+}
+
+void test_random_wavltree(int n, int niter)
+{
+	ValWAVLTree **s, *si;
+	HeadWAVLTree1 q1;
+	char *present;
+	int i, j;
+
+	s = new ValWAVLTree*[n];
+	present = new char[n];
+	for (i = 0; i < n; i++) {
+		s[i] = new ValWAVLTree(i);
+		present[i] = 0;
+	}
+
+	for (j = 0; j < niter; j++) {
+		i = random() % n;
+		if (present[i]) {
+			assert(q1.find(i) == s[i]);
+			q1.remove(s[i]);
+		} else {
+			assert(q1.find(i) == NULL);
+			si = q1.insert(s[i]);
+			assert(si == NULL);
+		}
+		present[i] = !present[i];
+		if (j % 64 == 0 || j + 1 == niter)
+			test_check_wavltree<ValWAVLTree, ValWAVLTree_Entry1>(q1.root());
+	}
+	for (i = 0; i < n; i++)
+		if (present[i])
+			q1.remove(s[i]);
+	assert(q1.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] present;
+	delete[] s;
+}
+
+template class ecl::WAVLTreeEntry<ValWAVLTree_Entry1, ValWAVLTree>;
+template class ecl::WAVLTreeHead<ValWAVLTree_Entry1>;
+template class ecl::WAVLTreeHead<ValWAVLTree_Entry2>;
+
+// }}}
+
+class ValAVLTree; // {{{
+
+struct ValAVLTree_Entry1 : ecl::AVLTreeEntry<ValAVLTree_Entry1, ValAVLTree> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		if (key > obj->gen)
+			return 1;
+		else if (key < obj->gen)
+			return -1;
+		return 0;
+	}
+};
+
+struct ValAVLTree_Entry2 : ecl::AVLTreeEntry<ValAVLTree_Entry2, ValAVLTree> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		if (key > obj->gen)
+			return -1;
+		else if (key < obj->gen)
+			return 1;
+		return 0;
+	}
+};
+
+typedef ecl::AVLTreeHead<ValAVLTree_Entry1> HeadAVLTree1;
+typedef ecl::AVLTreeHead<ValAVLTree_Entry2> HeadAVLTree2;
+
+extern template class ecl::AVLTreeEntry<ValAVLTree_Entry1, ValAVLTree>;
+extern template class ecl::AVLTreeHead<ValAVLTree_Entry1>;
+extern template class ecl::AVLTreeHead<ValAVLTree_Entry2>;
+
+class ValAVLTree : public ValAVLTree_Entry1, public ValAVLTree_Entry2 {
+public:
+	typedef ValAVLTree_Entry1 list1;
+	typedef ValAVLTree_Entry2 list2;
+
+	friend struct ValAVLTree_Entry1;
+	friend struct ValAVLTree_Entry2;
+
+	ValAVLTree(int gen_) : gen(gen_) { }
+
+	int generation() const {
+		return gen;
+	}
+
+private:
+	int gen;
+};
+
+template<typename T, typename EntryT>
+static int
+test_check_avltree(T *obj)
+{
+	EntryT *ent = obj;
+	int lheight, rheight;
+
+	if (obj == NULL)
+		return 0;
+	if (ent->left() != NULL)
+		assert(static_cast<EntryT *>(ent->left())->parent() == obj);
+	if (ent->right() != NULL)
+		assert(static_cast<EntryT *>(ent->right())->parent() == obj);
+	lheight = test_check_avltree<T, EntryT>(ent->left());
+	rheight = test_check_avltree<T, EntryT>(ent->right());
+	assert(ent->balance() == rheight - lheight);
+	return (lheight > rheight ? lheight : rheight) + 1;
+}
+
+void test_random_avltree(int n, int niter)
+{
+	ValAVLTree **s, *si;
+	HeadAVLTree1 q1;
+	char *present;
+	int i, j, height, count;
+
+	s = new ValAVLTree*[n];
+	present = new char[n];
+	for (i = 0; i < n; i++) {
+		s[i] = new ValAVLTree(i);
+		present[i] = 0;
+	}
+
+	for (j = 0, count = 0; j < niter; j++) {
+		i = random() % n;
+		if (present[i]) {
+			assert(q1.find(i) == s[i]);
+			q1.remove(s[i]);
+			count--;
+		} else {
+			assert(q1.find(i) == NULL);
+			si = q1.insert(s[i]);
+			assert(si == NULL);
+			count++;
+		}
+		present[i] = !present[i];
+		if (j % 64 == 0 || j + 1 == niter) {
+			height = test_check_avltree<ValAVLTree, ValAVLTree_Entry1>(
+			    q1.root());
+			/* h < 1.4405 * log2(n + 2) - 0.3277 */
+			assert(height <= 1.4405 * log2(count + 2));
+		}
+	}
+	for (i = 0; i < n; i++)
+		if (present[i])
+			q1.remove(s[i]);
+	assert(q1.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] present;
+	delete[] s;
+}
+
+template class ecl::AVLTreeEntry<ValAVLTree_Entry1, ValAVLTree>;
+template class ecl::AVLTreeHead<ValAVLTree_Entry1>;
+template class ecl::AVLTreeHead<ValAVLTree_Entry2>;
+
+// }}}
+
+class ValSplayTree; // {{{
+
+struct ValSplayTree_Entry1 : ecl::SplayTreeEntry<ValSplayTree_Entry1, ValSplayTree> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		if (key > obj->gen)
+			return 1;
+		else if (key < obj->gen)
+			return -1;
+		return 0;
+	}
+};
+
+typedef ecl::SplayTreeHead<ValSplayTree_Entry1> HeadSplayTree1;
+
+extern template class ecl::SplayTreeEntry<ValSplayTree_Entry1, ValSplayTree>;
+extern template class ecl::SplayTreeHead<ValSplayTree_Entry1>;
+
+class ValSplayTree : public ValSplayTree_Entry1 {
+public:
+	typedef ValSplayTree_Entry1 list1;
+
+	friend struct ValSplayTree_Entry1;
+
+	ValSplayTree(int gen_) : gen(gen_) { }
+
+	int generation() const {
+		return gen;
+	}
+
+private:
+	int gen;
+};
+
+void test_basic_splaytree(int n, int period)
+{
+	ValSplayTree **s, *si;
+	const ValSplayTree *sc;
+	HeadSplayTree1 q1;
+	const HeadSplayTree1 *q1c = &q1;
+	int i, j;
+
+	q1.set_splay_period(period);
+
+	s = new ValSplayTree*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValSplayTree(i * 2);
+
+	assert(q1.find(0) == NULL);
+	assert(q1.nfind(0) == NULL);
+	assert(q1.pfind(0) == NULL);
+
+	for (i = 0; i < n; i += 2) {
+		si = q1.insert(s[i]);
+		assert(si == NULL);
+	}
+	for (i = 1; i < n; i += 2) {
+		si = q1.insert(s[i]);
+		assert(si == NULL);
+	}
+	si = q1.insert(s[0]);
+	assert(si == s[0]);
+
+	assert(q1.min() == s[0]);
+	assert(q1.max() == s[n - 1]);
+
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < n; i++) {
+			assert(q1.find(i * 2) == s[i]);
+			assert(q1.find(i * 2 + 1) == NULL);
+			assert(q1.find_element(s[i]) == s[i]);
+			assert(q1.nfind(i * 2 - 1) == s[i]);
+			assert(q1.nfind(i * 2) == s[i]);
+			assert(q1.pfind(i * 2) == s[i]);
+			assert(q1.pfind(i * 2 + 1) == s[i]);
+			assert(q1c->find(i * 2) == s[i]);
+			assert(q1c->nfind(i * 2 - 1) == s[i]);
+			assert(q1c->pfind(i * 2 + 1) == s[i]);
+		}
+		assert(q1.nfind(n * 2) == NULL);
+		assert(q1.pfind(-1) == NULL);
+	}
+
+	/* Only every period-th lookup brings the object found to the root */
+	q1.set_splay_period(period);
+	for (i = 1; i <= 2 * period; i++) {
+		sc = q1.root();
+		si = q1.find((i * 7 % n) * 2);
+		assert(si == s[i * 7 % n]);
+		assert(q1.root() == (i % period == 0 ? si : sc));
+	}
+
+	ValSplayTree::list1::Iterator it;
+	for (si = it.init(&q1), i = 0; si != NULL; si = it.next(), i++)
+		assert(si == s[i]);
+	assert(i == n);
+	ValSplayTree::list1::ReverseIterator rit;
+	for (si = rit.init(&q1), i = n - 1; si != NULL; si = rit.prev(), i--)
+		assert(si == s[i]);
+	assert(i == -1);
+	for (i = 0, sc = q1c->first(); sc != NULL; sc = q1.next(s[i]), i++)
+		assert(sc == s[i]);
+	assert(i == n);
+
+	for (i = 0; i < n; i += 2) {
+		si = q1.remove(s[i]);
+		assert(si == s[i]);
+	}
+	si = q1.remove(s[0]);
+	assert(si == NULL);
+	for (i = 0; i < n; i++)
+		assert(q1.find(i * 2) == (i % 2 ? s[i] : NULL));
+
+	for (si = it.init(&q1); si != NULL; si = it.next())
+		q1.remove(si);
+	assert(q1.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+template class ecl::SplayTreeEntry<ValSplayTree_Entry1, ValSplayTree>;
+template class ecl::SplayTreeHead<ValSplayTree_Entry1>;
+
+// }}}
+
+class ValTreap; // {{{
+
+struct ValTreap_Entry1 : ecl::TreapEntry<ValTreap_Entry1, ValTreap> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		if (key > obj->gen)
+			return 1;
+		else if (key < obj->gen)
+			return -1;
+		return 0;
+	}
+};
+
+struct ValTreap_Entry2 : ecl::TreapEntry<ValTreap_Entry2, ValTreap> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		if (key > obj->gen)
+			return -1;
+		else if (key < obj->gen)
+			return 1;
+		return 0;
+	}
+};
+
+typedef ecl::TreapHead<ValTreap_Entry1> HeadTreap1;
+typedef ecl::TreapHead<ValTreap_Entry2> HeadTreap2;
+
+extern template class ecl::TreapEntry<ValTreap_Entry1, ValTreap>;
+extern template class ecl::TreapHead<ValTreap_Entry1>;
+extern template class ecl::TreapHead<ValTreap_Entry2>;
+
+class ValTreap : public ValTreap_Entry1, public ValTreap_Entry2 {
+public:
+	typedef ValTreap_Entry1 list1;
+	typedef ValTreap_Entry2 list2;
+
+	friend struct ValTreap_Entry1;
+	friend struct ValTreap_Entry2;
+
+	ValTreap(int gen_) : gen(gen_) { }
+
+	int generation() const {
+		return gen;
+	}
+
+private:
+	int gen;
+};
+
+template<typename T, typename EntryT>
+static int
+test_check_treap(T *obj)
+{
+	EntryT *ent = obj;
+
+	if (obj == NULL)
+		return 0;
+	if (ent->left() != NULL) {
+		assert(static_cast<EntryT *>(ent->left())->parent() == obj);
+		assert(EntryT::priority(ent->left()) <= EntryT::priority(obj));
+		assert(EntryT::compare(ent->left(), obj) < 0);
+	}
+	if (ent->right() != NULL) {
+		assert(static_cast<EntryT *>(ent->right())->parent() == obj);
+		assert(EntryT::priority(ent->right()) <= EntryT::priority(obj));
+		assert(EntryT::compare(ent->right(), obj) > 0);
+	}
+	return test_check_treap<T, EntryT>(ent->left()) +
+	    test_check_treap<T, EntryT>(ent->right()) + 1;
+}
+
+static int
+test_check_treap1(ValTreap *root)
+{
+	return test_check_treap<ValTreap, ValTreap_Entry1>(root);
+}
+
+void test_split_treap(int n)
+{
+	ValTreap **s, *si;
+	HeadTreap1 q1, q1a;
+	int i, k;
+
+	s = new ValTreap*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValTreap(i);
+	for (i = 0; i < n; i++)
+		q1.insert(s[(i * 7919) % n]);
+	assert(test_check_treap1(q1.root()) == n);
+
+	for (k = -1; k <= n; k += n / 7 + 1) {
+		q1.split(k, &q1a);
+		assert(test_check_treap1(q1.root()) == (k < 0 ? 0 : k));
+		assert(test_check_treap1(q1a.root()) == n - (k < 0 ? 0 : k));
+		for (i = 0; i < n; i++) {
+			assert(q1.find(i) == (i < k ? s[i] : NULL));
+			assert(q1a.find(i) == (i >= k ? s[i] : NULL));
+		}
+		ValTreap::list1::Iterator it;
+		for (si = it.init(&q1a), i = k < 0 ? 0 : k; si != NULL;
+		    si = it.next(), i++)
+			assert(si == s[i]);
+		assert(i == n);
+
+		q1.merge(&q1a);
+		assert(q1a.empty());
+		assert(test_check_treap1(q1.root()) == n);
+		for (si = it.init(&q1), i = 0; si != NULL; si = it.next(), i++)
+			assert(si == s[i]);
+		assert(i == n);
+	}
+
+	for (i = 0; i < n; i += 3)
+		q1.remove(s[i]);
+	test_check_treap1(q1.root());
+	while (!q1.empty())
+		q1.remove(q1.root());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+template class ecl::TreapEntry<ValTreap_Entry1, ValTreap>;
+template class ecl::TreapHead<ValTreap_Entry1>;
+template class ecl::TreapHead<ValTreap_Entry2>;
+
+// }}}
+
+class ValART; // {{{
+
+struct ValART_Entry1 : ecl::ARTEntry<ValART_Entry1, ValART> {
+	template<typename T>
+	static const uint8_t *key_fn(const T *obj, size_t *len) {
+		*len = strlen(obj->name) + 1;
+		return (const uint8_t *)obj->name;
+	}
+};
+
+typedef ecl::ARTHead<ValART_Entry1> HeadART1;
+
+extern template class ecl::ARTEntry<ValART_Entry1, ValART>;
+extern template class ecl::ARTHead<ValART_Entry1>;
+
+class ValART : public ValART_Entry1 {
+public:
+	typedef ValART_Entry1 list1;
+
+	friend struct ValART_Entry1;
+
+	/* Mixes long shared prefixes with wide fan-out */
+	ValART(int gen_) : gen(gen_) {
+		switch (gen % 4) {
+		case 0:
+			snprintf(name, sizeof(name), "%x", gen);
+			break;
+		case 1:
+			snprintf(name, sizeof(name), "shared/long/prefix/%d",
+			    gen);
+			break;
+		case 2:
+			snprintf(name, sizeof(name), "k%d/%d", gen % 7, gen);
+			break;
+		case 3:
+			name[0] = 1 + (gen / 4) % 255;
+			name[1] = 1 + (gen / 4 / 255) % 255;
+			snprintf(name + 2, sizeof(name) - 2, "%d", gen);
+			break;
+		}
+	}
+
+	int generation() const {
+		return gen;
+	}
+
+	const char *key() const {
+		return name;
+	}
+
+private:
+	int gen;
+	char name[32];
+};
+
+static int
+test_art_prefix_count(ValART **s, int n, const char *prefix)
+{
+	int i, count = 0;
+
+	for (i = 0; i < n; i++)
+		if (strncmp(s[i]->key(), prefix, strlen(prefix)) == 0)
+			count++;
+	return count;
+}
+
+void test_basic_art(int n)
+{
+	static const char *prefixes[] = { "", "shared/long/prefix/1",
+	    "shared/long/prefix/", "shared/long/", "k3/", "k3/1", "a", "zz" };
+	ValART::list1::Iterator it;
+	ValART::list1::ReverseIterator rit;
+	HeadART1::PrefixIterator pit;
+	ValART **s, *si, *prev;
+	HeadART1 q1;
+	int i, j, count;
+
+	assert(q1.empty());
+	assert(q1.first() == NULL);
+	assert(q1.find("a", 2) == NULL);
+	assert(pit.init(&q1, "", 0) == NULL);
+
+	s = new ValART*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValART(i);
+
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < n; i++) {
+			si = q1.insert(s[(i * 7919) % n]);
+			assert(si == NULL);
+		}
+		si = q1.insert(s[0]);
+		assert(si == s[0]);
+		assert(q1.size() == (size_t)n);
+
+		for (i = 0; i < n; i++) {
+			assert(q1.find(s[i]->key(), strlen(s[i]->key()) + 1) ==
+			    s[i]);
+			assert(q1.find_element(s[i]) == s[i]);
+			assert(q1.find(s[i]->key(), strlen(s[i]->key())) ==
+			    NULL);
+		}
+		assert(q1.find("shared/long/prefix/-1", 22) == NULL);
+		assert(q1.find("shared/long/prefiX/1", 21) == NULL);
+
+		for (si = it.init(&q1), prev = NULL, count = 0; si != NULL;
+		    prev = si, si = it.next(), count++)
+			assert(prev == NULL || strcmp(prev->key(), si->key()) < 0);
+		assert(count == n);
+		assert(prev == q1.last());
+		for (si = rit.init(&q1), prev = NULL, count = 0; si != NULL;
+		    prev = si, si = rit.prev(), count++)
+			assert(prev == NULL || strcmp(prev->key(), si->key()) > 0);
+		assert(count == n);
+		assert(prev == q1.first());
+
+		for (i = 0; i < (int)(sizeof(prefixes) / sizeof(prefixes[0]));
+		    i++) {
+			for (si = pit.init(&q1, prefixes[i], strlen(prefixes[i])),
+			    count = 0; si != NULL; si = pit.next(), count++)
+				assert(strncmp(si->key(), prefixes[i],
+				    strlen(prefixes[i])) == 0);
+			assert(count == test_art_prefix_count(s, n,
+			    prefixes[i]));
+		}
+
+		for (i = j; i < n; i += 2)
+			q1.remove(s[i]);
+		for (i = 0; i < n; i++)
+			assert(q1.find_element(s[i]) ==
+			    (i % 2 == j ? NULL : s[i]));
+		for (si = it.init(&q1), prev = NULL, count = 0; si != NULL;
+		    prev = si, si = it.next(), count++)
+			assert(prev == NULL || strcmp(prev->key(), si->key()) < 0);
+		assert(count == n / 2 + (j == 1 && n % 2 == 1));
+
+		for (si = it.init(&q1); si != NULL; si = it.next())
+			q1.remove(si);
+		assert(q1.empty());
+		assert(q1.size() == 0);
+	}
+
+	for (i = 0; i < n; i++)
+		q1.insert(s[i]);
+	q1.clear();
+	assert(q1.empty());
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+template class ecl::ARTEntry<ValART_Entry1, ValART>;
+template class ecl::ARTHead<ValART_Entry1>;
+
+// }}}
+
+// {{{ radix
+
+static uint64_t
+test_radix_index(int i)
+{
+	/* Runs of dense indices spread over the whole key space */
+	return (uint64_t)(i / 100) * 0x9e3779b97f4a7c15ULL + i % 100;
+}
+
+static int
+test_radix_cmp(const void *xa, const void *xb)
+{
+	uint64_t a = *(const uint64_t *)xa, b = *(const uint64_t *)xb;
+
+	return a < b ? -1 : a > b;
+}
+
+void test_radix_array(int n)
+{
+	ecl::RadixArray<int> ra;
+	ecl::RadixArray<int>::Iterator it;
+	uint64_t *idx, index;
+	int *vals, *v, *vr;
+	int i, j;
+
+	assert(ra.empty());
+	assert(ra.load(0) == NULL);
+	vr = ra.erase(0);
+	assert(vr == NULL);
+	index = 0;
+	vr = ra.find_next_present(&index);
+	assert(vr == NULL);
+	assert(it.init(&ra) == NULL);
+
+	idx = new uint64_t[n];
+	vals = new int[n];
+	for (i = 0; i < n; i++) {
+		idx[i] = test_radix_index(i);
+		vals[i] = i;
+	}
+	idx[n - 1] = UINT64_MAX;
+
+	for (i = 0; i < n; i++) {
+		vr = ra.store(idx[i], &vals[i]);
+		assert(vr == NULL);
+	}
+	vr = ra.store(idx[0], &vals[0]);
+	assert(vr == &vals[0]);
+	assert(ra.size() == (size_t)n);
+	for (i = 0; i < n; i++) {
+		assert(ra.load(idx[i]) == &vals[i]);
+		if (i % 100 != 99 && i != n - 1)
+			assert(ra.load(idx[i] + 100) == NULL);
+	}
+
+	for (i = 0; i < n; i += 3)
+		ra.set_tag(idx[i], 0);
+	for (i = 0; i < n; i += 6)
+		ra.clear_tag(idx[i], 0);
+	for (i = 0; i < n; i++) {
+		assert(ra.get_tag(idx[i], 0) == (i % 3 == 0 && i % 6 != 0));
+		assert(!ra.get_tag(idx[i], 1));
+	}
+
+	qsort(idx, n, sizeof(idx[0]), test_radix_cmp);
+	for (v = it.init(&ra), i = 0; v != NULL; v = it.next(), i++) {
+		assert(it.index() == idx[i]);
+		assert(v == ra.load(idx[i]));
+	}
+	assert(i == n);
+	for (i = 0; i < n; i++) {
+		index = idx[i] - (i > 0 && idx[i - 1] < idx[i] - 1);
+		vr = ra.find_next_present(&index);
+		assert(vr == ra.load(idx[i]));
+		assert(index == idx[i]);
+	}
+	for (index = 0, j = 0; ra.find_next_tagged(&index, 0) != NULL;) {
+		assert(ra.get_tag(index, 0));
+		j++;
+		if (index++ == UINT64_MAX)
+			break;
+	}
+	assert(j == (n + 2) / 3 - (n + 5) / 6);
+
+	for (i = 0; i < n; i += 2) {
+		v = ra.load(idx[i]);
+		vr = ra.erase(idx[i]);
+		assert(vr == v);
+		assert(ra.load(idx[i]) == NULL);
+		vr = ra.erase(idx[i]);
+		assert(vr == NULL);
+	}
+	for (v = it.init(&ra), i = 1; v != NULL; v = it.next(), i += 2)
+		assert(it.index() == idx[i]);
+	assert(i == 1 + 2 * (n / 2));
+	for (i = 1; i < n; i += 2)
+		ra.erase(idx[i]);
+	assert(ra.empty());
+	assert(it.init(&ra) == NULL);
+
+	for (i = 0; i < n; i++)
+		ra.store(idx[i], &vals[i]);
+	ra.clear();
+	assert(ra.empty());
+	assert(ra.load(idx[0]) == NULL);
+
+	delete[] idx;
+	delete[] vals;
+}
+
+template class ecl::RadixArray<int>;
+
+// }}}
+
+class ValHash; // {{{
+
+struct ValHash_Entry1 : ecl::HashTableEntry<ValHash_Entry1, ValHash> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		return key == obj->gen ? 0 : 1;
+	}
+
+	template<typename T>
+	static size_t hash_fn(const T *obj) {
+		return hash_key_fn(obj->gen);
+	}
+
+	/* Four keys per hash value to exercise collisions */
+	static size_t hash_key_fn(int key) {
+		return (size_t)(key / 4);
+	}
+};
+
+typedef ecl::HashTableHead<ValHash_Entry1> HeadHash1;
+
+extern template class ecl::HashTableEntry<ValHash_Entry1, ValHash>;
+extern template class ecl::HashTableHead<ValHash_Entry1>;
+
+class ValHash : public ValHash_Entry1 {
+public:
+	typedef ValHash_Entry1 list1;
+
+	friend struct ValHash_Entry1;
+
+	ValHash(int gen_) : gen(gen_) { }
+
+	int generation() const {
+		return gen;
+	}
+
+private:
+	int gen;
+};
+
+void test_basic_hash(int n)
+{
+	HeadHash1::Iterator it;
+	ValHash **s, *si, *sr;
+	HeadHash1 q1;
+	const HeadHash1 *q1c = &q1;
+	char *seen;
+	int i, j;
+
+	assert(q1.empty());
+	assert(q1.find(0) == NULL);
+	assert(it.init(&q1) == NULL);
+
+	s = new ValHash*[n];
+	seen = new char[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValHash(i);
+
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < n; i++) {
+			sr = q1.insert(s[i]);
+			assert(sr == NULL);
+			assert(q1.find(i) == s[i]);
+			assert(q1.find(i / 2) == s[i / 2]);
+		}
+		sr = q1.insert(s[0]);
+		assert(sr == s[0]);
+		assert(q1.size() == (size_t)n);
+		assert(q1.bucket_count() >= (size_t)n / 2);
+
+		for (i = 0; i < n; i++) {
+			assert(q1.find(i) == s[i]);
+			assert(q1c->find(i) == s[i]);
+			assert(q1.find_element(s[i]) == s[i]);
+		}
+		assert(q1.find(-1) == NULL);
+		assert(q1.find(n) == NULL);
+
+		memset(seen, 0, n);
+		for (si = it.init(&q1), i = 0; si != NULL; si = it.next(), i++) {
+			assert(!seen[si->generation()]);
+			seen[si->generation()] = 1;
+		}
+		assert(i == n);
+
+		for (i = j; i < n; i += 2) {
+			sr = q1.remove(s[i]);
+			assert(sr == s[i]);
+			assert(q1.find(i) == NULL);
+		}
+		for (i = 0; i < n; i++)
+			assert(q1.find(i) == (i % 2 == j ? NULL : s[i]));
+		if (j == 0)
+			q1.clear();
+		else
+			for (i = 1 - j; i < n; i += 2)
+				q1.remove(s[i]);
+		assert(q1.empty());
+		assert(q1.find(1) == NULL);
+	}
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+	delete[] seen;
+}
+
+void test_hash_index(int n)
+{
+	ecl::HashIndex<ValHash_Entry1> q;
+	ecl::HashIndex<ValHash_Entry1>::Iterator it;
+	ValHash **s, **out, *si, *sr;
+	int *keys;
+	char *seen;
+	int i, j;
+
+	assert(q.empty());
+	assert(q.find(0) == NULL);
+	sr = q.remove(NULL);
+	assert(sr == NULL);
+	assert(it.init(&q) == NULL);
+
+	s = new ValHash*[n];
+	out = new ValHash*[2 * n];
+	keys = new int[2 * n];
+	seen = new char[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValHash(i);
+
+	for (j = 0; j < 3; j++) {
+		if (j == 2)
+			q.reserve(n);
+		for (i = 0; i < n; i++) {
+			sr = q.insert(s[i]);
+			assert(sr == NULL);
+			assert(q.find(i) == s[i]);
+		}
+		sr = q.insert(s[n - 1]);
+		assert(sr == s[n - 1]);
+		assert(q.size() == (size_t)n);
+		assert(q.capacity() * 7 / 8 >= (size_t)n);
+
+		for (i = 0; i < n; i++) {
+			assert(q.find(i) == s[i]);
+			assert(q.find_element(s[i]) == s[i]);
+		}
+		assert(q.find(-1) == NULL);
+		assert(q.find(n) == NULL);
+
+		for (i = 0; i < 2 * n; i++)
+			keys[i] = (i * 7919) % (2 * n);
+		q.find_batch(keys, 2 * n, out);
+		for (i = 0; i < 2 * n; i++)
+			assert(out[i] == (keys[i] < n ? s[keys[i]] : NULL));
+
+		memset(seen, 0, n);
+		for (si = it.init(&q), i = 0; si != NULL; si = it.next(), i++) {
+			assert(!seen[si->generation()]);
+			seen[si->generation()] = 1;
+		}
+		assert(i == n);
+
+		/* Leave tombstones behind and insert over them */
+		for (i = j % 2; i < n; i += 2) {
+			sr = q.remove(s[i]);
+			assert(sr == s[i]);
+		}
+		if (n > 1) {
+			sr = q.remove(s[j % 2]);
+			assert(sr == NULL);
+		}
+		for (i = 0; i < n; i++)
+			assert(q.find(i) == (i % 2 == j % 2 ? NULL : s[i]));
+		for (i = j % 2; i < n; i += 2) {
+			sr = q.insert(s[i]);
+			assert(sr == NULL);
+		}
+		for (i = 0; i < n; i++)
+			assert(q.find(i) == s[i]);
+		if (j == 0)
+			q.clear();
+		else {
+			for (i = 0; i < n; i++) {
+				sr = q.remove(s[i]);
+				assert(sr == s[i]);
+			}
+		}
+		assert(q.empty());
+		assert(q.find(0) == NULL);
+	}
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+	delete[] out;
+	delete[] keys;
+	delete[] seen;
+}
+
+typedef ecl::ConcurrentHashTableHead<ValHash_Entry1> ConcurrentHash1;
+
+struct ConcurrentHashArg {
+	ConcurrentHash1 *q;
+	ValHash **s;
+	int n;
+	int from;
+	int to;
+	int niter;
+	int *done;
+};
+
+/* Adds missing even keys in [from, to) and churns odd ones */
+static void *
+test_concurrent_hash_writer(void *xarg)
+{
+	ConcurrentHashArg *arg = (ConcurrentHashArg *)xarg;
+	ValHash *si;
+	int i, j;
+
+	for (i = arg->from + arg->from % 2; i < arg->to; i += 2) {
+		if (i >= arg->n / 8) {
+			si = arg->q->insert(arg->s[i]);
+			assert(si == NULL);
+		}
+	}
+	for (j = 0; j < arg->niter; j++) {
+		for (i = arg->from | 1; i < arg->to; i += 2) {
+			si = arg->q->insert(arg->s[i]);
+			assert(si == NULL);
+		}
+		for (i = arg->from | 1; i < arg->to; i += 2)
+			assert(arg->q->find(i) == arg->s[i]);
+		for (i = arg->from | 1; i < arg->to; i += 2) {
+			si = arg->q->remove(arg->s[i]);
+			assert(si == arg->s[i]);
+		}
+	}
+	return NULL;
+}
+
+static void *
+test_concurrent_hash_reader(void *xarg)
+{
+	ConcurrentHashArg *arg = (ConcurrentHashArg *)xarg;
+	ValHash *si;
+	int i;
+
+	while (!__atomic_load_n(arg->done, __ATOMIC_ACQUIRE)) {
+		for (i = 0; i < arg->n; i++) {
+			si = arg->q->find(i);
+			if (i % 2 == 0 && i < arg->n / 8)
+				assert(si == arg->s[i]);
 			else
-				assert(snext == NULL);
-			assert(sprev == s[i - (i % 2)]);
-		} else {
-			assert(snext == s[i + (i % 2)]);
-			assert(sprev == s[i - (i % 2)]);
+				assert(si == NULL || si == arg->s[i]);
 		}
 	}
+	return NULL;
+}
 
-	while (!q1.empty())
-		q1.remove(q1.root());
+void test_concurrent_hash(int n, int nwriters, int nreaders)
+{
+	ConcurrentHash1 q(4), q2(4);
+	ConcurrentHashArg *args;
+	pthread_t *tids;
+	ValHash **s, *si;
+	size_t nbuckets;
+	int i, done;
 
-	ValRBTree::list2::Iterator it;
-	for (si = it.init(&q2); si != NULL; si = it.next())
-		q2.remove(si);
+	assert(q.empty());
+	assert(q.find(0) == NULL);
+
+	s = new ValHash*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValHash(i);
+
+	nbuckets = q.bucket_count();
+	for (i = 0; i < n; i++) {
+		si = q.insert(s[i]);
+		assert(si == NULL);
+		assert(q.find(i) == s[i]);
+	}
+	si = q.insert(s[0]);
+	assert(si == s[0]);
+	q.finish_resize();
+	assert(!q.resizing());
+	assert(q.size() == (size_t)n);
+	assert(n < 64 || q.bucket_count() > nbuckets);
+	for (i = 0; i < n; i++)
+		assert(q.find(i) == s[i]);
+	assert(q.find(-1) == NULL);
+	assert(q.find(n) == NULL);
+	for (i = 1; i < n; i += 2) {
+		si = q.remove(s[i]);
+		assert(si == s[i]);
+		assert(q.find(i) == NULL);
+	}
+	assert(q.size() == (size_t)(n + 1) / 2);
+	for (i = 0; i < n; i += 2) {
+		si = q.remove(s[i]);
+		assert(si == s[i]);
+	}
+	assert(q.empty());
+
+	/*
+	 * Writers grow the table with even keys and churn odd ones, readers
+	 * expect the initial even keys to stay.
+	 */
+	for (i = 0; i < n / 8; i += 2) {
+		si = q2.insert(s[i]);
+		assert(si == NULL);
+	}
+	done = 0;
+	args = new ConcurrentHashArg[nwriters + nreaders];
+	tids = new pthread_t[nwriters + nreaders];
+	for (i = 0; i < nwriters + nreaders; i++) {
+		args[i].q = &q2;
+		args[i].s = s;
+		args[i].n = n;
+		args[i].from = n * i / nwriters;
+		args[i].to = n * (i + 1) / nwriters;
+		args[i].niter = 10;
+		args[i].done = &done;
+		pthread_create(&tids[i], NULL, i < nwriters ?
+		    test_concurrent_hash_writer : test_concurrent_hash_reader,
+		    &args[i]);
+	}
+	for (i = 0; i < nwriters; i++)
+		pthread_join(tids[i], NULL);
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+	for (; i < nwriters + nreaders; i++)
+		pthread_join(tids[i], NULL);
+	delete[] tids;
+	delete[] args;
+
+	q2.finish_resize();
+	assert(q2.size() == (size_t)(n + 1) / 2);
+	assert(n < 64 || q2.bucket_count() > nbuckets);
+	for (i = 0; i < n; i++)
+		assert(q2.find(i) == (i % 2 == 0 ? s[i] : NULL));
+	for (i = 0; i < n; i += 2) {
+		si = q2.remove(s[i]);
+		assert(si == s[i]);
+	}
 	assert(q2.empty());
+	for (i = 0; i < n; i++)
+		assert(q2.find(i) == NULL);
 
 	for (i = 0; i < n; i++)
 		delete s[i];
 	delete[] s;
 }
 
-template class ecl::RBTreeEntry<ValRBTree_Entry1, ValRBTree>;
-template class ecl::RBTreeHead<ValRBTree_Entry1>;
-template class ecl::RBTreeHead<ValRBTree_Entry2>;
+/* Grows the table with keys in [n / 2, n) */
+static void *
+test_concurrent_resize_grower(void *xarg)
+{
+	ConcurrentHashArg *arg = (ConcurrentHashArg *)xarg;
+	ValHash *si;
+	int i;
+
+	for (i = arg->n / 2; i < arg->n; i++) {
+		si = arg->q->insert(arg->s[i]);
+		assert(si == NULL);
+	}
+	return NULL;
+}
+
+/* Looks up, re-inserts and removes present keys in [from, to) */
+static void *
+test_concurrent_resize_remover(void *xarg)
+{
+	ConcurrentHashArg *arg = (ConcurrentHashArg *)xarg;
+	ValHash *si;
+	int i, j;
+
+	for (j = 0; j < arg->niter; j++)
+		for (i = arg->from; i < arg->to; i++) {
+			assert(arg->q->find(i) == arg->s[i]);
+			si = arg->q->insert(arg->s[i]);
+			assert(si == arg->s[i]);
+			si = arg->q->remove(arg->s[i]);
+			assert(si == arg->s[i]);
+			assert(arg->q->find(i) == NULL);
+			si = arg->q->insert(arg->s[i]);
+			assert(si == NULL);
+		}
+	return NULL;
+}
+
+/* Keys in [0, from) are never removed */
+static void *
+test_concurrent_resize_reader(void *xarg)
+{
+	ConcurrentHashArg *arg = (ConcurrentHashArg *)xarg;
+	int i;
+
+	while (!__atomic_load_n(arg->done, __ATOMIC_ACQUIRE))
+		for (i = 0; i < arg->from; i++)
+			assert(arg->q->find(i) == arg->s[i]);
+	return NULL;
+}
+
+/* Every round starts from a small table resized while keys are in use */
+void test_concurrent_hash_resize(int n, int nremovers, int nreaders,
+    int nrounds)
+{
+	ConcurrentHashArg *args;
+	ConcurrentHash1 *q;
+	pthread_t *tids;
+	ValHash **s, *si;
+	int i, r, nthreads, done;
+
+	s = new ValHash*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValHash(i);
+	nthreads = 1 + nremovers + nreaders;
+	args = new ConcurrentHashArg[nthreads];
+	tids = new pthread_t[nthreads];
+	for (r = 0; r < nrounds; r++) {
+		q = new ConcurrentHash1(4);
+		for (i = 0; i < n / 2; i++) {
+			si = q->insert(s[i]);
+			assert(si == NULL);
+		}
+		q->finish_resize();
+		done = 0;
+		for (i = 0; i < nthreads; i++) {
+			args[i].q = q;
+			args[i].s = s;
+			args[i].n = n;
+			args[i].from = n / 8;
+			args[i].to = n / 2;
+			args[i].niter = 4;
+			args[i].done = &done;
+			if (i > 0 && i <= nremovers) {
+				args[i].from = n / 8 + (n / 2 - n / 8) *
+				    (i - 1) / nremovers;
+				args[i].to = n / 8 + (n / 2 - n / 8) *
+				    i / nremovers;
+			}
+			pthread_create(&tids[i], NULL, i == 0 ?
+			    test_concurrent_resize_grower : i <= nremovers ?
+			    test_concurrent_resize_remover :
+			    test_concurrent_resize_reader, &args[i]);
+		}
+		for (i = 0; i <= nremovers; i++)
+			pthread_join(tids[i], NULL);
+		__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+		for (; i < nthreads; i++)
+			pthread_join(tids[i], NULL);
+
+		q->finish_resize();
+		assert(q->size() == (size_t)n);
+		for (i = 0; i < n; i++) {
+			assert(q->find(i) == s[i]);
+			si = q->remove(s[i]);
+			assert(si == s[i]);
+		}
+		assert(q->empty());
+		delete q;
+	}
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+	delete[] args;
+	delete[] tids;
+}
+
+template class ecl::HashTableEntry<ValHash_Entry1, ValHash>;
+template class ecl::HashTableHead<ValHash_Entry1>;
+template class ecl::ConcurrentHashTableHead<ValHash_Entry1>;
+
+// }}}
+
+class ValSkipList; // {{{
+
+struct ValSkipList_Entry1 : ecl::SkipListEntry<ValSkipList_Entry1,
+    ValSkipList, 8> {
+	template<typename T>
+	static int compare_fn(const T *a, const T *b) {
+		return compare_key_fn(a->gen, b);
+	}
+
+	template<typename T>
+	static int compare_key_fn(int key, const T *obj) {
+		return key < obj->gen ? -1 : key > obj->gen;
+	}
+};
+
+typedef ecl::SkipListHead<ValSkipList_Entry1> HeadSkipList1;
+
+extern template class ecl::SkipListEntry<ValSkipList_Entry1, ValSkipList, 8>;
+extern template class ecl::SkipListHead<ValSkipList_Entry1>;
+
+class ValSkipList : public ValSkipList_Entry1 {
+public:
+	typedef ValSkipList_Entry1 list1;
+
+	friend struct ValSkipList_Entry1;
+
+	ValSkipList(int gen_) : gen(gen_) { }
+
+	int generation() const {
+		return gen;
+	}
+
+private:
+	int gen;
+};
+
+void test_basic_skiplist(int n)
+{
+	HeadSkipList1::Iterator it;
+	HeadSkipList1 q;
+	ValSkipList **s, *si, *sr;
+	int i, j;
+
+	assert(q.empty());
+	assert(q.first() == NULL);
+	assert(q.find(0) == NULL);
+	assert(q.nfind(0) == NULL);
+	assert(it.init(&q) == NULL);
+
+	s = new ValSkipList*[n];
+	for (i = 0; i < n; i++)
+		s[i] = new ValSkipList(i * 2);
+	sr = q.remove(s[0]);
+	assert(sr == NULL);
+
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < n; i++) {
+			si = s[(int)((int64_t)i * 7919 % n)];
+			if (n % 7919 == 0)
+				si = s[i];
+			sr = q.insert(si);
+			assert(sr == NULL);
+		}
+		sr = q.insert(s[n / 2]);
+		assert(sr == s[n / 2]);
+		assert(q.first() == s[0]);
+
+		for (i = 0; i < n; i++) {
+			assert(q.find(i * 2) == s[i]);
+			assert(q.find(i * 2 + 1) == NULL);
+			assert(q.nfind(i * 2 - 1) == s[i]);
+			assert(q.nfind(i * 2) == s[i]);
+		}
+		assert(q.nfind(n * 2 - 1) == NULL);
+		for (si = it.init(&q), i = 0; si != NULL; si = it.next(), i++)
+			assert(si == s[i]);
+		assert(i == n);
+		for (si = it.init(&q, n - 1), i = n / 2; si != NULL;
+		    si = it.next(), i++)
+			assert(si == s[i]);
+		assert(i == n);
+
+		for (i = j; i < n; i += 2) {
+			sr = q.remove(s[i]);
+			assert(sr == s[i]);
+			sr = q.remove(s[i]);
+			assert(sr == NULL);
+			assert(q.find(i * 2) == NULL);
+		}
+		for (si = it.init(&q), i = 1 - j; si != NULL;
+		    si = it.next(), i += 2)
+			assert(si == s[i]);
+		assert(i >= n);
+		for (i = 1 - j; i < n; i += 2) {
+			sr = q.remove(s[i]);
+			assert(sr == s[i]);
+		}
+		assert(q.empty());
+		assert(q.nfind(0) == NULL);
+	}
+
+	for (i = 0; i < n; i++)
+		delete s[i];
+	delete[] s;
+}
+
+struct MtSkipListArg {
+	ecl::EpochDomain *domain;
+	HeadSkipList1 *q;
+	int n;
+	int from;
+	int to;
+	int niter;
+	int *done;
+};
+
+static int test_skiplist_released;
+
+static void
+test_skiplist_release(void *obj)
+{
+	delete (ValSkipList *)obj;
+	__atomic_add_fetch(&test_skiplist_released, 1, __ATOMIC_RELAXED);
+}
+
+/* Inserts fresh objects with odd keys in [from, to) and retires them */
+static void *
+test_mt_skiplist_writer(void *xarg)
+{
+	MtSkipListArg *arg = (MtSkipListArg *)xarg;
+	ecl::EpochDomain::Thread thr(arg->domain);
+	ValSkipList *si, *sr;
+	int i, j;
+
+	for (j = 0; j < arg->niter; j++) {
+		for (i = arg->from | 1; i < arg->to; i += 2) {
+			ecl::EpochDomain::Guard guard(&thr);
+
+			sr = arg->q->insert(new ValSkipList(i));
+			assert(sr == NULL);
+		}
+		for (i = arg->from | 1; i < arg->to; i += 2) {
+			ecl::EpochDomain::Guard guard(&thr);
+
+			si = arg->q->find(i);
+			assert(si != NULL && si->generation() == i);
+			sr = arg->q->remove(si);
+			assert(sr == si);
+			thr.retire(si, test_skiplist_release);
+		}
+	}
+	return NULL;
+}
+
+static int test_skiplist_inserted;
+
+/*
+ * Every writer inserts and removes the same odd keys, so objects with equal
+ * keys get linked and unlinked around each other.
+ */
+static void *
+test_mt_skiplist_shared_writer(void *xarg)
+{
+	MtSkipListArg *arg = (MtSkipListArg *)xarg;
+	ecl::EpochDomain::Thread thr(arg->domain);
+	ValSkipList *si;
+	int i, j;
+
+	for (j = 0; j < arg->niter; j++) {
+		for (i = arg->from | 1; i < arg->to; i += 2) {
+			ecl::EpochDomain::Guard guard(&thr);
+
+			si = new ValSkipList(i);
+			if (arg->q->insert(si) != NULL)
+				delete si;
+			else
+				__atomic_add_fetch(&test_skiplist_inserted, 1,
+				    __ATOMIC_RELAXED);
+			si = arg->q->find(i);
+			if (si != NULL && arg->q->remove(si) == si)
+				thr.retire(si, test_skiplist_release);
+		}
+	}
+	return NULL;
+}
+
+/* Even keys stay in the list, iteration must see them in order */
+static void *
+test_mt_skiplist_reader(void *xarg)
+{
+	MtSkipListArg *arg = (MtSkipListArg *)xarg;
+	ecl::EpochDomain::Thread thr(arg->domain);
+	HeadSkipList1::Iterator it;
+	ValSkipList *si;
+	int i, prev;
+
+	while (!__atomic_load_n(arg->done, __ATOMIC_ACQUIRE)) {
+		ecl::EpochDomain::Guard guard(&thr);
+
+		for (i = 0; i < arg->n; i += 2)
+			assert(arg->q->find(i)->generation() == i);
+		for (si = it.init(arg->q), i = 0, prev = -1; si != NULL;
+		    si = it.next()) {
+			assert(si->generation() > prev);
+			prev = si->generation();
+			if (prev % 2 == 0) {
+				assert(prev == i);
+				i += 2;
+			}
+		}
+		assert(i >= arg->n);
+	}
+	return NULL;
+}
+
+void test_mt_skiplist(int n, int nwriters, int nreaders, int niter,
+    bool shared)
+{
+	ecl::EpochDomain domain;
+	HeadSkipList1 q;
+	MtSkipListArg *args;
+	pthread_t *tids;
+	ValSkipList **s, *sr;
+	int i, done;
+
+	s = new ValSkipList*[(n + 1) / 2];
+	for (i = 0; i < n; i += 2) {
+		s[i / 2] = new ValSkipList(i);
+		sr = q.insert(s[i / 2]);
+		assert(sr == NULL);
+	}
+
+	test_skiplist_released = 0;
+	test_skiplist_inserted = shared ? 0 : n / 2 * niter;
+	done = 0;
+	args = new MtSkipListArg[nwriters + nreaders];
+	tids = new pthread_t[nwriters + nreaders];
+	for (i = 0; i < nwriters + nreaders; i++) {
+		args[i].domain = &domain;
+		args[i].q = &q;
+		args[i].n = n;
+		args[i].from = shared ? 0 : n * i / nwriters;
+		args[i].to = shared ? n : n * (i + 1) / nwriters;
+		args[i].niter = niter;
+		args[i].done = &done;
+		pthread_create(&tids[i], NULL, i >= nwriters ?
+		    test_mt_skiplist_reader : shared ?
+		    test_mt_skiplist_shared_writer : test_mt_skiplist_writer,
+		    &args[i]);
+	}
+	for (i = 0; i < nwriters; i++)
+		pthread_join(tids[i], NULL);
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+	for (; i < nwriters + nreaders; i++)
+		pthread_join(tids[i], NULL);
+	delete[] tids;
+	delete[] args;
+
+	/* Writer threads wait for their retired objects on exit */
+	assert(test_skiplist_released == test_skiplist_inserted);
+	for (i = 0; i < n; i++)
+		assert(q.find(i) == (i % 2 == 0 ? s[i / 2] : NULL));
+	for (i = 0; i < n; i += 2) {
+		sr = q.remove(s[i / 2]);
+		assert(sr == s[i / 2]);
+	}
+	assert(q.empty());
+
+	for (i = 0; i < n; i += 2)
+		delete s[i / 2];
+	delete[] s;
+}
+
+template class ecl::SkipListEntry<ValSkipList_Entry1, ValSkipList, 8>;
+template class ecl::SkipListHead<ValSkipList_Entry1>;
 
 // }}}
 
@@ -818,11 +4320,168 @@ int main()
 
 	test_basic_slist(n);
 
+	for (int i = 1; i < 40; i += 3) {
+		test_sort_list(i);
+		test_sort_slist(i);
+		test_sort_tailq(i);
+		test_sort_stailq(i);
+	}
+	test_sort_list(n);
+	test_sort_slist(n);
+	test_sort_tailq(n);
+	test_sort_stailq(n);
+
+	for (int i = 1; i < 20; i++) {
+		test_splice_list(i);
+		test_splice_tailq(i);
+		test_splice_stailq(i);
+	}
+	test_splice_list(n);
+	test_splice_tailq(n);
+	test_splice_stailq(n);
+
+	for (int i = 1; i < 20; i++) {
+		test_marker_tailq(i, 1);
+		test_marker_tailq(i, 3);
+	}
+	test_marker_tailq(n, 7);
+
+	for (int i = 1; i < 20; i++) {
+		test_marker_incremental_tailq(i, 1);
+		test_marker_incremental_tailq(i, 3);
+	}
+	test_marker_incremental_tailq(n, 64);
+
+	for (int i = 1; i < 20; i++)
+		test_marker_filter_tailq(i);
+	test_marker_filter_tailq(n);
+
+	for (int i = 0; i < 20; i++) {
+		test_incremental_tailq(i, 1);
+		test_incremental_tailq(i, 3);
+	}
+	test_incremental_tailq(n, 64);
+
 	test_basic_stailq(n);
 
-	test_basic_rbtree(1001);
+	for (int i = 1; i < 20; i++)
+		test_counting(i);
+	test_counting(n);
+
+	for (int i = 0; i < 20; i++)
+		test_filter(i);
+	test_filter(n);
+
+	for (int i = 0; i < 20; i++)
+		test_batch(i);
+	test_batch(n);
+
+	for (int i = 1; i < 20; i++)
+		test_algorithm(i);
+	test_algorithm(n);
+
+	for (int i = 3; i < 40; i += 4) {
+		test_multi_cursor(i, 1);
+		test_multi_cursor(i, 7);
+		test_multi_cursor(i, 40);
+	}
+	test_multi_cursor(n, 257);
+
+	test_basic_tree<ecl::RBTreeHead, ValRBTree>(1001);
+
+	test_basic_tree<ecl::RBTreeHead, ValRBTree>(n);
+
+	for (int i = 0; i < 40; i += 3) {
+		test_incremental_rbtree(i, 1);
+		test_incremental_rbtree(i, 5);
+	}
+	test_incremental_rbtree(n, 64);
+
+	for (int i = 0; i < 70; i++)
+		test_frozen_rbtree(i);
+	test_frozen_rbtree(n);
+
+	for (int i = 1; i < 100; i += 7) {
+		test_bptree<int>(i);
+		test_bptree<long>(i);
+	}
+	test_bptree<int>(n);
+	test_bptree<long>(n);
+
+	test_seq_rbtree(n, 2, 200);
+
+	test_shard_rbtree(n, 4);
+
+	for (int i = 1; i < 40; i += 3) {
+		test_parallel_rbtree(i, 1);
+		test_parallel_rbtree(i, 3);
+	}
+	test_parallel_rbtree(n, 4);
+	test_parallel_rbtree(n, 7);
+
+	for (int i = 2; i <= 40; i += 2)
+		for (int t = 2; t <= 4; t++)
+			test_parallel_random_rbtree(i, t, 20);
+	test_parallel_random_rbtree(n, 4, 5);
+
+	test_basic_tree<ecl::WAVLTreeHead, ValWAVLTree>(1001);
+
+	test_basic_tree<ecl::WAVLTreeHead, ValWAVLTree>(n);
+
+	test_random_wavltree(100, 20000);
+
+	test_random_wavltree(n, 100000);
+
+	test_basic_tree<ecl::AVLTreeHead, ValAVLTree>(1001);
+
+	test_basic_tree<ecl::AVLTreeHead, ValAVLTree>(n);
+
+	test_random_avltree(100, 20000);
+
+	test_random_avltree(n, 100000);
+
+	test_basic_splaytree(1001, 1);
+
+	test_basic_splaytree(n, 1);
+
+	test_basic_splaytree(n, 3);
+
+	test_basic_tree<ecl::TreapHead, ValTreap>(1001);
+
+	test_basic_tree<ecl::TreapHead, ValTreap>(n);
+
+	test_split_treap(1);
+
+	test_split_treap(n);
+
+	for (int i = 1; i < 20; i++)
+		test_basic_art(i);
+	test_basic_art(n);
+
+	for (int i = 1; i < 300; i += 37)
+		test_radix_array(i);
+	test_radix_array(n);
+
+	for (int i = 1; i < 100; i += 7)
+		test_basic_hash(i);
+	test_basic_hash(n);
+
+	for (int i = 1; i < 100; i += 7)
+		test_hash_index(i);
+	test_hash_index(n);
+
+	test_concurrent_hash(1, 1, 1);
+	test_concurrent_hash(n, 4, 2);
+	test_concurrent_hash_resize(2000, 3, 2, 20);
+
+	for (int i = 1; i < 100; i += 7)
+		test_basic_skiplist(i);
+	test_basic_skiplist(n);
 
-	test_basic_rbtree(n);
+	test_mt_skiplist(n, 4, 2, 10, false);
+	for (int i = 2; i <= 64; i *= 2)
+		test_mt_skiplist(i, 4, 1, 200, true);
+	test_mt_skiplist(n, 4, 2, 10, true);
 
 	return (0);
 }